@@ -255,6 +255,7 @@ public:
     void OnDestroyMap(Map* map) override
     {
         sEluna->OnDestroy(map);
+        sEluna->FreeObjectVariables(map);
     }
 
     void OnPlayerEnterAll(Map* map, Player* player) override
@@ -332,7 +333,7 @@ public:
 
     bool OnTryExecuteCommand(ChatHandler& handler, std::string_view cmdStr) override
     {
-        if (!sEluna->OnCommand(handler, std::string(cmdStr).c_str()))
+        if (!sEluna->OnCommand(handler, cmdStr))
         {
             return false;
         }
@@ -907,6 +908,9 @@ public:
     {
         delete object->elunaEvents;
         object->elunaEvents = nullptr;
+
+        if (sEluna)
+            sEluna->FreeObjectVariables(object);
     }
 
     void OnWorldObjectCreate(WorldObject* object) override
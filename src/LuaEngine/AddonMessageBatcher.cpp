@@ -0,0 +1,154 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "AddonMessageBatcher.h"
+#include "LuaEngine.h"
+#include "ElunaIncludes.h"
+#include "ElunaUtility.h"
+
+void AddonMessageBatcher::Queue(ObjectGuid sender, ObjectGuid receiver, uint8 type, std::string const& prefix, std::string_view message)
+{
+    std::string& stream = outgoing[OutgoingKey(receiver, sender, type, prefix)];
+    stream += std::to_string(message.size());
+    stream += ':';
+    stream.append(message.data(), message.size());
+}
+
+void AddonMessageBatcher::Flush()
+{
+    for (std::map<OutgoingKey, std::string>::const_iterator itr = outgoing.begin(); itr != outgoing.end(); ++itr)
+    {
+        ObjectGuid receiverGuid = std::get<0>(itr->first);
+        ObjectGuid senderGuid = std::get<1>(itr->first);
+        uint8 type = std::get<2>(itr->first);
+        std::string const& prefix = std::get<3>(itr->first);
+        std::string_view stream = itr->second;
+
+        Player* receiver = eObjectAccessor()FindPlayer(receiverGuid);
+        if (!receiver)
+            continue;
+
+        // prefix, tab and header
+        size_t chunkSize = MAX_ADDON_MESSAGE - prefix.size() - 2;
+        if (stream.size() <= chunkSize)
+        {
+            WorldPacket data(SMSG_MESSAGECHAT, 64 + prefix.size() + stream.size());
+            BuildPacket(data, type, senderGuid, receiverGuid, prefix, "S", stream);
+            ElunaUtil::SendPacket(receiver, &data);
+            continue;
+        }
+
+        for (size_t pos = 0; pos < stream.size(); pos += chunkSize)
+        {
+            std::string_view header = pos == 0 ? "F" : (pos + chunkSize >= stream.size() ? "L" : "M");
+            WorldPacket data(SMSG_MESSAGECHAT, 64 + MAX_ADDON_MESSAGE);
+            BuildPacket(data, type, senderGuid, receiverGuid, prefix, header, stream.substr(pos, chunkSize));
+            ElunaUtil::SendPacket(receiver, &data);
+        }
+    }
+    outgoing.clear();
+
+    // Streams are rarely left unfinished, so this is usually empty
+    for (std::map<IncomingKey, std::string>::iterator itr = incoming.begin(); itr != incoming.end();)
+    {
+        if (eObjectAccessor()FindPlayer(itr->first.first))
+            ++itr;
+        else
+            itr = incoming.erase(itr);
+    }
+}
+
+void AddonMessageBatcher::Clear()
+{
+    outgoing.clear();
+    incoming.clear();
+}
+
+bool AddonMessageBatcher::ParseStream(std::string_view stream, std::vector<std::string>& messages)
+{
+    size_t pos = 0;
+    while (pos < stream.size())
+    {
+        size_t length = 0;
+        size_t digits = 0;
+        while (pos < stream.size() && stream[pos] >= '0' && stream[pos] <= '9')
+        {
+            length = length * 10 + (stream[pos++] - '0');
+            if (++digits > 5)
+                return false;
+        }
+
+        if (!digits || pos >= stream.size() || stream[pos] != ':')
+            return false;
+        ++pos;
+
+        if (length > stream.size() - pos)
+            return false;
+        messages.emplace_back(stream.substr(pos, length));
+        pos += length;
+    }
+    return true;
+}
+
+bool AddonMessageBatcher::Receive(ObjectGuid sender, std::string_view prefix, std::string_view chunk, std::vector<std::string>& messages)
+{
+    if (chunk.empty())
+        return false;
+
+    char header = chunk[0];
+    chunk.remove_prefix(1);
+
+    if (header == 'S')
+        return ParseStream(chunk, messages);
+
+    IncomingKey key(sender, std::string(prefix));
+    if (header == 'F')
+    {
+        incoming[key].assign(chunk.data(), chunk.size());
+        return true;
+    }
+
+    if (header != 'M' && header != 'L')
+        return false;
+
+    // Parts without a first part are dropped
+    std::map<IncomingKey, std::string>::iterator itr = incoming.find(key);
+    if (itr == incoming.end())
+        return false;
+
+    if (itr->second.size() + chunk.size() > MAX_STREAM_SIZE)
+    {
+        incoming.erase(itr);
+        return false;
+    }
+
+    itr->second.append(chunk.data(), chunk.size());
+    if (header == 'M')
+        return true;
+
+    bool valid = ParseStream(itr->second, messages);
+    incoming.erase(itr);
+    return valid;
+}
+
+void AddonMessageBatcher::BuildPacket(WorldPacket& data, uint8 type, ObjectGuid sender, ObjectGuid receiver, std::string_view prefix, std::string_view header, std::string_view message)
+{
+    data << uint8(type);
+    data << int32(LANG_ADDON);
+    data << sender;
+#ifndef CLASSIC
+    data << uint32(0);
+    data << receiver;
+#endif
+    // prefix, tab, header, message and the null terminator
+    data << uint32(prefix.size() + 1 + header.size() + message.size() + 1);
+    data.append(prefix.data(), prefix.size());
+    data << uint8('\t');
+    data.append(header.data(), header.size());
+    data.append(message.data(), message.size());
+    data << uint8(0);
+    data << uint8(0);
+}
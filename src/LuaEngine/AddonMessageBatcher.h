@@ -0,0 +1,64 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_ADDON_MESSAGE_BATCHER_H
+#define _ELUNA_ADDON_MESSAGE_BATCHER_H
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "Define.h"
+#include "ObjectGuid.h"
+
+class WorldPacket;
+
+/*
+ * Sends and reassembles addon messages of arbitrary length.
+ *
+ * Messages queued for the same receiver, sender, prefix and chat type during an update
+ *   are joined into one stream of records and sent in as few chat messages as possible
+ *   when the queue is flushed at the end of the world update.
+ *
+ * A record is the message length in decimal digits, a ':' and the message itself.
+ * Each chat message starts with a one character header:
+ *   'S' holds a whole stream, 'F', 'M' and 'L' hold the first, middle and last part of a stream.
+ *
+ * Only used while holding the Eluna lock.
+ */
+class AddonMessageBatcher
+{
+public:
+    // Maximum length of the prefix, tab and message of a single addon message
+    static const size_t MAX_ADDON_MESSAGE = 255;
+    // Incoming streams larger than this are dropped
+    static const size_t MAX_STREAM_SIZE = 65536;
+
+    void Queue(ObjectGuid sender, ObjectGuid receiver, uint8 type, std::string const& prefix, std::string_view message);
+    // Sends the queued messages and drops the incoming streams of players who logged out
+    void Flush();
+    void Clear();
+
+    // Adds an incoming chunk, complete messages are appended to messages.
+    // Returns false if the chunk is malformed.
+    bool Receive(ObjectGuid sender, std::string_view prefix, std::string_view chunk, std::vector<std::string>& messages);
+
+    static void BuildPacket(WorldPacket& data, uint8 type, ObjectGuid sender, ObjectGuid receiver, std::string_view prefix, std::string_view header, std::string_view message);
+
+private:
+    // receiver, sender, type, prefix
+    typedef std::tuple<ObjectGuid, ObjectGuid, uint8, std::string> OutgoingKey;
+    // sender, prefix
+    typedef std::pair<ObjectGuid, std::string> IncomingKey;
+
+    static bool ParseStream(std::string_view stream, std::vector<std::string>& messages);
+
+    std::map<OutgoingKey, std::string> outgoing;
+    std::map<IncomingKey, std::string> incoming;
+};
+
+#endif // _ELUNA_ADDON_MESSAGE_BATCHER_H
@@ -0,0 +1,144 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "AddonMessageRouter.h"
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+};
+
+AddonMessageRouter::AddonMessageRouter() : maxRouteID(0)
+{
+}
+
+uint64 AddonMessageRouter::Add(std::string const& prefix, bool prefixMatch, int functionRef)
+{
+    std::unique_lock<std::shared_mutex> guard(routesLock);
+
+    Route route;
+    route.id = ++maxRouteID;
+    route.functionRef = functionRef;
+    (prefixMatch ? prefixRoutes : exactRoutes)[prefix].push_back(route);
+    return route.id;
+}
+
+uint64 AddonMessageRouter::AddChunked(std::string const& prefix, int functionRef)
+{
+    std::unique_lock<std::shared_mutex> guard(routesLock);
+
+    Route route;
+    route.id = ++maxRouteID;
+    route.functionRef = functionRef;
+    chunkedRoutes[prefix].push_back(route);
+    return route.id;
+}
+
+bool AddonMessageRouter::RemoveFrom(lua_State* L, RouteMap& routes, uint64 id)
+{
+    for (RouteMap::iterator itr = routes.begin(); itr != routes.end(); ++itr)
+    {
+        std::vector<Route>& list = itr->second;
+        for (std::vector<Route>::iterator it = list.begin(); it != list.end(); ++it)
+        {
+            if (it->id != id)
+                continue;
+
+            luaL_unref(L, LUA_REGISTRYINDEX, it->functionRef);
+            list.erase(it);
+            if (list.empty())
+                routes.erase(itr);
+            return true;
+        }
+    }
+    return false;
+}
+
+void AddonMessageRouter::Remove(lua_State* L, uint64 id)
+{
+    std::unique_lock<std::shared_mutex> guard(routesLock);
+
+    if (!RemoveFrom(L, exactRoutes, id) && !RemoveFrom(L, prefixRoutes, id))
+        RemoveFrom(L, chunkedRoutes, id);
+}
+
+void AddonMessageRouter::ClearRoutes(lua_State* L, RouteMap& routes)
+{
+    if (L)
+        for (RouteMap::const_iterator itr = routes.begin(); itr != routes.end(); ++itr)
+            for (Route const& route : itr->second)
+                luaL_unref(L, LUA_REGISTRYINDEX, route.functionRef);
+    routes.clear();
+}
+
+void AddonMessageRouter::Clear(lua_State* L)
+{
+    std::unique_lock<std::shared_mutex> guard(routesLock);
+
+    ClearRoutes(L, exactRoutes);
+    ClearRoutes(L, prefixRoutes);
+    ClearRoutes(L, chunkedRoutes);
+}
+
+bool AddonMessageRouter::HasRoutesFor(std::string_view prefix) const
+{
+    std::shared_lock<std::shared_mutex> guard(routesLock);
+
+    if (exactRoutes.find(prefix) != exactRoutes.end() || chunkedRoutes.find(prefix) != chunkedRoutes.end())
+        return true;
+
+    for (RouteMap::const_iterator itr = prefixRoutes.begin(); itr != prefixRoutes.end(); ++itr)
+        if (prefix.compare(0, itr->first.size(), itr->first) == 0)
+            return true;
+    return false;
+}
+
+bool AddonMessageRouter::PushRefs(lua_State* L, std::vector<Route> const& routes, int& count)
+{
+    if (!lua_checkstack(L, static_cast<int>(routes.size())))
+        return false;
+
+    for (Route const& route : routes)
+    {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, route.functionRef);
+        ++count;
+    }
+    return true;
+}
+
+int AddonMessageRouter::PushRefsFor(lua_State* L, std::string_view prefix) const
+{
+    std::shared_lock<std::shared_mutex> guard(routesLock);
+
+    int count = 0;
+    RouteMap::const_iterator exact = exactRoutes.find(prefix);
+    if (exact != exactRoutes.end() && !PushRefs(L, exact->second, count))
+        return count;
+
+    for (RouteMap::const_iterator itr = prefixRoutes.begin(); itr != prefixRoutes.end(); ++itr)
+        if (prefix.compare(0, itr->first.size(), itr->first) == 0 && !PushRefs(L, itr->second, count))
+            return count;
+    return count;
+}
+
+bool AddonMessageRouter::HasChunkedRoutesFor(std::string_view prefix) const
+{
+    std::shared_lock<std::shared_mutex> guard(routesLock);
+
+    return chunkedRoutes.find(prefix) != chunkedRoutes.end();
+}
+
+int AddonMessageRouter::PushChunkedRefsFor(lua_State* L, std::string_view prefix) const
+{
+    std::shared_lock<std::shared_mutex> guard(routesLock);
+
+    int count = 0;
+    RouteMap::const_iterator itr = chunkedRoutes.find(prefix);
+    if (itr != chunkedRoutes.end())
+        PushRefs(L, itr->second, count);
+    return count;
+}
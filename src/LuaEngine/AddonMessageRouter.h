@@ -0,0 +1,65 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_ADDON_MESSAGE_ROUTER_H
+#define _ELUNA_ADDON_MESSAGE_ROUTER_H
+
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Define.h"
+
+struct lua_State;
+
+/*
+ * Maps addon message prefixes to the Lua functions handling them.
+ *
+ * Routes either match a prefix exactly or match every prefix starting with the route prefix.
+ * Chunked routes match a prefix exactly and receive the messages reassembled by AddonMessageBatcher.
+ * Lookups can be done from any thread without the Eluna lock,
+ *   so messages with an unhandled prefix never wait for Lua.
+ */
+class AddonMessageRouter
+{
+public:
+    AddonMessageRouter();
+
+    uint64 Add(std::string const& prefix, bool prefixMatch, int functionRef);
+    uint64 AddChunked(std::string const& prefix, int functionRef);
+    void Remove(lua_State* L, uint64 id);
+    void Clear(lua_State* L);
+
+    // Returns true if any route matches the prefix
+    bool HasRoutesFor(std::string_view prefix) const;
+    // Pushes the functions of all routes matching the prefix, returns the amount pushed
+    int PushRefsFor(lua_State* L, std::string_view prefix) const;
+    bool HasChunkedRoutesFor(std::string_view prefix) const;
+    int PushChunkedRefsFor(lua_State* L, std::string_view prefix) const;
+
+private:
+    struct Route
+    {
+        uint64 id;
+        int functionRef;
+    };
+
+    typedef std::map<std::string, std::vector<Route>, std::less<> > RouteMap;
+
+    static bool RemoveFrom(lua_State* L, RouteMap& routes, uint64 id);
+    static void ClearRoutes(lua_State* L, RouteMap& routes);
+    static bool PushRefs(lua_State* L, std::vector<Route> const& routes, int& count);
+
+    uint64 maxRouteID;
+    RouteMap exactRoutes;
+    RouteMap prefixRoutes;
+    RouteMap chunkedRoutes;
+    mutable std::shared_mutex routesLock;
+};
+
+#endif // _ELUNA_ADDON_MESSAGE_ROUTER_H
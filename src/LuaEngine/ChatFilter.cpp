@@ -0,0 +1,211 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "ChatFilter.h"
+#include <algorithm>
+#include <cctype>
+#include <queue>
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+};
+
+static inline uint8 FoldCase(uint8 c, bool ignoreCase)
+{
+    return ignoreCase ? static_cast<uint8>(std::tolower(c)) : c;
+}
+
+KeywordMatcher::KeywordMatcher() : ignoreCase(false)
+{
+    nodes.resize(1);
+    nodes[0].next.fill(0);
+    nodes[0].terminal = false;
+}
+
+void KeywordMatcher::Build(std::vector<std::string> const& keywords, bool ignoreCase)
+{
+    this->ignoreCase = ignoreCase;
+    nodes.resize(1);
+    nodes[0].next.fill(-1);
+    nodes[0].terminal = false;
+
+    // Build the trie, -1 marks a missing edge
+    for (std::string const& keyword : keywords)
+    {
+        if (keyword.empty())
+            continue;
+
+        int32 node = 0;
+        for (char ch : keyword)
+        {
+            uint8 c = FoldCase(static_cast<uint8>(ch), ignoreCase);
+            if (nodes[node].next[c] < 0)
+            {
+                nodes[node].next[c] = static_cast<int32>(nodes.size());
+                nodes.emplace_back();
+                nodes.back().next.fill(-1);
+                nodes.back().terminal = false;
+            }
+            node = nodes[node].next[c];
+        }
+        nodes[node].terminal = true;
+    }
+
+    // Replace missing edges with the transitions of the failure links, breadth first
+    std::vector<int32> fail(nodes.size(), 0);
+    std::queue<int32> queue;
+    for (uint32 c = 0; c < 256; ++c)
+    {
+        int32 child = nodes[0].next[c];
+        if (child < 0)
+            nodes[0].next[c] = 0;
+        else
+            queue.push(child);
+    }
+
+    while (!queue.empty())
+    {
+        int32 node = queue.front();
+        queue.pop();
+
+        // A node matches if any suffix of it is a keyword
+        if (nodes[fail[node]].terminal)
+            nodes[node].terminal = true;
+
+        for (uint32 c = 0; c < 256; ++c)
+        {
+            int32 child = nodes[node].next[c];
+            if (child < 0)
+            {
+                nodes[node].next[c] = nodes[fail[node]].next[c];
+                continue;
+            }
+            fail[child] = nodes[fail[node]].next[c];
+            queue.push(child);
+        }
+    }
+}
+
+bool KeywordMatcher::Matches(std::string_view text) const
+{
+    int32 node = 0;
+    for (char ch : text)
+    {
+        node = nodes[node].next[FoldCase(static_cast<uint8>(ch), ignoreCase)];
+        if (nodes[node].terminal)
+            return true;
+    }
+    return false;
+}
+
+bool ChatFilter::Matches(uint32 type, std::string_view msg) const
+{
+    if (typeMask && (type >= 64 || !(typeMask & (uint64(1) << type))))
+        return false;
+
+    if (!prefixes.empty())
+    {
+        bool found = false;
+        for (std::string const& prefix : prefixes)
+        {
+            if (prefix.size() > msg.size())
+                continue;
+
+            found = true;
+            for (size_t i = 0; i < prefix.size() && found; ++i)
+                found = FoldCase(static_cast<uint8>(msg[i]), ignoreCase) == FoldCase(static_cast<uint8>(prefix[i]), ignoreCase);
+            if (found)
+                break;
+        }
+        if (!found)
+            return false;
+    }
+
+    return keywords.Empty() || keywords.Matches(msg);
+}
+
+ChatFilterManager::ChatFilterManager() : handlerCount(0), maxHandlerID(0)
+{
+}
+
+uint64 ChatFilterManager::Add(uint32 event_id, std::unique_ptr<ChatFilter> filter, int functionRef)
+{
+    std::unique_lock<std::shared_mutex> guard(handlersLock);
+
+    Handler handler;
+    handler.id = ++maxHandlerID;
+    handler.event_id = event_id;
+    handler.functionRef = functionRef;
+    handler.filter = std::move(filter);
+    handlers.push_back(std::move(handler));
+    ++handlerCount;
+    return maxHandlerID;
+}
+
+void ChatFilterManager::Remove(lua_State* L, uint64 id)
+{
+    std::unique_lock<std::shared_mutex> guard(handlersLock);
+
+    for (std::vector<Handler>::iterator itr = handlers.begin(); itr != handlers.end(); ++itr)
+    {
+        if (itr->id != id)
+            continue;
+
+        luaL_unref(L, LUA_REGISTRYINDEX, itr->functionRef);
+        handlers.erase(itr);
+        --handlerCount;
+        return;
+    }
+}
+
+void ChatFilterManager::Clear(lua_State* L)
+{
+    std::unique_lock<std::shared_mutex> guard(handlersLock);
+
+    if (L)
+        for (Handler const& handler : handlers)
+            luaL_unref(L, LUA_REGISTRYINDEX, handler.functionRef);
+    handlers.clear();
+    handlerCount = 0;
+}
+
+bool ChatFilterManager::Match(uint32 event_id, uint32 type, std::string const& msg, std::vector<uint64>& ids) const
+{
+    if (!handlerCount.load(std::memory_order_relaxed))
+        return false;
+
+    std::shared_lock<std::shared_mutex> guard(handlersLock);
+
+    for (Handler const& handler : handlers)
+        if (handler.event_id == event_id && handler.filter->Matches(type, msg))
+            ids.push_back(handler.id);
+    return !ids.empty();
+}
+
+int ChatFilterManager::PushRefs(lua_State* L, std::vector<uint64> const& ids) const
+{
+    if (ids.empty())
+        return 0;
+
+    std::shared_lock<std::shared_mutex> guard(handlersLock);
+
+    if (!lua_checkstack(L, static_cast<int>(ids.size())))
+        return 0;
+
+    // Handlers may have been removed since matching
+    int count = 0;
+    for (Handler const& handler : handlers)
+    {
+        if (std::find(ids.begin(), ids.end(), handler.id) == ids.end())
+            continue;
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, handler.functionRef);
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,96 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_CHAT_FILTER_H
+#define _ELUNA_CHAT_FILTER_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Define.h"
+
+struct lua_State;
+
+/*
+ * Aho-Corasick automaton finding any of a set of keywords in a single pass over a message.
+ *
+ * The goto and failure functions are merged into one transition table,
+ *   so matching costs one table lookup per character.
+ */
+class KeywordMatcher
+{
+public:
+    KeywordMatcher();
+
+    void Build(std::vector<std::string> const& keywords, bool ignoreCase);
+    bool Empty() const { return nodes.size() <= 1; }
+    // Returns true if the text contains any of the keywords
+    bool Matches(std::string_view text) const;
+
+private:
+    struct Node
+    {
+        std::array<int32, 256> next;
+        bool terminal;
+    };
+
+    std::vector<Node> nodes;
+    bool ignoreCase;
+};
+
+/*
+ * Conditions a chat message must meet to be passed to a filtered chat handler.
+ *
+ * All given conditions must be met, a condition with several values is met by any of them.
+ */
+struct ChatFilter
+{
+    ChatFilter() : typeMask(0), ignoreCase(false) { }
+
+    bool Matches(uint32 type, std::string_view msg) const;
+
+    std::vector<std::string> prefixes; // empty for any prefix
+    KeywordMatcher keywords; // empty for any message
+    uint64 typeMask; // 0 for all chat types
+    bool ignoreCase;
+};
+
+class ChatFilterManager
+{
+public:
+    ChatFilterManager();
+
+    uint64 Add(uint32 event_id, std::unique_ptr<ChatFilter> filter, int functionRef);
+    void Remove(lua_State* L, uint64 id);
+    void Clear(lua_State* L);
+
+    // Collects the handlers of the event whose filter accepts the message, returns false if there are none.
+    // Called from any thread, never takes the Eluna lock.
+    bool Match(uint32 event_id, uint32 type, std::string const& msg, std::vector<uint64>& ids) const;
+    // Pushes the functions of the handlers that still exist, returns the amount pushed
+    int PushRefs(lua_State* L, std::vector<uint64> const& ids) const;
+
+private:
+    struct Handler
+    {
+        uint64 id;
+        uint32 event_id;
+        int functionRef;
+        std::unique_ptr<ChatFilter> filter;
+    };
+
+    std::atomic<uint32> handlerCount;
+    uint64 maxHandlerID;
+    std::vector<Handler> handlers;
+    mutable std::shared_mutex handlersLock;
+};
+
+#endif // _ELUNA_CHAT_FILTER_H
@@ -0,0 +1,157 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "CommandTrie.h"
+#include <algorithm>
+#include <cctype>
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+};
+
+bool CommandTrie::CaseInsensitiveLess::operator()(std::string_view left, std::string_view right) const
+{
+    size_t length = std::min(left.size(), right.size());
+    for (size_t i = 0; i < length; ++i)
+    {
+        int l = std::tolower(static_cast<unsigned char>(left[i]));
+        int r = std::tolower(static_cast<unsigned char>(right[i]));
+        if (l != r)
+            return l < r;
+    }
+    return left.size() < right.size();
+}
+
+CommandTrie::CommandTrie() : maxCommandID(0)
+{
+}
+
+std::string_view CommandTrie::NextWord(std::string_view& text)
+{
+    size_t start = 0;
+    while (start < text.size() && std::isspace(static_cast<unsigned char>(text[start])))
+        ++start;
+
+    size_t end = start;
+    while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end])))
+        ++end;
+
+    std::string_view word = text.substr(start, end - start);
+    text.remove_prefix(end);
+    return word;
+}
+
+uint64 CommandTrie::Add(lua_State* L, std::string_view name, uint32 minSecurity, int functionRef)
+{
+    std::unique_lock<std::shared_mutex> guard(commandsLock);
+
+    Node* node = &root;
+    for (std::string_view word = NextWord(name); !word.empty(); word = NextWord(name))
+    {
+        auto itr = node->children.find(word);
+        if (itr == node->children.end())
+            itr = node->children.emplace(std::string(word), std::unique_ptr<Node>(new Node())).first;
+        node = itr->second.get();
+    }
+
+    if (node == &root)
+        return 0;
+
+    if (node->id)
+        luaL_unref(L, LUA_REGISTRYINDEX, node->functionRef);
+
+    node->id = ++maxCommandID;
+    node->minSecurity = minSecurity;
+    node->functionRef = functionRef;
+    return node->id;
+}
+
+CommandTrie::Node* CommandTrie::FindNode(Node* node, uint64 id)
+{
+    if (node->id == id)
+        return node;
+
+    for (auto& child : node->children)
+        if (Node* found = FindNode(child.second.get(), id))
+            return found;
+    return NULL;
+}
+
+void CommandTrie::Remove(lua_State* L, uint64 id)
+{
+    std::unique_lock<std::shared_mutex> guard(commandsLock);
+
+    Node* node = id ? FindNode(&root, id) : NULL;
+    if (!node)
+        return;
+
+    luaL_unref(L, LUA_REGISTRYINDEX, node->functionRef);
+    node->id = 0;
+    node->functionRef = 0;
+}
+
+void CommandTrie::ClearNode(lua_State* L, Node* node)
+{
+    if (L && node->id)
+        luaL_unref(L, LUA_REGISTRYINDEX, node->functionRef);
+
+    for (auto& child : node->children)
+        ClearNode(L, child.second.get());
+}
+
+void CommandTrie::Clear(lua_State* L)
+{
+    std::unique_lock<std::shared_mutex> guard(commandsLock);
+
+    ClearNode(L, &root);
+    root.children.clear();
+}
+
+uint64 CommandTrie::Find(std::string_view text, uint32 security, std::string_view& args) const
+{
+    std::shared_lock<std::shared_mutex> guard(commandsLock);
+
+    uint64 id = 0;
+    Node const* node = &root;
+    for (std::string_view word = NextWord(text); !word.empty(); word = NextWord(text))
+    {
+        auto itr = node->children.find(word);
+        if (itr == node->children.end())
+            break;
+
+        node = itr->second.get();
+        if (node->id && security >= node->minSecurity)
+        {
+            id = node->id;
+            args = text;
+        }
+    }
+
+    if (id)
+    {
+        // Arguments start after the whitespace following the command
+        while (!args.empty() && std::isspace(static_cast<unsigned char>(args.front())))
+            args.remove_prefix(1);
+    }
+    return id;
+}
+
+bool CommandTrie::PushRef(lua_State* L, uint64 id) const
+{
+    if (!id)
+        return false;
+
+    std::shared_lock<std::shared_mutex> guard(commandsLock);
+
+    Node* node = FindNode(const_cast<Node*>(&root), id);
+    if (!node)
+        return false;
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, node->functionRef);
+    return true;
+}
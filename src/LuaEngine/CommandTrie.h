@@ -0,0 +1,72 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_COMMAND_TRIE_H
+#define _ELUNA_COMMAND_TRIE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include "Define.h"
+
+struct lua_State;
+
+/*
+ * Commands registered by scripts, stored as a trie of command words.
+ *
+ * Words are compared ignoring ASCII case and the longest registered command matching
+ *   the start of the text wins, the rest of the text are the command arguments.
+ * Lookups can be done from any thread without the Eluna lock,
+ *   so commands no script registered never wait for Lua.
+ */
+class CommandTrie
+{
+public:
+    CommandTrie();
+
+    // Registers the command, replacing a command with the same name
+    uint64 Add(lua_State* L, std::string_view name, uint32 minSecurity, int functionRef);
+    void Remove(lua_State* L, uint64 id);
+    void Clear(lua_State* L);
+
+    // Finds the command matching the text that the security level can use.
+    // Returns the command id and sets args to the text following the command words, or returns 0.
+    uint64 Find(std::string_view text, uint32 security, std::string_view& args) const;
+    // Pushes the function of the command, returns false if it was removed
+    bool PushRef(lua_State* L, uint64 id) const;
+
+    // Returns the first word of text and removes it from text
+    static std::string_view NextWord(std::string_view& text);
+
+private:
+    struct CaseInsensitiveLess
+    {
+        typedef void is_transparent;
+        bool operator()(std::string_view left, std::string_view right) const;
+    };
+
+    struct Node
+    {
+        Node() : id(0), minSecurity(0), functionRef(0) { }
+
+        std::map<std::string, std::unique_ptr<Node>, CaseInsensitiveLess> children;
+        uint64 id; // 0 if no command ends at this node
+        uint32 minSecurity;
+        int functionRef;
+    };
+
+    static Node* FindNode(Node* node, uint64 id);
+    static void ClearNode(lua_State* L, Node* node);
+
+    uint64 maxCommandID;
+    Node root;
+    mutable std::shared_mutex commandsLock;
+};
+
+#endif // _ELUNA_COMMAND_TRIE_H
@@ -0,0 +1,151 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "ElunaCoroutines.h"
+#include "LuaEngine.h"
+#include "ElunaIncludes.h"
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+};
+
+namespace
+{
+    // Threads of finished tasks kept for the next ones
+    const size_t MAX_IDLE_THREADS = 32;
+
+    uint64_t MakeHandle(uint32_t task, uint32_t token)
+    {
+        return (static_cast<uint64_t>(task) << 32) | token;
+    }
+}
+
+CoroutineScheduler::CoroutineScheduler()
+    : time(0),
+    nextTask(0),
+    nextToken(0)
+{
+}
+
+void CoroutineScheduler::Start(lua_State* L, int nargs)
+{
+    Task task;
+    if (!idleThreads.empty())
+    {
+        task.thread = idleThreads.back().thread;
+        task.ref = idleThreads.back().ref;
+        idleThreads.pop_back();
+    }
+    else
+    {
+        task.thread = lua_newthread(L);
+        task.ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    task.token = 0;
+
+    // Ids are never 0 and are not reused after a reload, so a late wake up can't find another task
+    if (!++nextTask)
+        ++nextTask;
+
+    TaskMap::iterator itr = tasks.emplace(nextTask, task).first;
+    threadTasks[task.thread] = nextTask;
+
+    // Stack: function, [arguments]
+    lua_xmove(L, task.thread, nargs + 1);
+    Run(L, itr, nargs);
+}
+
+uint64_t CoroutineScheduler::Suspend(lua_State* thread)
+{
+    auto itr = threadTasks.find(thread);
+    if (itr == threadTasks.end())
+        luaL_error(thread, "can only await in a function started with Async");
+
+    if (!++nextToken)
+        ++nextToken;
+
+    tasks[itr->second].token = nextToken;
+    return MakeHandle(itr->second, nextToken);
+}
+
+void CoroutineScheduler::Resume(lua_State* L, uint64_t handle, int nargs)
+{
+    TaskMap::iterator itr = tasks.find(static_cast<uint32_t>(handle >> 32));
+    if (itr == tasks.end() || !itr->second.token || itr->second.token != static_cast<uint32_t>(handle))
+    {
+        lua_pop(L, nargs);
+        return;
+    }
+
+    lua_xmove(L, itr->second.thread, nargs);
+    Run(L, itr, nargs);
+}
+
+void CoroutineScheduler::Sleep(uint64_t handle, uint32_t delay)
+{
+    timers.emplace(time + delay, handle);
+}
+
+void CoroutineScheduler::Update(lua_State* L, uint32_t diff)
+{
+    time += diff;
+
+    // Tasks sleeping again while they are resumed wait for the next update
+    std::vector<uint64_t> due;
+    for (auto itr = timers.begin(); itr != timers.end() && itr->first <= time; itr = timers.erase(itr))
+        due.push_back(itr->second);
+
+    for (uint64_t handle : due)
+        Resume(L, handle, 0);
+}
+
+void CoroutineScheduler::Run(lua_State* L, TaskMap::iterator itr, int nargs)
+{
+    uint32_t id = itr->first;
+    Task task = itr->second;
+    itr->second.token = 0;
+
+    int status = Eluna::GEluna->ExecuteResume(task.thread, L, nargs);
+
+    // The iterator may be invalid, the task could have started others
+    if (status == LUA_YIELD)
+    {
+        if (tasks[id].token)
+        {
+            lua_settop(task.thread, 0);
+            return;
+        }
+
+        // Nothing would ever resume it
+        ELUNA_LOG_ERROR("[Eluna]: A function started with Async yielded without awaiting, use Wait or another await function instead of coroutine.yield");
+    }
+
+    tasks.erase(id);
+    threadTasks.erase(task.thread);
+
+    // Only threads that returned normally can run another function
+    if (status == LUA_OK && idleThreads.size() < MAX_IDLE_THREADS)
+    {
+        lua_settop(task.thread, 0);
+        IdleThread idle;
+        idle.thread = task.thread;
+        idle.ref = task.ref;
+        idleThreads.push_back(idle);
+    }
+    else
+        luaL_unref(L, LUA_REGISTRYINDEX, task.ref);
+}
+
+void CoroutineScheduler::Clear()
+{
+    // The threads and their refs go with the Lua state
+    tasks.clear();
+    threadTasks.clear();
+    idleThreads.clear();
+    timers.clear();
+}
@@ -0,0 +1,75 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_COROUTINES_H
+#define _ELUNA_COROUTINES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+struct lua_State;
+
+/*
+ * Runs the functions started with Async as coroutines that are suspended by Wait, AwaitWorldDBQuery, AwaitHttp...
+ *   and resumed by the world update, the query callbacks and the HTTP responses.
+ *
+ * A suspended task is woken with a handle made of its id and a token that changes on every await,
+ *   so a late wake up for an await the task is no longer in is ignored.
+ * The threads of finished tasks are kept to run the next ones.
+ *
+ * Only used with the Eluna lock held, the tasks are dropped when the Lua state is closed.
+ */
+class CoroutineScheduler
+{
+public:
+    CoroutineScheduler();
+
+    // Runs the function below the nargs arguments on top of L's stack until it finishes or awaits, popping them
+    void Start(lua_State* L, int nargs);
+    // Prepares the task running on thread to await, returns the handle to resume it with. Raises an error outside of a task.
+    uint64_t Suspend(lua_State* thread);
+    // Resumes the task with the nargs values on top of L's stack, popping them
+    void Resume(lua_State* L, uint64_t handle, int nargs);
+    // Resumes the task without values after delay milliseconds
+    void Sleep(uint64_t handle, uint32_t delay);
+    // Resumes the tasks whose Sleep is over
+    void Update(lua_State* L, uint32_t diff);
+    void Clear();
+
+    size_t GetTaskCount() const { return tasks.size(); }
+
+private:
+    struct Task
+    {
+        lua_State* thread;
+        int ref;
+        // Token of the current await, 0 while running
+        uint32_t token;
+    };
+
+    struct IdleThread
+    {
+        lua_State* thread;
+        int ref;
+    };
+
+    typedef std::unordered_map<uint32_t, Task> TaskMap;
+
+    void Run(lua_State* L, TaskMap::iterator itr, int nargs);
+
+    TaskMap tasks;
+    std::unordered_map<lua_State*, uint32_t> threadTasks;
+    std::vector<IdleThread> idleThreads;
+    std::multimap<uint64_t, uint64_t> timers;
+    uint64_t time;
+    uint32_t nextTask;
+    uint32_t nextToken;
+};
+
+#endif // _ELUNA_COROUTINES_H
@@ -111,6 +111,8 @@ void ElunaEventProcessor::AddEvent(LuaEvent* luaEvent)
 void ElunaEventProcessor::AddEvent(int funcRef, uint32 min, uint32 max, uint32 repeats)
 {
     AddEvent(new LuaEvent(funcRef, min, max, repeats));
+    if (Eluna::IsInitialized())
+        ++(*E)->metrics.timedEvents;
 }
 
 void ElunaEventProcessor::RemoveEvent(LuaEvent* luaEvent)
@@ -121,6 +123,8 @@ void ElunaEventProcessor::RemoveEvent(LuaEvent* luaEvent)
         // Free lua function ref
         luaL_unref((*E)->L, LUA_REGISTRYINDEX, luaEvent->funcRef);
     }
+    if (Eluna::IsInitialized())
+        --(*E)->metrics.timedEvents;
     delete luaEvent;
 }
 
@@ -0,0 +1,241 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#if defined TRINITY || defined AZEROTHCORE
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#endif
+#include "libs/httplib.h"
+#include "ElunaMetrics.h"
+#include "HttpManager.h"
+#include "LuaEngine.h"
+
+#include <cstdlib>
+#include <sstream>
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+};
+
+namespace
+{
+    // Upper bounds of the hook duration histogram buckets in seconds, the last one is +Inf
+    const double BUCKET_BOUNDS[ElunaMetrics::BUCKET_COUNT - 1] = { 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1 };
+
+    const char* const HOOK_TYPE_NAMES[HOOK_METRIC_COUNT] =
+    {
+        "packet",
+        "server",
+        "player",
+        "guild",
+        "group",
+        "vehicle",
+        "creature",
+        "gameobject",
+        "item",
+        "gossip",
+        "battleground",
+        "instance"
+    };
+
+    void WriteMetric(std::ostringstream& out, const char* name, const char* type, const char* help, double value)
+    {
+        out << "# HELP " << name << ' ' << help << '\n';
+        out << "# TYPE " << name << ' ' << type << '\n';
+        out << name << ' ' << value << '\n';
+    }
+}
+
+ElunaMetrics::ElunaMetrics()
+    : luaCalls(0),
+    luaErrors(0),
+    luaMemory(0),
+    gcCycles(0),
+    gcCollectNanoseconds(0),
+    timedEventCalls(0),
+    timedEvents(0),
+    dbCallbacksPending(0),
+    http(nullptr)
+{
+    for (HookCounters& counters : hooks)
+    {
+        counters.nanoseconds = 0;
+        for (std::atomic<uint64_t>& bucket : counters.buckets)
+            bucket = 0;
+    }
+}
+
+ElunaMetrics::~ElunaMetrics()
+{
+    StopServer();
+}
+
+void ElunaMetrics::BeginHook(HookMetricType type)
+{
+    HookTimer timer;
+    timer.type = type;
+    timer.start = std::chrono::steady_clock::now();
+    hookTimers.push_back(timer);
+}
+
+void ElunaMetrics::EndHook()
+{
+    if (hookTimers.empty())
+        return;
+
+    HookTimer timer = hookTimers.back();
+    hookTimers.pop_back();
+
+    uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - timer.start).count();
+    double seconds = nanoseconds / 1e9;
+
+    size_t bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && seconds > BUCKET_BOUNDS[bucket])
+        ++bucket;
+
+    HookCounters& counters = hooks[timer.type];
+    counters.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    counters.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void* ElunaMetrics::Allocate(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+    ElunaMetrics* metrics = static_cast<ElunaMetrics*>(ud);
+
+    // When ptr is NULL osize is the type of the new object, not a size
+    size_t oldSize = ptr ? osize : 0;
+
+    if (nsize == 0)
+    {
+        free(ptr);
+        metrics->luaMemory.fetch_sub(oldSize, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    void* block = realloc(ptr, nsize);
+    if (block)
+    {
+        metrics->luaMemory.fetch_add(nsize, std::memory_order_relaxed);
+        metrics->luaMemory.fetch_sub(oldSize, std::memory_order_relaxed);
+    }
+    return block;
+}
+
+void ElunaMetrics::WatchGarbageCollection(lua_State* L)
+{
+    // An unreferenced userdata is finalized by every collection cycle and replaces itself
+    lua_newuserdata(L, 1);
+    lua_createtable(L, 0, 1);
+    lua_pushlightuserdata(L, this);
+    lua_pushcclosure(L, &ElunaMetrics::OnGarbageCollected, 1);
+    lua_setfield(L, -2, "__gc");
+    lua_setmetatable(L, -2);
+    lua_pop(L, 1);
+}
+
+int ElunaMetrics::OnGarbageCollected(lua_State* L)
+{
+    ElunaMetrics* metrics = static_cast<ElunaMetrics*>(lua_touserdata(L, lua_upvalueindex(1)));
+    metrics->gcCycles.fetch_add(1, std::memory_order_relaxed);
+
+    // Objects created by finalizers while the state is closing are freed without finalizing them
+    metrics->WatchGarbageCollection(L);
+    return 0;
+}
+
+void ElunaMetrics::StartServer(HttpManager const* httpManager)
+{
+#if defined(AZEROTHCORE)
+    bool enabled = eConfigMgr->GetOption<bool>("Eluna.Metrics.Enabled", false);
+    std::string address = eConfigMgr->GetOption<std::string>("Eluna.Metrics.Address", "127.0.0.1");
+    uint32 port = eConfigMgr->GetOption<uint32>("Eluna.Metrics.Port", 9150);
+#else
+    bool enabled = eConfigMgr->GetBoolDefault("Eluna.Metrics.Enabled", false);
+    std::string address = eConfigMgr->GetStringDefault("Eluna.Metrics.Address", "127.0.0.1");
+    uint32 port = eConfigMgr->GetIntDefault("Eluna.Metrics.Port", 9150);
+#endif
+
+    if (!enabled || server)
+        return;
+
+    http = httpManager;
+    server.reset(new httplib::Server());
+    server->Get("/metrics", [this](const httplib::Request& /*req*/, httplib::Response& res)
+    {
+        res.set_content(Render(), "text/plain; version=0.0.4");
+    });
+
+    if (!server->bind_to_port(address.c_str(), port))
+    {
+        ELUNA_LOG_ERROR("[Eluna]: Could not bind the metrics server to {}:{}", address, port);
+        server.reset();
+        return;
+    }
+
+    serverThread = std::thread([this]() { server->listen_after_bind(); });
+    ELUNA_LOG_INFO("[Eluna]: Serving metrics on http://{}:{}/metrics", address, port);
+}
+
+void ElunaMetrics::StopServer()
+{
+    if (!server)
+        return;
+
+    server->stop();
+    if (serverThread.joinable())
+        serverThread.join();
+    server.reset();
+}
+
+std::string ElunaMetrics::Render() const
+{
+    std::ostringstream out;
+
+    out << "# HELP eluna_hook_duration_seconds Time spent running the Lua handlers of a hook.\n";
+    out << "# TYPE eluna_hook_duration_seconds histogram\n";
+    for (int type = 0; type < HOOK_METRIC_COUNT; ++type)
+    {
+        HookCounters const& counters = hooks[type];
+        const char* name = HOOK_TYPE_NAMES[type];
+
+        uint64_t cumulative = 0;
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+        {
+            cumulative += counters.buckets[bucket].load(std::memory_order_relaxed);
+            out << "eluna_hook_duration_seconds_bucket{type=\"" << name << "\",le=\"";
+            if (bucket < BUCKET_COUNT - 1)
+                out << BUCKET_BOUNDS[bucket];
+            else
+                out << "+Inf";
+            out << "\"} " << cumulative << '\n';
+        }
+        // The count matches the +Inf bucket even if a hook finishes while rendering
+        out << "eluna_hook_duration_seconds_sum{type=\"" << name << "\"} " << counters.nanoseconds.load(std::memory_order_relaxed) / 1e9 << '\n';
+        out << "eluna_hook_duration_seconds_count{type=\"" << name << "\"} " << cumulative << '\n';
+    }
+
+    WriteMetric(out, "eluna_lua_calls_total", "counter", "Lua functions called by the engine.", static_cast<double>(luaCalls.load(std::memory_order_relaxed)));
+    WriteMetric(out, "eluna_lua_errors_total", "counter", "Lua functions called by the engine that raised an error.", static_cast<double>(luaErrors.load(std::memory_order_relaxed)));
+    WriteMetric(out, "eluna_lua_memory_bytes", "gauge", "Memory allocated by the Lua state.", static_cast<double>(luaMemory.load(std::memory_order_relaxed)));
+    WriteMetric(out, "eluna_lua_gc_cycles_total", "counter", "Completed Lua garbage collection cycles.", static_cast<double>(gcCycles.load(std::memory_order_relaxed)));
+    WriteMetric(out, "eluna_lua_gc_collect_seconds_total", "counter", "Time spent in full garbage collections forced by the engine.", gcCollectNanoseconds.load(std::memory_order_relaxed) / 1e9);
+    WriteMetric(out, "eluna_timed_event_calls_total", "counter", "Timed event functions called.", static_cast<double>(timedEventCalls.load(std::memory_order_relaxed)));
+    WriteMetric(out, "eluna_timed_events", "gauge", "Scheduled timed events.", static_cast<double>(timedEvents.load(std::memory_order_relaxed)));
+    WriteMetric(out, "eluna_db_callbacks_pending", "gauge", "Asynchronous database queries waiting for their callback.", static_cast<double>(dbCallbacksPending.load(std::memory_order_relaxed)));
+
+    if (http)
+    {
+        HttpStats stats = http->GetStats();
+        WriteMetric(out, "eluna_http_requests_queued", "gauge", "HTTP requests waiting to be executed.", static_cast<double>(stats.queued));
+        WriteMetric(out, "eluna_http_requests_in_flight", "gauge", "HTTP requests being executed.", static_cast<double>(stats.inFlight));
+        WriteMetric(out, "eluna_http_requests_dropped_total", "counter", "HTTP requests dropped because the queue was full.", static_cast<double>(stats.dropped));
+        WriteMetric(out, "eluna_http_requests_rejected_total", "counter", "HTTP requests rejected because the queue was full.", static_cast<double>(stats.rejected));
+        WriteMetric(out, "eluna_http_responses_pending", "gauge", "HTTP responses waiting for their callback.", static_cast<double>(stats.responses));
+    }
+
+    return out.str();
+}
@@ -0,0 +1,116 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_METRICS_H
+#define _ELUNA_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Hooks.h"
+
+class HttpManager;
+struct lua_State;
+
+namespace httplib
+{
+    class Server;
+};
+
+enum HookMetricType
+{
+    HOOK_METRIC_PACKET,
+    HOOK_METRIC_SERVER,
+    HOOK_METRIC_PLAYER,
+    HOOK_METRIC_GUILD,
+    HOOK_METRIC_GROUP,
+    HOOK_METRIC_VEHICLE,
+    HOOK_METRIC_CREATURE,
+    HOOK_METRIC_GAMEOBJECT,
+    HOOK_METRIC_ITEM,
+    HOOK_METRIC_GOSSIP,
+    HOOK_METRIC_BG,
+    HOOK_METRIC_INSTANCE,
+    HOOK_METRIC_COUNT
+};
+
+/*
+ * Counters describing the engine's work.
+ *
+ * Everything is updated with relaxed atomics by the threads doing the work
+ *   and read by the metrics server thread without taking the Eluna lock.
+ */
+class ElunaMetrics
+{
+public:
+    static const size_t BUCKET_COUNT = 8;
+
+    ElunaMetrics();
+    ~ElunaMetrics();
+
+    static HookMetricType GetHookType(Hooks::PacketEvents) { return HOOK_METRIC_PACKET; }
+    static HookMetricType GetHookType(Hooks::ServerEvents) { return HOOK_METRIC_SERVER; }
+    static HookMetricType GetHookType(Hooks::PlayerEvents) { return HOOK_METRIC_PLAYER; }
+    static HookMetricType GetHookType(Hooks::GuildEvents) { return HOOK_METRIC_GUILD; }
+    static HookMetricType GetHookType(Hooks::GroupEvents) { return HOOK_METRIC_GROUP; }
+    static HookMetricType GetHookType(Hooks::VehicleEvents) { return HOOK_METRIC_VEHICLE; }
+    static HookMetricType GetHookType(Hooks::CreatureEvents) { return HOOK_METRIC_CREATURE; }
+    static HookMetricType GetHookType(Hooks::GameObjectEvents) { return HOOK_METRIC_GAMEOBJECT; }
+    static HookMetricType GetHookType(Hooks::ItemEvents) { return HOOK_METRIC_ITEM; }
+    static HookMetricType GetHookType(Hooks::GossipEvents) { return HOOK_METRIC_GOSSIP; }
+    static HookMetricType GetHookType(Hooks::BGEvents) { return HOOK_METRIC_BG; }
+    static HookMetricType GetHookType(Hooks::InstanceEvents) { return HOOK_METRIC_INSTANCE; }
+
+    // Hooks can nest, the caller holds the Eluna lock
+    void BeginHook(HookMetricType type);
+    void EndHook();
+
+    // lua_Alloc that keeps count of the bytes used by the Lua state, ud is the ElunaMetrics
+    static void* Allocate(void* ud, void* ptr, size_t osize, size_t nsize);
+    // Counts the garbage collection cycles of the Lua state
+    void WatchGarbageCollection(lua_State* L);
+
+    // Serves the metrics in the Prometheus text format if enabled in the config
+    void StartServer(HttpManager const* httpManager);
+    void StopServer();
+    std::string Render() const;
+
+    std::atomic<uint64_t> luaCalls;
+    std::atomic<uint64_t> luaErrors;
+    std::atomic<uint64_t> luaMemory;
+    std::atomic<uint64_t> gcCycles;
+    std::atomic<uint64_t> gcCollectNanoseconds;
+    std::atomic<uint64_t> timedEventCalls;
+    std::atomic<int64_t> timedEvents;
+    std::atomic<int64_t> dbCallbacksPending;
+
+private:
+    struct HookCounters
+    {
+        std::atomic<uint64_t> nanoseconds;
+        std::atomic<uint64_t> buckets[BUCKET_COUNT];
+    };
+
+    struct HookTimer
+    {
+        HookMetricType type;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    static int OnGarbageCollected(lua_State* L);
+
+    HookCounters hooks[HOOK_METRIC_COUNT];
+    std::vector<HookTimer> hookTimers;
+
+    HttpManager const* http;
+    std::unique_ptr<httplib::Server> server;
+    std::thread serverThread;
+};
+
+#endif // _ELUNA_METRICS_H
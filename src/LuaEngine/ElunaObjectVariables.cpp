@@ -0,0 +1,90 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "ElunaObjectVariables.h"
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+};
+
+ObjectVariableStore::ObjectVariableStore()
+    : count(0)
+{
+}
+
+void ObjectVariableStore::PushTable(lua_State* L, const void* object)
+{
+    auto itr = tables.find(object);
+    if (itr != tables.end())
+    {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, itr->second);
+        return;
+    }
+
+    lua_newtable(L);
+    lua_pushvalue(L, -1);
+    tables[object] = luaL_ref(L, LUA_REGISTRYINDEX);
+    count.store(tables.size(), std::memory_order_relaxed);
+}
+
+void ObjectVariableStore::Get(lua_State* L, const void* object, int keyIdx)
+{
+    keyIdx = lua_absindex(L, keyIdx);
+    if (lua_isnoneornil(L, keyIdx))
+    {
+        PushTable(L, object);
+        return;
+    }
+
+    auto itr = tables.find(object);
+    if (itr == tables.end())
+    {
+        lua_pushnil(L);
+        return;
+    }
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, itr->second);
+    lua_pushvalue(L, keyIdx);
+    lua_rawget(L, -2);
+    lua_remove(L, -2);
+}
+
+void ObjectVariableStore::Set(lua_State* L, const void* object, int keyIdx, int valueIdx)
+{
+    keyIdx = lua_absindex(L, keyIdx);
+    valueIdx = lua_absindex(L, valueIdx);
+    luaL_argcheck(L, !lua_isnoneornil(L, keyIdx), keyIdx, "key expected");
+
+    // Clearing a value doesn't need a table
+    if (lua_isnoneornil(L, valueIdx) && tables.find(object) == tables.end())
+        return;
+
+    PushTable(L, object);
+    lua_pushvalue(L, keyIdx);
+    lua_pushvalue(L, valueIdx);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+void ObjectVariableStore::Free(lua_State* L, const void* object)
+{
+    auto itr = tables.find(object);
+    if (itr == tables.end())
+        return;
+
+    luaL_unref(L, LUA_REGISTRYINDEX, itr->second);
+    tables.erase(itr);
+    count.store(tables.size(), std::memory_order_relaxed);
+}
+
+void ObjectVariableStore::Clear()
+{
+    // The tables go with the Lua state
+    tables.clear();
+    count.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,49 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_OBJECT_VARIABLES_H
+#define _ELUNA_OBJECT_VARIABLES_H
+
+#include <atomic>
+#include <cstddef>
+#include <unordered_map>
+
+struct lua_State;
+
+/*
+ * Values set with SetData on world objects and maps.
+ *
+ * Each object with values has a table in the registry found by the object's address,
+ *   so getting a value is a hash lookup and a table read.
+ * The table is freed by the object's destroy hook, objects without values only cost an atomic read there.
+ *
+ * Only used with the Eluna lock held except for IsEmpty, the values are dropped when the Lua state is closed.
+ */
+class ObjectVariableStore
+{
+public:
+    ObjectVariableStore();
+
+    // Pushes the object's value for the key at keyIdx, or its table of values if the key is nil
+    void Get(lua_State* L, const void* object, int keyIdx);
+    // Sets the object's value for the key at keyIdx to the value at valueIdx
+    void Set(lua_State* L, const void* object, int keyIdx, int valueIdx);
+    // Frees the values of a destroyed object
+    void Free(lua_State* L, const void* object);
+    void Clear();
+
+    // Can be called without the Eluna lock to skip locking for objects that can't have values
+    bool IsEmpty() const { return count.load(std::memory_order_relaxed) == 0; }
+
+private:
+    // Pushes the object's table, creating it if needed
+    void PushTable(lua_State* L, const void* object);
+
+    std::unordered_map<const void*, int> tables;
+    std::atomic<size_t> count;
+};
+
+#endif // _ELUNA_OBJECT_VARIABLES_H
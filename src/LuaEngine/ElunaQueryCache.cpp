@@ -0,0 +1,216 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "ElunaQueryCache.h"
+#include "LuaEngine.h"
+#include "ElunaIncludes.h"
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+};
+
+void QueryCache::Result::AddCell(Cell const& cell)
+{
+    cells.push_back(cell);
+    if (!columns.empty() && cells.size() % columns.size() == 0)
+        ++rowCount;
+}
+
+void QueryCache::Result::AddNull()
+{
+    Cell cell;
+    cell.type = CELL_NULL;
+    cell.length = 0;
+    cell.offset = 0;
+    AddCell(cell);
+}
+
+void QueryCache::Result::AddNumber(double value)
+{
+    Cell cell;
+    cell.type = CELL_NUMBER;
+    cell.length = 0;
+    cell.number = value;
+    AddCell(cell);
+}
+
+void QueryCache::Result::AddString(const char* str, size_t length)
+{
+    Cell cell;
+    cell.type = CELL_STRING;
+    cell.length = static_cast<uint32_t>(length);
+    cell.offset = strings.size();
+    strings.append(str, length);
+    AddCell(cell);
+}
+
+size_t QueryCache::Result::GetSize() const
+{
+    size_t total = sizeof(Result) + cells.capacity() * sizeof(Cell) + strings.capacity();
+    for (std::string const& column : columns)
+        total += sizeof(std::string) + column.capacity();
+    return total;
+}
+
+void QueryCache::Result::Push(lua_State* L) const
+{
+    int columnCount = static_cast<int>(columns.size());
+    luaL_checkstack(L, columnCount + LUA_MINSTACK, "too many columns");
+
+    lua_createtable(L, static_cast<int>(rowCount), 0);
+    int tbl = lua_gettop(L);
+
+    // The names are created once and copied into every row
+    int names = tbl + 1;
+    for (std::string const& column : columns)
+        lua_pushlstring(L, column.data(), column.size());
+
+    const Cell* cell = cells.data();
+    for (uint32_t row = 1; row <= rowCount; ++row)
+    {
+        lua_createtable(L, 0, columnCount);
+        for (int i = 0; i < columnCount; ++i, ++cell)
+        {
+            switch (cell->type)
+            {
+                case CELL_NUMBER:
+                    lua_pushnumber(L, cell->number);
+                    break;
+                case CELL_STRING:
+                    lua_pushlstring(L, strings.data() + cell->offset, cell->length);
+                    break;
+                default:
+                    continue;
+            }
+            lua_pushvalue(L, names + i);
+            lua_insert(L, -2);
+            lua_rawset(L, -3);
+        }
+        lua_rawseti(L, tbl, row);
+    }
+
+    lua_settop(L, tbl);
+}
+
+QueryCache::QueryCache()
+    : size(0),
+    hits(0),
+    misses(0),
+    evictions(0),
+    defaultTtl(60),
+    maxSize(16 * 1024 * 1024)
+{
+    LoadConfig();
+}
+
+void QueryCache::LoadConfig()
+{
+#if defined(AZEROTHCORE)
+    defaultTtl = eConfigMgr->GetOption<uint32>("Eluna.QueryCache.DefaultTTL", 60);
+    maxSize = static_cast<size_t>(eConfigMgr->GetOption<uint32>("Eluna.QueryCache.MaxSize", 16)) * 1024 * 1024;
+#else
+    defaultTtl = eConfigMgr->GetIntDefault("Eluna.QueryCache.DefaultTTL", 60);
+    maxSize = static_cast<size_t>(eConfigMgr->GetIntDefault("Eluna.QueryCache.MaxSize", 16)) * 1024 * 1024;
+#endif
+}
+
+std::shared_ptr<QueryCache::Result const> QueryCache::Find(const std::string& key)
+{
+    EntryMap::iterator itr = entries.find(key);
+    if (itr == entries.end())
+    {
+        ++misses;
+        return nullptr;
+    }
+
+    if (itr->second.expires <= Clock::now())
+    {
+        Remove(itr);
+        ++misses;
+        return nullptr;
+    }
+
+    lru.splice(lru.begin(), lru, itr->second.lru);
+    ++hits;
+    return itr->second.result;
+}
+
+void QueryCache::Store(const std::string& key, std::shared_ptr<Result const> result, uint32_t ttl)
+{
+    EntryMap::iterator itr = entries.find(key);
+    if (itr != entries.end())
+        Remove(itr);
+
+    size_t resultSize = result->GetSize() + key.size();
+    if (resultSize > maxSize)
+        return;
+
+    // Make room from the least recently used end
+    while (!lru.empty() && size + resultSize > maxSize)
+    {
+        Remove(entries.find(lru.back()));
+        ++evictions;
+    }
+
+    lru.push_front(key);
+
+    Entry& entry = entries[key];
+    entry.result = std::move(result);
+    entry.expires = Clock::now() + std::chrono::seconds(ttl ? ttl : defaultTtl);
+    entry.lru = lru.begin();
+    size += resultSize;
+}
+
+void QueryCache::Remove(EntryMap::iterator itr)
+{
+    size -= itr->second.result->GetSize() + itr->first.size();
+    lru.erase(itr->second.lru);
+    entries.erase(itr);
+}
+
+size_t QueryCache::Invalidate(std::string_view key, bool partial)
+{
+    if (!partial)
+    {
+        EntryMap::iterator itr = entries.find(std::string(key));
+        if (itr == entries.end())
+            return 0;
+        Remove(itr);
+        return 1;
+    }
+
+    size_t removed = 0;
+    for (EntryMap::iterator itr = entries.begin(); itr != entries.end();)
+    {
+        EntryMap::iterator current = itr++;
+        if (current->first.find(key) != std::string::npos)
+        {
+            Remove(current);
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+void QueryCache::Clear()
+{
+    entries.clear();
+    lru.clear();
+    size = 0;
+}
+
+QueryCache::Stats QueryCache::GetStats() const
+{
+    Stats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.entries = entries.size();
+    stats.size = size;
+    return stats;
+}
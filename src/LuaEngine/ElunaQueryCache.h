@@ -0,0 +1,130 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_QUERY_CACHE_H
+#define _ELUNA_QUERY_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct lua_State;
+
+/*
+ * Result sets of WorldDBQueryCached and the like, kept by query until they expire or are invalidated.
+ *
+ * Only used with the Eluna lock held, the cache is emptied when the Lua state is closed.
+ */
+class QueryCache
+{
+public:
+    /*
+     * A result set copied out of the database library types.
+     * The values are stored row by row in one array and the strings in one buffer.
+     */
+    class Result
+    {
+    public:
+        Result() : rowCount(0) { }
+
+        void AddColumn(std::string name) { columns.push_back(std::move(name)); }
+        // Values are added row by row, a row is complete after GetColumnCount values
+        void AddNull();
+        void AddNumber(double value);
+        void AddString(const char* str, size_t length);
+
+        uint32_t GetColumnCount() const { return static_cast<uint32_t>(columns.size()); }
+        uint32_t GetRowCount() const { return rowCount; }
+        // Approximate memory used by the result
+        size_t GetSize() const;
+
+        // Pushes an array of row tables like ElunaQuery:GetRows
+        void Push(lua_State* L) const;
+
+    private:
+        enum CellType : uint8_t
+        {
+            CELL_NULL,
+            CELL_NUMBER,
+            CELL_STRING
+        };
+
+        struct Cell
+        {
+            CellType type;
+            uint32_t length;
+            union
+            {
+                double number;
+                size_t offset;
+            };
+        };
+
+        void AddCell(Cell const& cell);
+
+        std::vector<std::string> columns;
+        std::vector<Cell> cells;
+        std::string strings;
+        uint32_t rowCount;
+    };
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t entries;
+        size_t size;
+    };
+
+    QueryCache();
+
+    void LoadConfig();
+
+    // Returns the result stored for the key if it has not expired, counting a hit or a miss
+    std::shared_ptr<Result const> Find(const std::string& key);
+    // Stores the result for ttl seconds, 0 uses the configured default
+    void Store(const std::string& key, std::shared_ptr<Result const> result, uint32_t ttl);
+    // Removes the result of the key, or of every key containing it if partial is true. Returns the number removed.
+    size_t Invalidate(std::string_view key, bool partial);
+    void Clear();
+
+    Stats GetStats() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        std::shared_ptr<Result const> result;
+        Clock::time_point expires;
+        // Position in the lru list
+        std::list<std::string>::iterator lru;
+    };
+
+    typedef std::unordered_map<std::string, Entry> EntryMap;
+
+    void Remove(EntryMap::iterator itr);
+
+    EntryMap entries;
+    // Keys from the most to the least recently used
+    std::list<std::string> lru;
+    size_t size;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+
+    uint32_t defaultTtl;
+    size_t maxSize;
+};
+
+#endif // _ELUNA_QUERY_CACHE_H
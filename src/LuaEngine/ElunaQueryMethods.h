@@ -34,6 +34,40 @@ namespace LuaQuery
         }
     }
 
+    /*
+     * Pushes the value of the field the same way as GetRow: numbers as numbers, other types as strings.
+     * Numbers are read with the field's getter instead of being copied to a string first.
+     *
+     * Pushes nothing and returns false if the field is NULL.
+     */
+    static bool PushField(lua_State* L, Field& field)
+    {
+        return ElunaUtil::ReadField(field,
+            [L](double value) { lua_pushnumber(L, value); },
+            [L](const char* str, size_t length) { lua_pushlstring(L, str, length); });
+    }
+
+    /*
+     * Pushes the names of the columns in order, so they are created once and copied with lua_pushvalue.
+     *
+     * Returns the stack index of the first name.
+     */
+    static int PushColumnNames(lua_State* L, ElunaQuery* result, uint32 count)
+    {
+        luaL_checkstack(L, count + LUA_MINSTACK, "too many columns");
+        int first = lua_gettop(L) + 1;
+
+#if defined TRINITY || AZEROTHCORE
+        for (uint32 i = 0; i < count; ++i)
+            Eluna::Push(L, RESULT->GetFieldName(i));
+#else
+        const QueryFieldNames& names = RESULT->GetFieldNames();
+        for (uint32 i = 0; i < count; ++i)
+            Eluna::Push(L, names[i]);
+#endif
+        return first;
+    }
+
     /**
      * Returns `true` if the specified column of the current row is `NULL`, otherwise `false`.
      *
@@ -294,74 +328,126 @@ namespace LuaQuery
         {
 #if defined TRINITY || AZEROTHCORE
             Eluna::Push(L, RESULT->GetFieldName(i));
-
-            std::string _str = row[i].Get<std::string>();
-            const char* str = _str.c_str();
-            if (row[i].IsNull() || !str)
-                Eluna::Push(L);
-            else
-            {
-                // MYSQL_TYPE_LONGLONG Interpreted as string for lua
-                switch (row[i].GetType())
-                {
-#if defined TRINITY || AZEROTHCORE
-                    case DatabaseFieldTypes::Int8:
-                    case DatabaseFieldTypes::Int16:
-                    case DatabaseFieldTypes::Int32:
-                    case DatabaseFieldTypes::Int64:
-                    case DatabaseFieldTypes::Float:
-                    case DatabaseFieldTypes::Double:
 #else
-                    case MYSQL_TYPE_TINY:
-                    case MYSQL_TYPE_YEAR:
-                    case MYSQL_TYPE_SHORT:
-                    case MYSQL_TYPE_INT24:
-                    case MYSQL_TYPE_LONG:
-                    case MYSQL_TYPE_LONGLONG:
-                    case MYSQL_TYPE_BIT:
-                    case MYSQL_TYPE_FLOAT:
-                    case MYSQL_TYPE_DOUBLE:
-                    case MYSQL_TYPE_DECIMAL:
-                    case MYSQL_TYPE_NEWDECIMAL:
+            Eluna::Push(L, names[i]);
 #endif
-                        Eluna::Push(L, strtod(str, NULL));
-                        break;
-                    default:
-                        Eluna::Push(L, str);
-                        break;
+
+            if (!PushField(L, row[i]))
+                Eluna::Push(L);
+
+            lua_rawset(L, tbl);
         }
+
+        lua_settop(L, tbl);
+        return 1;
     }
-#else
-            Eluna::Push(L, names[i]);
 
-            const char* str = row[i].GetString();
-            if (row[i].IsNULL() || !str)
-                Eluna::Push(L);
-            else
+    /**
+     * Returns all the rows from the current row to the end of the result set in one call.
+     *
+     * Each row is a table like the one returned by [ElunaQuery:GetRow].
+     * This is faster than calling [ElunaQuery:GetRow] and [ElunaQuery:NextRow] for each row,
+     *   the tables are allocated at their final size and the column names are only created once.
+     *
+     * The result set is at its end afterwards, calling this again returns no rows.
+     *
+     *     local query = WorldDBQuery("SELECT entry, name FROM creature_template LIMIT 2")
+     *     if query then
+     *         for i, row in ipairs(query:GetRows()) do
+     *             print(row.entry, row.name)
+     *         end
+     *     end
+     *
+     * @return table rows : array of tables filled with row columns and data where `T[i][column] = data`
+     */
+    int GetRows(lua_State* L, ElunaQuery* result)
+    {
+        uint32 columns = RESULT->GetFieldCount();
+        uint64 rowCount = RESULT->GetRowCount();
+
+        lua_createtable(L, rowCount > INT_MAX ? 0 : (int)rowCount, 0);
+        int tbl = lua_gettop(L);
+        int names = PushColumnNames(L, result, columns);
+
+        // Nothing is left if the rows were already read to the end
+        int rows = 0;
+        Field* row = RESULT->Fetch();
+        while (row)
+        {
+            lua_createtable(L, 0, columns);
+            for (uint32 i = 0; i < columns; ++i)
             {
-                // MYSQL_TYPE_LONGLONG Interpreted as string for lua
-                switch (row[i].GetType())
-                {
-                    case MYSQL_TYPE_TINY:
-                    case MYSQL_TYPE_SHORT:
-                    case MYSQL_TYPE_INT24:
-                    case MYSQL_TYPE_LONG:
-                    case MYSQL_TYPE_FLOAT:
-                    case MYSQL_TYPE_DOUBLE:
-                        Eluna::Push(L, strtod(str, NULL));
-                        break;
-                    default:
-                        Eluna::Push(L, str);
-                        break;
-                }
+                if (!PushField(L, row[i]))
+                    continue;
+                lua_pushvalue(L, names + i);
+                lua_insert(L, -2);
+                lua_rawset(L, -3);
             }
-#endif
+            lua_rawseti(L, tbl, ++rows);
+            row = RESULT->NextRow() ? RESULT->Fetch() : nullptr;
+        }
+
+        lua_settop(L, tbl);
+        return 1;
+    }
+
+    /**
+     * Returns all the data from the current row to the end of the result set as one array per column.
+     *
+     * Uses fewer tables than [ElunaQuery:GetRows], which matters for large result sets.
+     * `NULL` values are `nil` holes in the arrays, use the returned row count instead of the `#` operator.
+     *
+     * The result set is at its end afterwards, calling this again returns no rows.
+     *
+     *     local query = WorldDBQuery("SELECT entry, name FROM creature_template")
+     *     if query then
+     *         local columns, count = query:GetColumns()
+     *         for i = 1, count do
+     *             print(columns.entry[i], columns.name[i])
+     *         end
+     *     end
+     *
+     * @return table columns : table of column arrays where `T[column][i] = data`
+     * @return uint32 rowCount : the number of rows read
+     */
+    int GetColumns(lua_State* L, ElunaQuery* result)
+    {
+        uint32 columns = RESULT->GetFieldCount();
+        uint64 rowCount = RESULT->GetRowCount();
+        int arraySize = rowCount > INT_MAX ? 0 : (int)rowCount;
+
+        lua_createtable(L, 0, columns);
+        int tbl = lua_gettop(L);
+        int names = PushColumnNames(L, result, columns);
 
+        // The arrays are kept on the stack after the names while filling them
+        luaL_checkstack(L, columns, "too many columns");
+        int arrays = lua_gettop(L) + 1;
+        for (uint32 i = 0; i < columns; ++i)
+        {
+            lua_createtable(L, arraySize, 0);
+            lua_pushvalue(L, names + i);
+            lua_pushvalue(L, -2);
             lua_rawset(L, tbl);
         }
 
+        // Nothing is left if the rows were already read to the end
+        int rows = 0;
+        Field* row = RESULT->Fetch();
+        while (row)
+        {
+            ++rows;
+            for (uint32 i = 0; i < columns; ++i)
+            {
+                if (PushField(L, row[i]))
+                    lua_rawseti(L, arrays + i, rows);
+            }
+            row = RESULT->NextRow() ? RESULT->Fetch() : nullptr;
+        }
+
         lua_settop(L, tbl);
-        return 1;
+        Eluna::Push(L, rows);
+        return 2;
     }
 };
 #undef RESULT
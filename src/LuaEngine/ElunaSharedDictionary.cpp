@@ -0,0 +1,178 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "ElunaSharedDictionary.h"
+
+namespace
+{
+    // Time between the sweeps of expired values of a shard
+    const std::chrono::seconds SWEEP_INTERVAL(5);
+}
+
+bool SharedDictionary::Value::operator==(Value const& other) const
+{
+    if (type != other.type)
+        return false;
+    if (type == VALUE_STRING || type == VALUE_BLOB)
+        return data == other.data;
+    return number == other.number;
+}
+
+SharedDictionary::Shard& SharedDictionary::GetShard(const std::string& key)
+{
+    return shards[std::hash<std::string>()(key) % SHARD_COUNT];
+}
+
+SharedDictionary::EntryMap::iterator SharedDictionary::Find(Shard& shard, const std::string& key, Clock::time_point now)
+{
+    EntryMap::iterator itr = shard.entries.find(key);
+    if (itr != shard.entries.end() && itr->second.expires <= now)
+    {
+        shard.entries.erase(itr);
+        return shard.entries.end();
+    }
+    return itr;
+}
+
+void SharedDictionary::Store(Shard& shard, const std::string& key, Value&& value, uint32_t ttl, Clock::time_point now)
+{
+    if (now >= shard.nextSweep)
+    {
+        for (EntryMap::iterator itr = shard.entries.begin(); itr != shard.entries.end();)
+        {
+            if (itr->second.expires <= now)
+                itr = shard.entries.erase(itr);
+            else
+                ++itr;
+        }
+        shard.nextSweep = now + SWEEP_INTERVAL;
+    }
+
+    Entry& entry = shard.entries[key];
+    entry.value = std::move(value);
+    entry.expires = ttl ? now + std::chrono::milliseconds(ttl) : Clock::time_point::max();
+}
+
+bool SharedDictionary::Get(const std::string& key, Value& value)
+{
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    EntryMap::iterator itr = Find(shard, key, Clock::now());
+    if (itr == shard.entries.end())
+        return false;
+
+    value = itr->second.value;
+    return true;
+}
+
+void SharedDictionary::Set(const std::string& key, Value value, uint32_t ttl)
+{
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    Store(shard, key, std::move(value), ttl, Clock::now());
+}
+
+bool SharedDictionary::Add(const std::string& key, Value value, uint32_t ttl)
+{
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    Clock::time_point now = Clock::now();
+    if (Find(shard, key, now) != shard.entries.end())
+        return false;
+
+    Store(shard, key, std::move(value), ttl, now);
+    return true;
+}
+
+bool SharedDictionary::Increment(const std::string& key, double delta, double init, uint32_t ttl, double& result)
+{
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    Clock::time_point now = Clock::now();
+    EntryMap::iterator itr = Find(shard, key, now);
+    if (itr == shard.entries.end())
+    {
+        Value value;
+        value.type = VALUE_NUMBER;
+        value.number = init + delta;
+        result = value.number;
+        Store(shard, key, std::move(value), ttl, now);
+        return true;
+    }
+
+    // The TTL set with the value is kept
+    Value& value = itr->second.value;
+    if (value.type != VALUE_NUMBER)
+        return false;
+
+    value.number += delta;
+    result = value.number;
+    return true;
+}
+
+bool SharedDictionary::CompareAndSet(const std::string& key, Value const* expected, Value value, uint32_t ttl)
+{
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    Clock::time_point now = Clock::now();
+    EntryMap::iterator itr = Find(shard, key, now);
+    bool found = itr != shard.entries.end();
+    if (found != (expected != nullptr))
+        return false;
+    if (found && !(itr->second.value == *expected))
+        return false;
+
+    Store(shard, key, std::move(value), ttl, now);
+    return true;
+}
+
+bool SharedDictionary::Delete(const std::string& key)
+{
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    EntryMap::iterator itr = Find(shard, key, Clock::now());
+    if (itr == shard.entries.end())
+        return false;
+
+    shard.entries.erase(itr);
+    return true;
+}
+
+void SharedDictionary::Clear()
+{
+    for (Shard& shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.clear();
+    }
+}
+
+size_t SharedDictionary::GetCount()
+{
+    size_t count = 0;
+    for (Shard& shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        count += shard.entries.size();
+    }
+    return count;
+}
+
+std::shared_ptr<SharedDictionary> SharedDictionaryManager::Get(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::shared_ptr<SharedDictionary>& dictionary = dictionaries[name];
+    if (!dictionary)
+        dictionary = std::make_shared<SharedDictionary>();
+    return dictionary;
+}
@@ -0,0 +1,117 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_SHARED_DICTIONARY_H
+#define _ELUNA_SHARED_DICTIONARY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/*
+ * Key/value store for data shared by hooks running on different map threads, like counters and cooldowns.
+ *
+ * The keys are spread over shards that each have their own mutex, so an operation only locks the shard of its key
+ *   and never needs the Eluna lock. Values expire after their TTL and are removed when read or by a periodic sweep of their shard.
+ */
+class SharedDictionary
+{
+public:
+    enum ValueType
+    {
+        VALUE_NUMBER,
+        VALUE_BOOLEAN,
+        VALUE_STRING,
+        // A table encoded with lmarshal, equal tables can encode differently so blobs aren't expected by CompareAndSet
+        VALUE_BLOB
+    };
+
+    struct Value
+    {
+        bool operator==(Value const& other) const;
+
+        ValueType type;
+        // Numbers, and booleans as 0 or 1
+        double number;
+        std::string data;
+    };
+
+    // ttl is in milliseconds, 0 keeps the value until it is changed
+
+    bool Get(const std::string& key, Value& value);
+    void Set(const std::string& key, Value value, uint32_t ttl);
+    // Sets the value only if the key has none, returns false otherwise
+    bool Add(const std::string& key, Value value, uint32_t ttl);
+    // Adds delta to the number, a missing key starts at init and gets the TTL. Returns false if the value isn't a number.
+    bool Increment(const std::string& key, double delta, double init, uint32_t ttl, double& result);
+    // Sets the value only if the current one equals expected, or if there is none when expected is null
+    bool CompareAndSet(const std::string& key, Value const* expected, Value value, uint32_t ttl);
+    bool Delete(const std::string& key);
+    void Clear();
+
+    // Number of values, expired ones not removed yet included
+    size_t GetCount();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        Value value;
+        // Clock::time_point::max() if the value doesn't expire
+        Clock::time_point expires;
+    };
+
+    typedef std::unordered_map<std::string, Entry> EntryMap;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        EntryMap entries;
+        Clock::time_point nextSweep;
+    };
+
+    static const size_t SHARD_COUNT = 16;
+
+    Shard& GetShard(const std::string& key);
+    // Finds the key's entry, removing it if it expired. The shard is locked by the caller.
+    static EntryMap::iterator Find(Shard& shard, const std::string& key, Clock::time_point now);
+    // Stores the entry and sweeps the shard from time to time. The shard is locked by the caller.
+    static void Store(Shard& shard, const std::string& key, Value&& value, uint32_t ttl, Clock::time_point now);
+
+    Shard shards[SHARD_COUNT];
+};
+
+/*
+ * Dictionaries by name, created when first asked for.
+ *
+ * They are kept when Eluna is reloaded so counters and cooldowns survive it.
+ */
+class SharedDictionaryManager
+{
+public:
+    std::shared_ptr<SharedDictionary> Get(const std::string& name);
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<SharedDictionary>> dictionaries;
+};
+
+/*
+ * A dictionary held by a Lua userdata.
+ */
+struct ElunaSharedDictionary
+{
+    explicit ElunaSharedDictionary(std::shared_ptr<SharedDictionary> dictionary) : dictionary(std::move(dictionary)) { }
+
+    std::shared_ptr<SharedDictionary> dictionary;
+};
+
+#endif // _ELUNA_SHARED_DICTIONARY_H
@@ -0,0 +1,285 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef SHAREDDICTIONARYMETHODS_H
+#define SHAREDDICTIONARYMETHODS_H
+
+/***
+ * A key/value store shared by all scripts, returned by [Global:GetSharedDictionary].
+ *
+ * The values are numbers, booleans, strings or tables. Tables are copied in and out, changing a table
+ *   read from the dictionary doesn't change the stored one. Each value can have a TTL after which it is removed.
+ * The dictionary is thread-safe on its own, with a lock for each group of keys instead of the Eluna lock,
+ *   and [ElunaSharedDictionary:Increment] and [ElunaSharedDictionary:CompareAndSet] change a value in one step.
+ * The worker states of [Global:RunAsync] share the dictionaries and use them while the world update runs scripts.
+ *
+ *     local limits = GetSharedDictionary("whisper_limits")
+ *     -- at most 5 whispers per player every 10 seconds
+ *     if limits:Increment(player:GetGUIDLow(), 1, 0, 10) > 5 then
+ *         return false
+ *     end
+ *
+ * Inherits all methods from: none
+ */
+namespace LuaSharedDictionary
+{
+    // Reads the value at idx. Returns false with an error message pushed if it can't be stored.
+    static bool ReadValue(lua_State* L, int idx, SharedDictionary::Value& value)
+    {
+        switch (lua_type(L, idx))
+        {
+            case LUA_TNUMBER:
+                value.type = SharedDictionary::VALUE_NUMBER;
+                value.number = lua_tonumber(L, idx);
+                return true;
+            case LUA_TBOOLEAN:
+                value.type = SharedDictionary::VALUE_BOOLEAN;
+                value.number = lua_toboolean(L, idx) ? 1 : 0;
+                return true;
+            case LUA_TSTRING:
+            {
+                size_t length;
+                const char* str = lua_tolstring(L, idx, &length);
+                value.type = SharedDictionary::VALUE_STRING;
+                value.data.assign(str, length);
+                return true;
+            }
+            case LUA_TTABLE:
+            {
+                lua_pushcfunction(L, &mar_encode);
+                lua_pushvalue(L, idx);
+                if (lua_pcall(L, 1, 1, 0) != LUA_OK)
+                    return false;
+
+                size_t length;
+                const char* data = lua_tolstring(L, -1, &length);
+                value.type = SharedDictionary::VALUE_BLOB;
+                value.data.assign(data, length);
+                lua_pop(L, 1);
+                return true;
+            }
+            default:
+                lua_pushfstring(L, "a %s value can't be stored in a shared dictionary", luaL_typename(L, idx));
+                return false;
+        }
+    }
+
+    // Pushes the value. Returns false with an error message pushed if it can't be read.
+    static bool PushValue(lua_State* L, SharedDictionary::Value const& value)
+    {
+        switch (value.type)
+        {
+            case SharedDictionary::VALUE_NUMBER:
+                Eluna::Push(L, value.number);
+                return true;
+            case SharedDictionary::VALUE_BOOLEAN:
+                Eluna::Push(L, value.number != 0);
+                return true;
+            case SharedDictionary::VALUE_STRING:
+                lua_pushlstring(L, value.data.data(), value.data.size());
+                return true;
+            default:
+                lua_pushcfunction(L, &mar_decode);
+                lua_pushlstring(L, value.data.data(), value.data.size());
+                return lua_pcall(L, 1, 1, 0) == LUA_OK;
+        }
+    }
+
+    // TTL in seconds to milliseconds
+    static uint32 CheckTTL(lua_State* L, int idx)
+    {
+        double ttl = luaL_optnumber(L, idx, 0);
+        luaL_argcheck(L, ttl >= 0 && ttl <= 4294967.0, idx, "TTL out of range");
+        return static_cast<uint32>(std::ceil(ttl * 1000));
+    }
+
+    /**
+     * Returns the value of the key, or nil if it has none.
+     *
+     * @param string key
+     * @return value
+     */
+    int Get(lua_State* L, ElunaSharedDictionary* dict)
+    {
+        size_t length;
+        const char* key = luaL_checklstring(L, 2, &length);
+
+        // Nothing with a destructor can live across lua_error
+        bool pushed;
+        {
+            SharedDictionary::Value value;
+            if (!dict->dictionary->Get(std::string(key, length), value))
+                return 0;
+            pushed = PushValue(L, value);
+        }
+
+        if (!pushed)
+            return lua_error(L);
+        return 1;
+    }
+
+    /**
+     * Sets the value of the key, a nil value removes it.
+     *
+     * @param string key
+     * @param value : a number, boolean, string or table
+     * @param number ttl = 0 : seconds until the value is removed, 0 to keep it
+     */
+    int Set(lua_State* L, ElunaSharedDictionary* dict)
+    {
+        size_t length;
+        const char* key = luaL_checklstring(L, 2, &length);
+        uint32 ttl = CheckTTL(L, 4);
+
+        bool stored;
+        {
+            if (lua_isnoneornil(L, 3))
+            {
+                dict->dictionary->Delete(std::string(key, length));
+                return 0;
+            }
+
+            SharedDictionary::Value value;
+            stored = ReadValue(L, 3, value);
+            if (stored)
+                dict->dictionary->Set(std::string(key, length), std::move(value), ttl);
+        }
+
+        if (!stored)
+            return lua_error(L);
+        return 0;
+    }
+
+    /**
+     * Sets the value of the key only if it has none.
+     *
+     * @param string key
+     * @param value : a number, boolean, string or table
+     * @param number ttl = 0 : seconds until the value is removed, 0 to keep it
+     * @return bool added : false if the key already had a value
+     */
+    int Add(lua_State* L, ElunaSharedDictionary* dict)
+    {
+        size_t length;
+        const char* key = luaL_checklstring(L, 2, &length);
+        uint32 ttl = CheckTTL(L, 4);
+
+        bool read;
+        bool added = false;
+        {
+            SharedDictionary::Value value;
+            read = ReadValue(L, 3, value);
+            if (read)
+                added = dict->dictionary->Add(std::string(key, length), std::move(value), ttl);
+        }
+
+        if (!read)
+            return lua_error(L);
+        Eluna::Push(L, added);
+        return 1;
+    }
+
+    /**
+     * Adds delta to the number of the key and returns the result.
+     *
+     * A key without a value starts at init and gets the TTL, the TTL of an existing value isn't changed.
+     * Returns nil if the value isn't a number.
+     *
+     * @param string key
+     * @param number delta = 1
+     * @param number init = 0 : the number a key without a value starts at
+     * @param number ttl = 0 : seconds until a new value is removed, 0 to keep it
+     * @return number result
+     */
+    int Increment(lua_State* L, ElunaSharedDictionary* dict)
+    {
+        size_t length;
+        const char* key = luaL_checklstring(L, 2, &length);
+        double delta = Eluna::CHECKVAL<double>(L, 3, 1.0);
+        double init = Eluna::CHECKVAL<double>(L, 4, 0.0);
+        uint32 ttl = CheckTTL(L, 5);
+
+        double result;
+        if (!dict->dictionary->Increment(std::string(key, length), delta, init, ttl, result))
+            return 0;
+
+        Eluna::Push(L, result);
+        return 1;
+    }
+
+    /**
+     * Sets the value of the key only if its current value equals expected.
+     *
+     * A nil expected value means the key must have no value.
+     * Tables can be set but not expected, their copies don't compare reliably.
+     *
+     * @param string key
+     * @param expected : nil, a number, boolean or string the key must have
+     * @param value : a number, boolean, string or table
+     * @param number ttl = 0 : seconds until the value is removed, 0 to keep it
+     * @return bool set : false if the value was not the expected one
+     */
+    int CompareAndSet(lua_State* L, ElunaSharedDictionary* dict)
+    {
+        size_t length;
+        const char* key = luaL_checklstring(L, 2, &length);
+        uint32 ttl = CheckTTL(L, 5);
+        luaL_argcheck(L, lua_type(L, 3) != LUA_TTABLE, 3, "tables can't be compared");
+
+        bool read;
+        bool set = false;
+        {
+            SharedDictionary::Value expected;
+            SharedDictionary::Value value;
+            bool hasExpected = !lua_isnoneornil(L, 3);
+            read = (!hasExpected || ReadValue(L, 3, expected)) && ReadValue(L, 4, value);
+            if (read)
+                set = dict->dictionary->CompareAndSet(std::string(key, length), hasExpected ? &expected : nullptr, std::move(value), ttl);
+        }
+
+        if (!read)
+            return lua_error(L);
+        Eluna::Push(L, set);
+        return 1;
+    }
+
+    /**
+     * Removes the value of the key.
+     *
+     * @param string key
+     * @return bool removed : false if the key had no value
+     */
+    int Delete(lua_State* L, ElunaSharedDictionary* dict)
+    {
+        size_t length;
+        const char* key = luaL_checklstring(L, 2, &length);
+
+        Eluna::Push(L, dict->dictionary->Delete(std::string(key, length)));
+        return 1;
+    }
+
+    /**
+     * Removes all the values.
+     */
+    int Clear(lua_State* /*L*/, ElunaSharedDictionary* dict)
+    {
+        dict->dictionary->Clear();
+        return 0;
+    }
+
+    /**
+     * Returns the number of values, including expired ones not removed yet.
+     *
+     * @return uint32 count
+     */
+    int GetCount(lua_State* L, ElunaSharedDictionary* dict)
+    {
+        Eluna::Push(L, static_cast<uint32>(dict->dictionary->GetCount()));
+        return 1;
+    }
+};
+
+#endif
@@ -0,0 +1,122 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "ElunaStatements.h"
+
+namespace
+{
+    struct ParamTypeName
+    {
+        const char* name;
+        StatementParamType type;
+    };
+
+    const ParamTypeName PARAM_TYPE_NAMES[] =
+    {
+        { "bool", STMT_PARAM_BOOL },
+        { "int8", STMT_PARAM_INT8 },
+        { "int16", STMT_PARAM_INT16 },
+        { "int32", STMT_PARAM_INT32 },
+        { "int64", STMT_PARAM_INT64 },
+        { "uint8", STMT_PARAM_UINT8 },
+        { "uint16", STMT_PARAM_UINT16 },
+        { "uint32", STMT_PARAM_UINT32 },
+        { "uint64", STMT_PARAM_UINT64 },
+        { "float", STMT_PARAM_FLOAT },
+        { "double", STMT_PARAM_DOUBLE },
+        { "string", STMT_PARAM_STRING }
+    };
+}
+
+bool StatementRegistry::Add(const std::string& name, ElunaDatabase database, std::string_view sql, std::vector<StatementParamType> const& params, std::string& error)
+{
+    LuaStatement statement;
+    statement.database = database;
+    statement.params = params;
+    statement.length = 0;
+
+    // Split at the ? outside of quotes and comments
+    size_t start = 0;
+    size_t pos = 0;
+    while (pos < sql.size())
+    {
+        char c = sql[pos];
+        if (c == '\'' || c == '"' || c == '`')
+        {
+            for (++pos; pos < sql.size() && sql[pos] != c; ++pos)
+            {
+                if (sql[pos] == '\\' && c != '`')
+                    ++pos;
+            }
+            if (pos >= sql.size())
+            {
+                error = "unterminated quote";
+                return false;
+            }
+        }
+        else if (c == '#' || (c == '-' && sql.substr(pos, 3) == "-- "))
+        {
+            pos = sql.find('\n', pos);
+            if (pos == std::string_view::npos)
+                break;
+        }
+        else if (c == '/' && sql.substr(pos, 2) == "/*")
+        {
+            pos = sql.find("*/", pos + 2);
+            if (pos == std::string_view::npos)
+            {
+                error = "unterminated comment";
+                return false;
+            }
+            ++pos;
+        }
+        else if (c == '?')
+        {
+            statement.fragments.emplace_back(sql.substr(start, pos - start));
+            start = pos + 1;
+        }
+        ++pos;
+    }
+    statement.fragments.emplace_back(sql.substr(start));
+
+    if (statement.fragments.size() != params.size() + 1)
+    {
+        error = "the statement has " + std::to_string(statement.fragments.size() - 1) + " placeholders but " + std::to_string(params.size()) + " parameter types";
+        return false;
+    }
+
+    for (std::string const& fragment : statement.fragments)
+        statement.length += fragment.size();
+
+    statements[name] = std::move(statement);
+    return true;
+}
+
+LuaStatement const* StatementRegistry::Find(const std::string& name) const
+{
+    auto itr = statements.find(name);
+    if (itr == statements.end())
+        return nullptr;
+    return &itr->second;
+}
+
+void StatementRegistry::Clear()
+{
+    statements.clear();
+}
+
+bool StatementRegistry::ParseParamType(std::string_view name, StatementParamType& type)
+{
+    for (ParamTypeName const& entry : PARAM_TYPE_NAMES)
+    {
+        if (name == entry.name)
+        {
+            type = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
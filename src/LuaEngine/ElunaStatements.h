@@ -0,0 +1,83 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_STATEMENTS_H
+#define _ELUNA_STATEMENTS_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum ElunaDatabase
+{
+    ELUNA_WORLD_DB,
+    ELUNA_CHARACTER_DB,
+    ELUNA_AUTH_DB
+};
+
+enum StatementParamType
+{
+    STMT_PARAM_BOOL,
+    STMT_PARAM_INT8,
+    STMT_PARAM_INT16,
+    STMT_PARAM_INT32,
+    STMT_PARAM_INT64,
+    STMT_PARAM_UINT8,
+    STMT_PARAM_UINT16,
+    STMT_PARAM_UINT32,
+    STMT_PARAM_UINT64,
+    STMT_PARAM_FLOAT,
+    STMT_PARAM_DOUBLE,
+    STMT_PARAM_STRING
+};
+
+/*
+ * A statement declared by a script, split at its placeholders.
+ * The SQL of a call is fragments[0] param[0] fragments[1] ... param[n-1] fragments[n].
+ */
+struct LuaStatement
+{
+    ElunaDatabase database;
+    std::vector<std::string> fragments;
+    std::vector<StatementParamType> params;
+    // Length of all the fragments
+    size_t length;
+};
+
+/*
+ * SQL collected by a script with CharDBTransaction and the like, committed as one transaction.
+ */
+struct ElunaTransaction
+{
+    explicit ElunaTransaction(ElunaDatabase database) : database(database), committed(false) { }
+
+    ElunaDatabase database;
+    std::vector<std::string> statements;
+    bool committed;
+};
+
+/*
+ * Named statements declared with WorldDBPrepare, CharDBPrepare and AuthDBPrepare.
+ *
+ * Only used with the Eluna lock held, the statements are removed when the Lua state is closed.
+ */
+class StatementRegistry
+{
+public:
+    // Adds or replaces the statement, returns false and sets error if the placeholders don't match the parameters
+    bool Add(const std::string& name, ElunaDatabase database, std::string_view sql, std::vector<StatementParamType> const& params, std::string& error);
+    LuaStatement const* Find(const std::string& name) const;
+    void Clear();
+
+    // Parses a type name like "uint32" or "string"
+    static bool ParseParamType(std::string_view name, StatementParamType& type);
+
+private:
+    std::unordered_map<std::string, LuaStatement> statements;
+};
+
+#endif // _ELUNA_STATEMENTS_H
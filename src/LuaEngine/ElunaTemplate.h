@@ -72,6 +72,8 @@ public:
     bool CanInvalidate() const { return _invalidate; }
     // Returns pointer to the wrapped object's type name
     const char* GetTypeName() const { return type_name; }
+    // Returns whether the wrapped object is a borrowed view that lua must not modify or free
+    bool IsView() const { return _view; }
 
     // Sets the object pointer that is wrapped
     void SetObj(void* obj)
@@ -103,10 +105,32 @@ public:
         if (CanInvalidate())
             callstackid = 1;
     }
+    // Marks the wrapped object as a borrowed view, invalidated at end of calls
+    void SetView()
+    {
+        _view = true;
+        _invalidate = true;
+        SetValid(true);
+    }
+    // Replaces a borrowed view with an object owned by lua
+    void Detach(void* obj)
+    {
+        _view = false;
+        _invalidate = false;
+        SetObj(obj);
+    }
+    // Gives up the wrapped object, the pointer is invalid from now on and never freed by lua
+    void Disown()
+    {
+        _view = false;
+        object = NULL;
+        callstackid = 1;
+    }
 
 private:
     uint64 callstackid;
     bool _invalidate;
+    bool _view;
     void* object;
     const char* type_name;
 };
@@ -283,6 +307,31 @@ public:
         return 1;
     }
 
+    // Pushes a borrowed read-only view of obj that lua never frees.
+    // Methods that modify the object must go through CopyOnWrite.
+    // Returns the pushed ElunaObject so the caller can invalidate the view when obj goes away.
+    static ElunaObject* PushView(lua_State* L, T const* obj)
+    {
+        Push(L, obj);
+        ElunaObject* elunaObj = Eluna::CHECKOBJ<ElunaObject>(L, -1, false);
+        if (elunaObj)
+            elunaObj->SetView();
+        return elunaObj;
+    }
+
+    // Returns a modifiable object for the userdata at narg.
+    // A view is first replaced with a copy of the viewed object owned by lua.
+    static T* CopyOnWrite(lua_State* L, int narg, T* obj)
+    {
+        ElunaObject* elunaObj = Eluna::CHECKOBJ<ElunaObject>(L, narg);
+        if (!elunaObj->IsView())
+            return obj;
+
+        T* copy = new T(*obj);
+        elunaObj->Detach(copy);
+        return copy;
+    }
+
     static T* Check(lua_State* L, int narg, bool error = true)
     {
         ElunaObject* elunaObj = Eluna::CHECKTYPE(L, narg, tname, error);
@@ -346,7 +395,7 @@ public:
     {
         // Get object pointer (and check type, no error)
         ElunaObject* obj = Eluna::CHECKOBJ<ElunaObject>(L, 1, false);
-        if (obj && manageMemory)
+        if (obj && manageMemory && !obj->IsView())
             delete static_cast<T*>(obj->GetObj());
         delete obj;
         return 0;
@@ -377,7 +426,7 @@ public:
 };
 
 template<typename T>
-ElunaObject::ElunaObject(T * obj, bool manageMemory) : callstackid(1), _invalidate(!manageMemory), object(obj), type_name(ElunaTemplate<T>::tname)
+ElunaObject::ElunaObject(T * obj, bool manageMemory) : callstackid(1), _invalidate(!manageMemory), _view(false), object(obj), type_name(ElunaTemplate<T>::tname)
 {
     SetValid(true);
 }
@@ -0,0 +1,142 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef TRANSACTIONMETHODS_H
+#define TRANSACTIONMETHODS_H
+
+/***
+ * SQL statements committed to a database as one transaction.
+ *
+ * Created with [Global:WorldDBTransaction], [Global:CharDBTransaction] or [Global:AuthDBTransaction].
+ * The statements are sent to the database together when the transaction is committed,
+ *   instead of one round trip and implicit commit for each [Global:CharDBExecute].
+ *
+ *     local trans = CharDBTransaction()
+ *     for guid, points in pairs(rewards) do
+ *         trans:AppendStatement("add_points", points, guid)
+ *     end
+ *     trans:Commit(function(success)
+ *         print("rewards saved", success)
+ *     end)
+ *
+ * Inherits all methods from: none
+ */
+namespace LuaTransaction
+{
+    static void CheckNotCommitted(lua_State* L, ElunaTransaction* trans)
+    {
+        if (trans->committed)
+            luaL_error(L, "the transaction was already committed");
+    }
+
+    /**
+     * Adds a SQL statement to the transaction.
+     *
+     * @param string sql : statement to execute
+     */
+    int Append(lua_State* L, ElunaTransaction* trans)
+    {
+        size_t length;
+        const char* sql = luaL_checklstring(L, 2, &length);
+        CheckNotCommitted(L, trans);
+
+        trans->statements.emplace_back(sql, length);
+        return 0;
+    }
+
+    /**
+     * Adds a statement declared with [Global:WorldDBPrepare], [Global:CharDBPrepare] or [Global:AuthDBPrepare] to the transaction.
+     *
+     * The statement must have been declared for the database of the transaction.
+     *
+     * @param string name : name of the statement
+     * @param ... : one argument for each parameter of the statement
+     */
+    int AppendStatement(lua_State* L, ElunaTransaction* trans)
+    {
+        LuaStatement const& statement = LuaGlobalFunctions::CheckStatement(L, 2);
+        CheckNotCommitted(L, trans);
+        if (statement.database != trans->database)
+            return luaL_argerror(L, 2, "the statement was declared for another database");
+
+        std::string sql;
+        switch (trans->database)
+        {
+            case ELUNA_CHARACTER_DB:
+                LuaGlobalFunctions::BindStatement(L, statement, 3, CharacterDatabase, sql);
+                break;
+            case ELUNA_AUTH_DB:
+                LuaGlobalFunctions::BindStatement(L, statement, 3, LoginDatabase, sql);
+                break;
+            default:
+                LuaGlobalFunctions::BindStatement(L, statement, 3, WorldDatabase, sql);
+                break;
+        }
+        trans->statements.push_back(std::move(sql));
+        return 0;
+    }
+
+    /**
+     * Returns the number of statements in the transaction.
+     *
+     * @return uint32 size
+     */
+    int GetSize(lua_State* L, ElunaTransaction* trans)
+    {
+        Eluna::Push(L, static_cast<uint32>(trans->statements.size()));
+        return 1;
+    }
+
+    /**
+     * Sends the statements to the database to be executed in one transaction.
+     *
+     * The transaction is executed asynchronously. If a callback is given,
+     *   it is called from the world update when the transaction has finished, with `true` if it was committed
+     *   or `false` if it failed and was rolled back.
+     *
+     * A transaction can only be committed once.
+     *
+     * @param function callback = nil : function that will be called when the transaction has finished
+     */
+    int Commit(lua_State* L, ElunaTransaction* trans)
+    {
+        CheckNotCommitted(L, trans);
+
+        int funcRef = LUA_NOREF;
+        if (!lua_isnoneornil(L, 2))
+        {
+            luaL_checktype(L, 2, LUA_TFUNCTION);
+            lua_pushvalue(L, 2);
+            funcRef = luaL_ref(L, LUA_REGISTRYINDEX);
+            if (funcRef == LUA_REFNIL || funcRef == LUA_NOREF)
+                return luaL_argerror(L, 2, "unable to make a ref to function");
+        }
+
+        trans->committed = true;
+
+        // An empty transaction is still sent if there is a callback waiting for it
+        if (trans->statements.empty() && funcRef == LUA_NOREF)
+            return 0;
+
+        switch (trans->database)
+        {
+            case ELUNA_CHARACTER_DB:
+                LuaGlobalFunctions::CommitStatements(L, CharacterDatabase, trans->statements, funcRef);
+                break;
+            case ELUNA_AUTH_DB:
+                LuaGlobalFunctions::CommitStatements(L, LoginDatabase, trans->statements, funcRef);
+                break;
+            default:
+                LuaGlobalFunctions::CommitStatements(L, WorldDatabase, trans->statements, funcRef);
+                break;
+        }
+
+        std::vector<std::string>().swap(trans->statements);
+        return 0;
+    }
+};
+
+#endif
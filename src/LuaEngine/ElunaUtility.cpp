@@ -10,6 +10,9 @@
 #include "Unit.h"
 #include "GameObject.h"
 #include "DBCStores.h"
+#include "Player.h"
+#include "WorldSession.h"
+#include "WorldPacket.h"
 #ifdef MANGOS
 #include "Timer.h"
 #endif
@@ -24,6 +27,19 @@ uint32 ElunaUtil::GetTimeDiff(uint32 oldMSTime)
     return GetMSTimeDiffToNow(oldMSTime);
 }
 
+bool ElunaUtil::SendPacket(Player* player, WorldPacket const* data)
+{
+    WorldSession* session = player->GetSession();
+    if (!session)
+        return false;
+#ifdef CMANGOS
+    session->SendPacket(*data);
+#else
+    session->SendPacket(data);
+#endif
+    return true;
+}
+
 ElunaUtil::ObjectGUIDCheck::ObjectGUIDCheck(ObjectGuid guid) : _guid(guid)
 {
 }
@@ -9,6 +9,7 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <atomic>
 #include <mutex>
 #include <memory>
 #include "Common.h"
@@ -80,6 +81,8 @@ typedef QueryNamedResult ElunaQuery;
 
 class Unit;
 class WorldObject;
+class Player;
+class WorldPacket;
 struct FactionTemplateEntry;
 
 namespace ElunaUtil
@@ -88,6 +91,63 @@ namespace ElunaUtil
 
     uint32 GetTimeDiff(uint32 oldMSTime);
 
+    // Sends the packet to the player's session, returns false if the player has no session
+    bool SendPacket(Player* player, WorldPacket const* data);
+
+    /*
+     * Reads a query field the way scripts get it, numeric columns as a double given to number(double)
+     *   and the others as text given to string(const char*, size_t).
+     *
+     * Calls neither and returns false if the field is NULL.
+     * GetRow, GetRows and the query cache all read their fields with this.
+     */
+    template<typename NumberFunc, typename StringFunc>
+    bool ReadField(Field& field, NumberFunc&& number, StringFunc&& string)
+    {
+#if defined TRINITY || AZEROTHCORE
+        if (field.IsNull())
+            return false;
+
+        // Numbers are read from their text, Get<double> only accepts floating point columns with strict type checks
+        std::string str = field.Get<std::string>();
+        switch (field.GetType())
+        {
+            case DatabaseFieldTypes::Int8:
+            case DatabaseFieldTypes::Int16:
+            case DatabaseFieldTypes::Int32:
+            case DatabaseFieldTypes::Int64:
+            case DatabaseFieldTypes::Float:
+            case DatabaseFieldTypes::Double:
+                number(strtod(str.c_str(), NULL));
+                break;
+            default:
+                string(str.data(), str.size());
+                break;
+        }
+#else
+        const char* str = field.GetString();
+        if (field.IsNULL() || !str)
+            return false;
+
+        // MYSQL_TYPE_LONGLONG Interpreted as string for lua
+        switch (field.GetType())
+        {
+            case MYSQL_TYPE_TINY:
+            case MYSQL_TYPE_SHORT:
+            case MYSQL_TYPE_INT24:
+            case MYSQL_TYPE_LONG:
+            case MYSQL_TYPE_FLOAT:
+            case MYSQL_TYPE_DOUBLE:
+                number(strtod(str, NULL));
+                break;
+            default:
+                string(str, strlen(str));
+                break;
+        }
+#endif
+        return true;
+    }
+
     class ObjectGUIDCheck
     {
     public:
@@ -147,6 +207,105 @@ namespace ElunaUtil
         LockType _lock;
     };
 
+    /*
+     * A bounded lock-free queue that is safe for any number of producer and consumer threads.
+     * Based on Dmitry Vyukov's bounded MPMC queue.
+     *
+     * TryPush and TryPop never block, they fail when the queue is full or empty.
+     * The capacity is rounded up to a power of two.
+     */
+    template<typename T>
+    class BoundedQueue
+    {
+    public:
+        explicit BoundedQueue(size_t capacity) : enqueuePos(0), dequeuePos(0)
+        {
+            size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+
+            mask = size - 1;
+            cells.reset(new Cell[size]);
+            for (size_t i = 0; i < size; ++i)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        BoundedQueue(BoundedQueue const&) = delete;
+        BoundedQueue& operator=(BoundedQueue const&) = delete;
+
+        bool TryPush(T value)
+        {
+            Cell* cell;
+            size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &cells[pos & mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false;
+                else
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+
+            cell->data = std::move(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool TryPop(T& value)
+        {
+            Cell* cell;
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &cells[pos & mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false;
+                else
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+
+            value = std::move(cell->data);
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t Capacity() const { return mask + 1; }
+
+        // Only exact when no other thread is pushing or popping
+        size_t Size() const
+        {
+            size_t tail = enqueuePos.load(std::memory_order_relaxed);
+            size_t head = dequeuePos.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        size_t mask;
+        alignas(64) std::atomic<size_t> enqueuePos;
+        alignas(64) std::atomic<size_t> dequeuePos;
+    };
+
     /*
      * Encodes `data` in Base-64 and store the result in `output`.
      */
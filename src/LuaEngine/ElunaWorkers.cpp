@@ -0,0 +1,340 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "ElunaWorkers.h"
+#include "LuaEngine.h"
+#include "ElunaIncludes.h"
+#include "lmarshal.h"
+#include <algorithm>
+#include <cmath>
+
+extern "C"
+{
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+};
+
+#include "ElunaSharedDictionaryMethods.h"
+
+namespace
+{
+    const char* const DICTIONARY_METATABLE = "ElunaSharedDictionary";
+
+    // Worker states have no ElunaTemplate, so the methods are called on a plain userdata
+    template<int (*Method)(lua_State*, ElunaSharedDictionary*)>
+    int DictionaryMethod(lua_State* L)
+    {
+        ElunaSharedDictionary* dict = static_cast<ElunaSharedDictionary*>(luaL_checkudata(L, 1, DICTIONARY_METATABLE));
+        return Method(L, dict);
+    }
+
+    int DictionaryGC(lua_State* L)
+    {
+        ElunaSharedDictionary* dict = static_cast<ElunaSharedDictionary*>(luaL_checkudata(L, 1, DICTIONARY_METATABLE));
+        dict->~ElunaSharedDictionary();
+        return 0;
+    }
+
+    // Returns the same dictionaries as GetSharedDictionary in the main state, without taking the Eluna lock
+    int GetSharedDictionary(lua_State* L)
+    {
+        SharedDictionaryManager* manager = static_cast<SharedDictionaryManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+        size_t length;
+        const char* name = luaL_checklstring(L, 1, &length);
+
+        void* memory = lua_newuserdata(L, sizeof(ElunaSharedDictionary));
+        new (memory) ElunaSharedDictionary(manager->Get(std::string(name, length)));
+        luaL_setmetatable(L, DICTIONARY_METATABLE);
+        return 1;
+    }
+
+    void OpenSharedDictionaries(lua_State* L, SharedDictionaryManager* manager)
+    {
+        static const luaL_Reg methods[] =
+        {
+            { "Get", &DictionaryMethod<&LuaSharedDictionary::Get> },
+            { "GetCount", &DictionaryMethod<&LuaSharedDictionary::GetCount> },
+            { "Set", &DictionaryMethod<&LuaSharedDictionary::Set> },
+            { "Add", &DictionaryMethod<&LuaSharedDictionary::Add> },
+            { "Increment", &DictionaryMethod<&LuaSharedDictionary::Increment> },
+            { "CompareAndSet", &DictionaryMethod<&LuaSharedDictionary::CompareAndSet> },
+            { "Delete", &DictionaryMethod<&LuaSharedDictionary::Delete> },
+            { "Clear", &DictionaryMethod<&LuaSharedDictionary::Clear> },
+            { NULL, NULL }
+        };
+
+        luaL_newmetatable(L, DICTIONARY_METATABLE);
+        lua_newtable(L);
+        luaL_setfuncs(L, methods, 0);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, &DictionaryGC);
+        lua_setfield(L, -2, "__gc");
+        lua_pop(L, 1);
+
+        lua_pushlightuserdata(L, manager);
+        lua_pushcclosure(L, &GetSharedDictionary, 1);
+        lua_setglobal(L, "GetSharedDictionary");
+    }
+
+    // Set on the worker states by Stop so a call that never returns can't block it
+    void StopHook(lua_State* L, lua_Debug* /*ar*/)
+    {
+        luaL_error(L, "the worker is stopping");
+    }
+
+    int MessageHandler(lua_State* L)
+    {
+        if (!lua_isstring(L, 1))
+            return 1;
+        luaL_traceback(L, L, lua_tostring(L, 1), 1);
+        return 1;
+    }
+
+    // Runs in a worker state, returns the encoded results
+    int CallModuleFunction(lua_State* L)
+    {
+        // Stack: module, function, args
+        lua_getglobal(L, "require");
+        lua_pushvalue(L, 1);
+        lua_call(L, 1, 1);
+        // Stack: module, function, args, moduleTable
+        if (!lua_istable(L, 4))
+            return luaL_error(L, "module '%s' did not return a table", lua_tostring(L, 1));
+
+        lua_pushvalue(L, 2);
+        lua_gettable(L, 4);
+        if (!lua_isfunction(L, -1))
+            return luaL_error(L, "module '%s' has no function '%s'", lua_tostring(L, 1), lua_tostring(L, 2));
+        int base = lua_gettop(L);
+        // Stack: module, function, args, moduleTable, func
+
+        lua_pushcfunction(L, mar_decode);
+        lua_pushvalue(L, 3);
+        lua_call(L, 1, 1);
+        int argsIdx = lua_gettop(L);
+        // Stack: module, function, args, moduleTable, func, argsTable
+
+        // The arguments can contain nils if n is set like table.pack does
+        lua_getfield(L, argsIdx, "n");
+        int count = lua_isnumber(L, -1) ? static_cast<int>(lua_tointeger(L, -1)) : static_cast<int>(lua_rawlen(L, argsIdx));
+        lua_pop(L, 1);
+        luaL_checkstack(L, count + LUA_MINSTACK, "too many arguments");
+        for (int i = 1; i <= count; ++i)
+            lua_rawgeti(L, argsIdx, i);
+        lua_remove(L, argsIdx);
+        // Stack: module, function, args, moduleTable, func, [arguments]
+
+        lua_call(L, count, LUA_MULTRET);
+        int resultCount = lua_gettop(L) - base + 1;
+        // Stack: module, function, args, moduleTable, [results]
+
+        lua_createtable(L, resultCount, 1);
+        lua_insert(L, base);
+        for (int i = resultCount; i >= 1; --i)
+            lua_rawseti(L, base, i);
+        lua_pushinteger(L, resultCount);
+        lua_setfield(L, base, "n");
+        // Stack: module, function, args, moduleTable, resultsTable
+
+        lua_pushcfunction(L, mar_encode);
+        lua_insert(L, base);
+        lua_call(L, 1, 1);
+        return 1;
+    }
+}
+
+WorkerPool::WorkerPool()
+    : stopping(false),
+    workerCount(2)
+{
+    LoadConfig();
+}
+
+WorkerPool::~WorkerPool()
+{
+    Stop();
+}
+
+void WorkerPool::LoadConfig()
+{
+#if defined(AZEROTHCORE)
+    workerCount = eConfigMgr->GetOption<uint32>("Eluna.Workers.Threads", 2);
+#else
+    workerCount = eConfigMgr->GetIntDefault("Eluna.Workers.Threads", 2);
+#endif
+}
+
+bool WorkerPool::Queue(const std::string& module, const std::string& function, std::string args, int funcRef)
+{
+    if (!workerCount)
+        return false;
+
+    if (threads.empty())
+        Start();
+
+    Job* job = new Job();
+    job->module = module;
+    job->function = function;
+    job->data = std::move(args);
+    job->funcRef = funcRef;
+    job->success = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    condVar.notify_one();
+    return true;
+}
+
+void WorkerPool::Start()
+{
+    stopping = false;
+    for (uint32_t i = 0; i < workerCount; ++i)
+        threads.emplace_back(&WorkerPool::WorkerThread, this);
+}
+
+void WorkerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+
+        // lua_sethook can be called from another thread, the hook runs at the next instruction
+        for (lua_State* state : states)
+            lua_sethook(state, &StopHook, LUA_MASKCALL | LUA_MASKRET | LUA_MASKCOUNT, 1);
+    }
+    condVar.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+
+    // The callback refs go with the Lua state being closed
+    for (Job* job : jobs)
+        delete job;
+    jobs.clear();
+    for (Job* job : results)
+        delete job;
+    results.clear();
+}
+
+void WorkerPool::WorkerThread()
+{
+    lua_State* L = luaL_newstate();
+    luaL_openlibs(L);
+
+    // Modules are found like require finds them in the main state
+    lua_getglobal(L, "package");
+    lua_pushstring(L, requirePath.c_str());
+    lua_setfield(L, -2, "path");
+    lua_pushstring(L, "");
+    lua_setfield(L, -2, "cpath");
+    lua_pop(L, 1);
+
+    OpenSharedDictionaries(L, &Eluna::GEluna->sharedDictionaries);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        states.push_back(L);
+    }
+
+    while (true)
+    {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condVar.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                break;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        Run(L, *job);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(job);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        states.erase(std::find(states.begin(), states.end(), L));
+    }
+    lua_sethook(L, nullptr, 0, 0);
+    lua_close(L);
+}
+
+void WorkerPool::Run(lua_State* L, Job& job)
+{
+    lua_settop(L, 0);
+    lua_pushcfunction(L, &MessageHandler);
+    lua_pushcfunction(L, &CallModuleFunction);
+    lua_pushlstring(L, job.module.data(), job.module.size());
+    lua_pushlstring(L, job.function.data(), job.function.size());
+    lua_pushlstring(L, job.data.data(), job.data.size());
+
+    job.success = lua_pcall(L, 3, 1, 1) == LUA_OK;
+
+    size_t length;
+    const char* data = lua_tolstring(L, -1, &length);
+    if (data)
+        job.data.assign(data, length);
+    else
+        job.data = "error object is not a string";
+
+    lua_settop(L, 0);
+}
+
+void WorkerPool::DeliverResults(lua_State* L)
+{
+    std::deque<Job*> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.swap(results);
+    }
+
+    for (Job* job : finished)
+    {
+        // Get function
+        lua_rawgeti(L, LUA_REGISTRYINDEX, job->funcRef);
+        luaL_unref(L, LUA_REGISTRYINDEX, job->funcRef);
+
+        // Push parameters
+        int params = 2;
+        Eluna::Push(L, job->success);
+        if (!job->success)
+            lua_pushlstring(L, job->data.data(), job->data.size());
+        else
+        {
+            lua_pushcfunction(L, &mar_decode);
+            lua_pushlstring(L, job->data.data(), job->data.size());
+            if (lua_pcall(L, 1, 1, 0) != LUA_OK)
+            {
+                // Stack: function, true, errmsg
+                lua_pushboolean(L, 0);
+                lua_replace(L, -3);
+            }
+            else
+            {
+                // Stack: function, true, results
+                int resultsIdx = lua_gettop(L);
+                lua_getfield(L, resultsIdx, "n");
+                int count = static_cast<int>(lua_tointeger(L, -1));
+                lua_pop(L, 1);
+                luaL_checkstack(L, count + LUA_MINSTACK, "too many results");
+                for (int i = 1; i <= count; ++i)
+                    lua_rawgeti(L, resultsIdx, i);
+                lua_remove(L, resultsIdx);
+                params = count + 1;
+            }
+        }
+
+        // Call function
+        Eluna::GEluna->ExecuteCall(params, 0);
+        delete job;
+    }
+}
@@ -0,0 +1,74 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_WORKERS_H
+#define _ELUNA_WORKERS_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct lua_State;
+
+/*
+ * Lua states on background threads running the module functions called with RunAsync.
+ *
+ * The worker states only have the standard libraries and GetSharedDictionary, and load the modules they are asked
+ *   to run with require, so they can't touch game objects. Arguments and results cross between states encoded with lmarshal.
+ *
+ * The threads are started by the first call and stopped when the main Lua state is closed,
+ *   so the modules are loaded again after a reload.
+ */
+class WorkerPool
+{
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    void LoadConfig();
+    // package.path of the worker states
+    void SetRequirePath(const std::string& path) { requirePath = path; }
+
+    // Queues a call of module.function with the encoded arguments, returns false if there are no workers
+    bool Queue(const std::string& module, const std::string& function, std::string args, int funcRef);
+    // Calls the callbacks of the finished calls, the caller holds the Eluna lock
+    void DeliverResults(lua_State* L);
+    // Interrupts the running calls and drops the others without calling their callbacks
+    void Stop();
+
+private:
+    struct Job
+    {
+        std::string module;
+        std::string function;
+        // Encoded arguments, then encoded results or the error message
+        std::string data;
+        int funcRef;
+        bool success;
+    };
+
+    void Start();
+    void WorkerThread();
+    static void Run(lua_State* L, Job& job);
+
+    std::mutex mutex;
+    std::condition_variable condVar;
+    std::deque<Job*> jobs;
+    std::deque<Job*> results;
+    std::vector<std::thread> threads;
+    // States of the running workers, interrupted by Stop
+    std::vector<lua_State*> states;
+    bool stopping;
+
+    uint32_t workerCount;
+    std::string requirePath;
+};
+
+#endif // _ELUNA_WORKERS_H
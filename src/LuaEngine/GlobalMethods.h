@@ -7,7 +7,14 @@
 #ifndef GLOBALMETHODS_H
 #define GLOBALMETHODS_H
 
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
 #include "BindingMap.h"
+#include "ElunaStatements.h"
+#include "lmarshal.h"
+#include "LuaJson.h"
 
 #ifdef AZEROTHCORE
 
@@ -783,6 +790,162 @@ namespace LuaGlobalFunctions
         return RegisterEventHelper(L, Hooks::REGTYPE_PLAYER);
     }
 
+    static void ReadChatFilterStrings(lua_State* L, int filter, const char* field, std::vector<std::string>& values)
+    {
+        lua_getfield(L, filter, field);
+        if (!lua_isnil(L, -1))
+        {
+            if (!lua_istable(L, -1))
+                luaL_error(L, "chat filter field '%s' must be a table of strings", field);
+
+            lua_pushnil(L);
+            while (lua_next(L, -2) != 0)
+            {
+                if (lua_type(L, -1) != LUA_TSTRING)
+                    luaL_error(L, "chat filter field '%s' must be a table of strings", field);
+                size_t length = 0;
+                const char* value = lua_tolstring(L, -1, &length);
+                values.emplace_back(value, length);
+                lua_pop(L, 1);
+            }
+        }
+        lua_pop(L, 1);
+    }
+
+    static int CancelPlayerChatEvent(lua_State* L)
+    {
+        uint64 handlerID = Eluna::CHECKVAL<uint64>(L, lua_upvalueindex(1));
+        Eluna::GetEluna(L)->chatFilters.Remove(L, handlerID);
+        return 0;
+    }
+
+    /**
+     * Registers a [Player] chat event handler that is only called for chat messages accepted by a filter.
+     *
+     * The filter is checked before anything is passed to Lua, so messages the handler
+     *   is not interested in cost no Lua calls. The filter is a table with the following optional fields:
+     *
+     *     {
+     *         prefixes = { "!", "#" },         -- message starts with any of these
+     *         keywords = { "gold", "sell" },   -- message contains any of these anywhere
+     *         types = { 1, 6 },                -- [ChatMsg] type is any of these
+     *         ignoreCase = true,               -- compare prefixes and keywords ignoring ASCII case
+     *     }
+     *
+     * All given fields must match. Filters are checked against the message as sent by the [Player],
+     *   before any handler changed it.
+     *
+     * The handler receives the same arguments and can return the same values as
+     *   handlers registered with [Global:RegisterPlayerEvent] for the same event.
+     *
+     * @param uint32 event : PLAYER_EVENT_ON_CHAT, PLAYER_EVENT_ON_WHISPER, PLAYER_EVENT_ON_GROUP_CHAT, PLAYER_EVENT_ON_GUILD_CHAT or PLAYER_EVENT_ON_CHANNEL_CHAT
+     * @param table filter : the conditions a message must meet
+     * @param function function : function to register
+     *
+     * @return function cancel : a function that removes the handler when called
+     */
+    int RegisterPlayerChatEvent(lua_State* L)
+    {
+        uint32 ev = Eluna::CHECKVAL<uint32>(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        luaL_checktype(L, 3, LUA_TFUNCTION);
+
+        if (ev < Hooks::PLAYER_EVENT_ON_CHAT || ev > Hooks::PLAYER_EVENT_ON_CHANNEL_CHAT)
+            return luaL_argerror(L, 1, "player chat event expected");
+
+        std::unique_ptr<ChatFilter> filter(new ChatFilter());
+
+        lua_getfield(L, 2, "ignoreCase");
+        filter->ignoreCase = lua_toboolean(L, -1) != 0;
+        lua_pop(L, 1);
+
+        ReadChatFilterStrings(L, 2, "prefixes", filter->prefixes);
+
+        std::vector<std::string> keywords;
+        ReadChatFilterStrings(L, 2, "keywords", keywords);
+        filter->keywords.Build(keywords, filter->ignoreCase);
+
+        lua_getfield(L, 2, "types");
+        if (lua_istable(L, -1))
+        {
+            lua_pushnil(L);
+            while (lua_next(L, -2) != 0)
+            {
+                uint32 type = Eluna::CHECKVAL<uint32>(L, -1);
+                if (type >= 64)
+                    return luaL_error(L, "chat filter type %d is not a valid chat type", (int)type);
+                filter->typeMask |= uint64(1) << type;
+                lua_pop(L, 1);
+            }
+        }
+        lua_pop(L, 1);
+
+        lua_pushvalue(L, 3);
+        int functionRef = luaL_ref(L, LUA_REGISTRYINDEX);
+        if (functionRef < 0)
+            return luaL_argerror(L, 3, "unable to make a ref to function");
+
+        uint64 handlerID = Eluna::GetEluna(L)->chatFilters.Add(ev, std::move(filter), functionRef);
+        Eluna::Push(L, handlerID);
+        lua_pushcclosure(L, &CancelPlayerChatEvent, 1);
+        return 1;
+    }
+
+    static int CancelCommand(lua_State* L)
+    {
+        uint64 commandID = Eluna::CHECKVAL<uint64>(L, lua_upvalueindex(1));
+        Eluna::GetEluna(L)->commands.Remove(L, commandID);
+        return 0;
+    }
+
+    /**
+     * Registers a command handler.
+     *
+     * The name can consist of several words, e.g. "event start". Commands are matched ignoring case
+     *   and the longest registered command matching the text is used, so "event start" is preferred over "event".
+     *   Commands no script registered and commands the user's security level is too low for
+     *   are passed to the core without calling any Lua.
+     *
+     * The function is called with (player, args, handler, argString), where player is nil for the console,
+     *   args is a table of the whitespace separated words after the command and argString is the text after the command.
+     *   The command is not passed to the core unless the function returns false.
+     *
+     * Registering a command that already exists replaces it.
+     * Commands the function handles are not passed to PLAYER_EVENT_ON_COMMAND handlers.
+     *   If it returns false, or the user's security level is too low, the event is triggered as for any other command.
+     *
+     *     RegisterCommand("event start", 2, function(player, args, handler)
+     *         handler:SendSysMessage("Starting event " .. (args[1] or "default"))
+     *     end)
+     *
+     * @param string name : the command, without the leading `.`
+     * @param uint32 minSecurity : minimum account security level that can use the command
+     * @param function function : function to register
+     *
+     * @return function cancel : a function that removes the command when called
+     */
+    int RegisterCommand(lua_State* L)
+    {
+        size_t length = 0;
+        const char* name = luaL_checklstring(L, 1, &length);
+        uint32 minSecurity = Eluna::CHECKVAL<uint32>(L, 2);
+        luaL_checktype(L, 3, LUA_TFUNCTION);
+
+        std::string_view words(name, length);
+        if (CommandTrie::NextWord(words).empty())
+            return luaL_argerror(L, 1, "command name expected");
+
+        lua_pushvalue(L, 3);
+        int functionRef = luaL_ref(L, LUA_REGISTRYINDEX);
+        if (functionRef < 0)
+            return luaL_argerror(L, 3, "unable to make a ref to function");
+
+        uint64 commandID = Eluna::GetEluna(L)->commands.Add(L, std::string_view(name, length), minSecurity, functionRef);
+        Eluna::Push(L, commandID);
+        lua_pushcclosure(L, &CancelCommand, 1);
+        return 1;
+    }
+
     /**
      * Registers a [Guild] event handler.
      *
@@ -909,6 +1072,150 @@ namespace LuaGlobalFunctions
         return RegisterEntryHelper(L, Hooks::REGTYPE_PACKET);
     }
 
+    static int CancelPacketMirror(lua_State* L)
+    {
+        uint64 mirrorID = Eluna::CHECKVAL<uint64>(L, lua_upvalueindex(1));
+        Eluna::GetEluna(L)->packetMirrors.Remove(L, mirrorID);
+        return 0;
+    }
+
+    /**
+     * Registers a read-only [WorldPacket] observer.
+     *
+     * Unlike [Global:RegisterPacketEvent] handlers, mirrors can not modify or block packets
+     *   and never make the thread handling the packet wait for Lua.
+     * Matching packets are copied into a bounded queue and the function is called
+     *   on the world thread once per update with all packets queued since the last update.
+     *
+     * When the queue is full new packets are dropped and the amount of dropped packets
+     *   is passed to the next call of the function.
+     *
+     * The function is called with (event, packets, guids, dropped), where `packets` is a table of
+     *   the copied [WorldPacket]s and `guids` holds the GUID of the session's [Player] at the same index,
+     *   or 0 if the session had no player.
+     *
+     * @proto cancel = (event, opcodes, function)
+     * @proto cancel = (event, opcodes, function, sampleRate)
+     * @proto cancel = (event, opcodes, function, sampleRate, capacity)
+     *
+     * @param uint32 event : packet event Id, PACKET_EVENT_ON_PACKET_RECEIVE or PACKET_EVENT_ON_PACKET_SEND
+     * @param table opcodes : table of opcodes to mirror, an empty table mirrors all opcodes
+     * @param function function : function to register
+     * @param uint32 sampleRate = 1 : mirror one out of every `sampleRate` matching packets
+     * @param uint32 capacity = 1024 : maximum amount of packets queued between two updates
+     *
+     * @return function cancel : a function that removes the mirror when called
+     */
+    int RegisterPacketMirror(lua_State* L)
+    {
+        uint32 ev = Eluna::CHECKVAL<uint32>(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        luaL_checktype(L, 3, LUA_TFUNCTION);
+        uint32 sampleRate = Eluna::CHECKVAL<uint32>(L, 4, 1);
+        uint32 capacity = Eluna::CHECKVAL<uint32>(L, 5, 1024);
+
+        if (ev != Hooks::PACKET_EVENT_ON_PACKET_RECEIVE && ev != Hooks::PACKET_EVENT_ON_PACKET_SEND)
+            return luaL_argerror(L, 1, "PACKET_EVENT_ON_PACKET_RECEIVE or PACKET_EVENT_ON_PACKET_SEND expected");
+        if (!sampleRate)
+            return luaL_argerror(L, 4, "sample rate must be greater than 0");
+        if (!capacity)
+            return luaL_argerror(L, 5, "capacity must be greater than 0");
+
+        std::vector<uint32> opcodes;
+        lua_pushnil(L);
+        while (lua_next(L, 2) != 0)
+        {
+            uint32 opcode = Eluna::CHECKVAL<uint32>(L, -1);
+            if (opcode >= NUM_MSG_TYPES)
+                return luaL_argerror(L, 2, "valid opcode expected");
+            opcodes.push_back(opcode);
+            lua_pop(L, 1);
+        }
+
+        lua_pushvalue(L, 3);
+        int functionRef = luaL_ref(L, LUA_REGISTRYINDEX);
+        if (functionRef < 0)
+            return luaL_argerror(L, 3, "unable to make a ref to function");
+
+        uint64 mirrorID = Eluna::GetEluna(L)->packetMirrors.Add(ev, opcodes, sampleRate, capacity, functionRef);
+        Eluna::Push(L, mirrorID);
+        lua_pushcclosure(L, &CancelPacketMirror, 1);
+        return 1;
+    }
+
+    static int CancelAddonMessageHandler(lua_State* L)
+    {
+        uint64 routeID = Eluna::CHECKVAL<uint64>(L, lua_upvalueindex(1));
+        Eluna::GetEluna(L)->addonRouter.Remove(L, routeID);
+        return 0;
+    }
+
+    /**
+     * Registers a handler for addon messages with the given prefix.
+     *
+     * Unlike ADDON_EVENT_ON_MESSAGE handlers registered with [Global:RegisterServerEvent],
+     *   the function is only called for messages with a matching prefix and messages
+     *   with prefixes no script handles are never passed to Lua.
+     *
+     * The function is called with the same arguments as ADDON_EVENT_ON_MESSAGE handlers,
+     *   (event, sender, type, prefix, msg, target), and can return false to block the message.
+     *
+     * @proto cancel = (prefix, function)
+     * @proto cancel = (prefix, function, prefixMatch)
+     *
+     * @param string prefix : the addon message prefix to handle
+     * @param function function : function to register
+     * @param bool prefixMatch = false : if true the function handles all prefixes starting with `prefix`
+     *
+     * @return function cancel : a function that removes the handler when called
+     */
+    int RegisterAddonMessageHandler(lua_State* L)
+    {
+        std::string prefix = Eluna::CHECKVAL<std::string>(L, 1);
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+        bool prefixMatch = Eluna::CHECKVAL<bool>(L, 3, false);
+
+        lua_pushvalue(L, 2);
+        int functionRef = luaL_ref(L, LUA_REGISTRYINDEX);
+        if (functionRef < 0)
+            return luaL_argerror(L, 2, "unable to make a ref to function");
+
+        uint64 routeID = Eluna::GetEluna(L)->addonRouter.Add(prefix, prefixMatch, functionRef);
+        Eluna::Push(L, routeID);
+        lua_pushcclosure(L, &CancelAddonMessageHandler, 1);
+        return 1;
+    }
+
+    /**
+     * Registers a handler for chunked addon messages with the given prefix.
+     *
+     * Addon messages with the prefix are reassembled from the format described in [Player:QueueAddonMessage]
+     *   and the function is called once for every complete message, no matter how many addon messages it was split into.
+     *
+     * The function is called with (event, sender, type, prefix, msg, target) like ADDON_EVENT_ON_MESSAGE handlers,
+     *   and can return false to block the addon message that completed the message.
+     *
+     * @param string prefix : the addon message prefix to handle
+     * @param function function : function to register
+     *
+     * @return function cancel : a function that removes the handler when called
+     */
+    int RegisterChunkedAddonMessageHandler(lua_State* L)
+    {
+        std::string prefix = Eluna::CHECKVAL<std::string>(L, 1);
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+
+        lua_pushvalue(L, 2);
+        int functionRef = luaL_ref(L, LUA_REGISTRYINDEX);
+        if (functionRef < 0)
+            return luaL_argerror(L, 2, "unable to make a ref to function");
+
+        uint64 routeID = Eluna::GetEluna(L)->addonRouter.AddChunked(prefix, functionRef);
+        Eluna::Push(L, routeID);
+        lua_pushcclosure(L, &CancelAddonMessageHandler, 1);
+        return 1;
+    }
+
     /**
      * Registers a [Creature] gossip event handler.
      *
@@ -1309,24 +1616,181 @@ namespace LuaGlobalFunctions
         return 0;
     }
 
+    // Sends the packet to all players in world accepted by filter, returns the amount of players it was sent to
+    template <typename F>
+    static uint32 SendPacketToWorldPlayers(WorldPacket const* data, F filter)
+    {
+        uint32 count = 0;
+#if defined(MANGOS)
+        eObjectAccessor()DoForAllPlayers([&](Player* player){
+            if (player->IsInWorld() && filter(player) && ElunaUtil::SendPacket(player, data))
+                ++count;
+        });
+#else
+#if defined TRINITY || AZEROTHCORE
+        std::shared_lock<std::shared_mutex> lock(*HashMapHolder<Player>::GetLock());
+#else
+        HashMapHolder<Player>::ReadGuard g(HashMapHolder<Player>::GetLock());
+#endif
+        const HashMapHolder<Player>::MapType& m = eObjectAccessor()GetPlayers();
+        for (HashMapHolder<Player>::MapType::const_iterator it = m.begin(); it != m.end(); ++it)
+        {
+            Player* player = it->second;
+            if (player && player->IsInWorld() && filter(player) && ElunaUtil::SendPacket(player, data))
+                ++count;
+        }
+#endif
+        return count;
+    }
+
+    /**
+     * Sends a [WorldPacket] to all [Player]s in the world.
+     *
+     * The packet is sent directly to each session, this is much faster than
+     *   calling [Player:SendPacket] for every [Player] returned by [Global:GetPlayersInWorld].
+     *
+     *     enum TeamId
+     *     {
+     *         TEAM_ALLIANCE = 0,
+     *         TEAM_HORDE = 1,
+     *         TEAM_NEUTRAL = 2
+     *     };
+     *
+     * @param [WorldPacket] packet : the packet to send
+     * @param [TeamId] team = TEAM_NEUTRAL : optional check team of the [Player], Alliance, Horde or Neutral (All)
+     * @param bool onlyGM = false : optional check if GM only
+     * @return uint32 count : amount of [Player]s the packet was sent to
+     */
+    int SendPacketToWorld(lua_State* L)
+    {
+        WorldPacket* data = Eluna::CHECKOBJ<WorldPacket>(L, 1);
+        uint32 team = Eluna::CHECKVAL<uint32>(L, 2, TEAM_NEUTRAL);
+        if (team > TEAM_NEUTRAL)
+            return luaL_argerror(L, 2, "valid TeamId expected");
+        bool onlyGM = Eluna::CHECKVAL<bool>(L, 3, false);
+
+        uint32 count = SendPacketToWorldPlayers(data, [&](Player* player)
+        {
+#if defined TRINITY || AZEROTHCORE
+            return (team == TEAM_NEUTRAL || player->GetTeamId() == team) && (!onlyGM || player->IsGameMaster());
+#else
+            return (team == TEAM_NEUTRAL || player->GetTeamId() == team) && (!onlyGM || player->isGameMaster());
+#endif
+        });
+        Eluna::Push(L, count);
+        return 1;
+    }
+
+    /**
+     * Sends a [WorldPacket] to all [Player]s in a zone.
+     *
+     * @param [WorldPacket] packet : the packet to send
+     * @param uint32 zoneId : ID of the zone
+     * @param [TeamId] team = TEAM_NEUTRAL : optional check team of the [Player], Alliance, Horde or Neutral (All)
+     * @return uint32 count : amount of [Player]s the packet was sent to
+     */
+    int SendPacketToZone(lua_State* L)
+    {
+        WorldPacket* data = Eluna::CHECKOBJ<WorldPacket>(L, 1);
+        uint32 zoneId = Eluna::CHECKVAL<uint32>(L, 2);
+        uint32 team = Eluna::CHECKVAL<uint32>(L, 3, TEAM_NEUTRAL);
+        if (team > TEAM_NEUTRAL)
+            return luaL_argerror(L, 3, "valid TeamId expected");
+
+        uint32 count = SendPacketToWorldPlayers(data, [&](Player* player)
+        {
+            return player->GetZoneId() == zoneId && (team == TEAM_NEUTRAL || player->GetTeamId() == team);
+        });
+        Eluna::Push(L, count);
+        return 1;
+    }
+
+    /**
+     * Sends a [WorldPacket] to all [Player]s in an area.
+     *
+     * @param [WorldPacket] packet : the packet to send
+     * @param uint32 areaId : ID of the area
+     * @param [TeamId] team = TEAM_NEUTRAL : optional check team of the [Player], Alliance, Horde or Neutral (All)
+     * @return uint32 count : amount of [Player]s the packet was sent to
+     */
+    int SendPacketToArea(lua_State* L)
+    {
+        WorldPacket* data = Eluna::CHECKOBJ<WorldPacket>(L, 1);
+        uint32 areaId = Eluna::CHECKVAL<uint32>(L, 2);
+        uint32 team = Eluna::CHECKVAL<uint32>(L, 3, TEAM_NEUTRAL);
+        if (team > TEAM_NEUTRAL)
+            return luaL_argerror(L, 3, "valid TeamId expected");
+
+        uint32 count = SendPacketToWorldPlayers(data, [&](Player* player)
+        {
+            return player->GetAreaId() == areaId && (team == TEAM_NEUTRAL || player->GetTeamId() == team);
+        });
+        Eluna::Push(L, count);
+        return 1;
+    }
+
+    /**
+     * Sends a [WorldPacket] to each [Player] in a table.
+     *
+     * The table can contain [Player] objects and [Player] GUIDs.
+     *   GUIDs of [Player]s that are not online are ignored.
+     *
+     * @param [WorldPacket] packet : the packet to send
+     * @param table players : table of [Player]s or [Player] GUIDs
+     * @return uint32 count : amount of [Player]s the packet was sent to
+     */
+    int SendPacketToPlayers(lua_State* L)
+    {
+        WorldPacket* data = Eluna::CHECKOBJ<WorldPacket>(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+
+        uint32 count = 0;
+        lua_pushnil(L);
+        while (lua_next(L, 2) != 0)
+        {
+            Player* player = NULL;
+            ElunaObject* elunaObj = Eluna::CHECKOBJ<ElunaObject>(L, -1, false);
+            if (elunaObj && elunaObj->GetTypeName() == ElunaTemplate<Player>::tname)
+                player = Eluna::CHECKOBJ<Player>(L, -1, false);
+            else
+                player = eObjectAccessor()FindPlayer(Eluna::CHECKVAL<ObjectGuid>(L, -1));
+
+            if (player && ElunaUtil::SendPacket(player, data))
+                ++count;
+            lua_pop(L, 1);
+        }
+
+        Eluna::Push(L, count);
+        return 1;
+    }
+
     template <typename T>
     static int DBQueryAsync(lua_State* L, DatabaseWorkerPool<T>& db)
     {
         const char* query = Eluna::CHECKVAL<const char*>(L, 1);
-        luaL_checktype(L, 2, LUA_TFUNCTION);
-        lua_pushvalue(L, 2);
+        return DBQueryAsync(L, db, query, 2);
+    }
+
+    // Runs the query and calls the function at funcIndex with its result
+    template <typename T>
+    static int DBQueryAsync(lua_State* L, DatabaseWorkerPool<T>& db, const char* query, int funcIndex)
+    {
+        luaL_checktype(L, funcIndex, LUA_TFUNCTION);
+        lua_pushvalue(L, funcIndex);
         int funcRef = luaL_ref(L, LUA_REGISTRYINDEX);
         if (funcRef == LUA_REFNIL || funcRef == LUA_NOREF)
         {
-            luaL_argerror(L, 2, "unable to make a ref to function");
+            luaL_argerror(L, funcIndex, "unable to make a ref to function");
             return 0;
         }
 
+        ++Eluna::GEluna->metrics.dbCallbacksPending;
         Eluna::GEluna->queryProcessor.AddCallback(db.AsyncQuery(query).WithCallback([L, funcRef](QueryResult result)
             {
                 ElunaQuery* eq = result ? new ElunaQuery(result) : nullptr;
 
                 LOCK_ELUNA;
+                --Eluna::GEluna->metrics.dbCallbacksPending;
 
                 // Get function
                 lua_rawgeti(L, LUA_REGISTRYINDEX, funcRef);
@@ -1343,42 +1807,138 @@ namespace LuaGlobalFunctions
         return 0;
     }
 
-    /**
-     * Executes a SQL query on the world database and returns an [ElunaQuery].
-     *
-     * The query is always executed synchronously
-     *   (i.e. execution halts until the query has finished and then results are returned).
-     * If you need to execute the query asynchronously, use [Global:WorldDBQueryAsync] instead.
-     *
-     *     local Q = WorldDBQuery("SELECT entry, name FROM creature_template LIMIT 10")
-     *     if Q then
-     *         repeat
-     *             local entry, name = Q:GetUInt32(0), Q:GetString(1)
-     *             print(entry, name)
-     *         until not Q:NextRow()
-     *     end
-     *
-     * @param string sql : query to execute
-     * @return [ElunaQuery] results or nil if no rows found or nil if no rows found
-     */
-    int WorldDBQuery(lua_State* L)
+    // Runs the query for the task running on L and resumes it with the result
+    template <typename T>
+    static int AwaitQuery(lua_State* L, DatabaseWorkerPool<T>& db)
     {
         const char* query = Eluna::CHECKVAL<const char*>(L, 1);
+        uint64 handle = Eluna::GEluna->coroutines.Suspend(L);
 
-#if defined TRINITY || AZEROTHCORE
-        ElunaQuery result = WorldDatabase.Query(query);
-        if (result)
-            Eluna::Push(L, new ElunaQuery(result));
-        else
-            Eluna::Push(L);
-#else
-        ElunaQuery* result = WorldDatabase.QueryNamed(query);
-        if (result)
-            Eluna::Push(L, result);
-        else
-            Eluna::Push(L);
-#endif
-        return 1;
+        ++Eluna::GEluna->metrics.dbCallbacksPending;
+        Eluna::GEluna->queryProcessor.AddCallback(db.AsyncQuery(query).WithCallback([handle](QueryResult result)
+            {
+                LOCK_ELUNA;
+                --Eluna::GEluna->metrics.dbCallbacksPending;
+
+                lua_State* L = Eluna::GEluna->L;
+                Eluna::Push(L, result ? new ElunaQuery(result) : nullptr);
+                Eluna::GEluna->coroutines.Resume(L, handle, 1);
+            }));
+
+        return lua_yield(L, 0);
+    }
+
+    // Runs the queries of the array at index 1 concurrently and calls the function at index 2 once with all the results
+    template <typename T>
+    static int DBQueryAsyncMulti(lua_State* L, DatabaseWorkerPool<T>& db)
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+
+        int count = static_cast<int>(lua_rawlen(L, 1));
+        if (!count)
+            return luaL_argerror(L, 1, "no queries");
+        luaL_checkstack(L, count + LUA_MINSTACK, "too many queries");
+
+        for (int i = 1; i <= count; ++i)
+        {
+            lua_rawgeti(L, 1, i);
+            if (lua_type(L, -1) != LUA_TSTRING)
+                return luaL_argerror(L, 1, "queries must be strings");
+            lua_pop(L, 1);
+        }
+
+        lua_pushvalue(L, 2);
+        int funcRef = luaL_ref(L, LUA_REGISTRYINDEX);
+        if (funcRef == LUA_REFNIL || funcRef == LUA_NOREF)
+            return luaL_argerror(L, 2, "unable to make a ref to function");
+
+        // The callbacks are all processed by the world update, so the results don't need a lock
+        struct MultiQuery
+        {
+            std::vector<QueryResult> results;
+            int remaining;
+        };
+        std::shared_ptr<MultiQuery> multi = std::make_shared<MultiQuery>();
+        multi->results.resize(count);
+        multi->remaining = count;
+
+        ++Eluna::GEluna->metrics.dbCallbacksPending;
+        uint32 generation = Eluna::GEluna->stateGeneration;
+        for (int i = 0; i < count; ++i)
+        {
+            lua_rawgeti(L, 1, i + 1);
+            const char* query = lua_tostring(L, -1);
+            Eluna::GEluna->queryProcessor.AddCallback(db.AsyncQuery(query).WithCallback([generation, funcRef, multi, i](QueryResult result)
+                {
+                    multi->results[i] = result;
+                    if (--multi->remaining)
+                        return;
+
+                    LOCK_ELUNA;
+                    --Eluna::GEluna->metrics.dbCallbacksPending;
+
+                    // The function belonged to a state closed by a reload since
+                    if (Eluna::GEluna->stateGeneration != generation)
+                        return;
+                    lua_State* L = Eluna::GEluna->L;
+
+                    // Get function
+                    lua_rawgeti(L, LUA_REGISTRYINDEX, funcRef);
+
+                    // Push parameters
+                    int argCount = static_cast<int>(multi->results.size());
+                    luaL_checkstack(L, argCount + LUA_MINSTACK, "too many queries");
+                    for (QueryResult& queryResult : multi->results)
+                        Eluna::Push(L, queryResult ? new ElunaQuery(queryResult) : nullptr);
+
+                    // Call function
+                    Eluna::GEluna->ExecuteCall(argCount, 0);
+
+                    luaL_unref(L, LUA_REGISTRYINDEX, funcRef);
+                }));
+            lua_pop(L, 1);
+        }
+
+        return 0;
+    }
+
+    /**
+     * Executes a SQL query on the world database and returns an [ElunaQuery].
+     *
+     * The query is always executed synchronously
+     *   (i.e. execution halts until the query has finished and then results are returned).
+     * If you need to execute the query asynchronously, use [Global:WorldDBQueryAsync] instead.
+     *
+     *     local Q = WorldDBQuery("SELECT entry, name FROM creature_template LIMIT 10")
+     *     if Q then
+     *         repeat
+     *             local entry, name = Q:GetUInt32(0), Q:GetString(1)
+     *             print(entry, name)
+     *         until not Q:NextRow()
+     *     end
+     *
+     * @param string sql : query to execute
+     * @return [ElunaQuery] results or nil if no rows found or nil if no rows found
+     */
+    int WorldDBQuery(lua_State* L)
+    {
+        const char* query = Eluna::CHECKVAL<const char*>(L, 1);
+
+#if defined TRINITY || AZEROTHCORE
+        ElunaQuery result = WorldDatabase.Query(query);
+        if (result)
+            Eluna::Push(L, new ElunaQuery(result));
+        else
+            Eluna::Push(L);
+#else
+        ElunaQuery* result = WorldDatabase.QueryNamed(query);
+        if (result)
+            Eluna::Push(L, result);
+        else
+            Eluna::Push(L);
+#endif
+        return 1;
     }
 
     /**
@@ -1405,6 +1965,31 @@ namespace LuaGlobalFunctions
         return DBQueryAsync(L, WorldDatabase);
     }
 
+    /**
+     * Executes several SQL queries on the world database at the same time and passes all their [ElunaQuery] results to one callback function.
+     *
+     * The queries are sent together instead of one after the other from nested [Global:WorldDBQueryAsync] callbacks,
+     *   so the results of all of them arrive after one round trip.
+     * The callback is called once, when every query has finished, with one argument for each query in the same order.
+     * Like with [Global:WorldDBQueryAsync] an argument is nil if the query returned no rows.
+     *
+     *     WorldDBQueryAsyncMulti({
+     *         "SELECT entry, name FROM creature_template WHERE entry = 6",
+     *         "SELECT entry, name FROM item_template WHERE entry = 25",
+     *     }, function(creature, item)
+     *         if creature and item then
+     *             print(creature:GetString(1), item:GetString(1))
+     *         end
+     *     end)
+     *
+     * @param table queries : array of the queries to execute
+     * @param function callback : function that will be called when all the results are available
+     */
+    int WorldDBQueryAsyncMulti(lua_State* L)
+    {
+        return DBQueryAsyncMulti(L, WorldDatabase);
+    }
+
     /**
      * Executes a SQL query on the world database.
      *
@@ -1474,6 +2059,29 @@ namespace LuaGlobalFunctions
         return DBQueryAsync(L, CharacterDatabase);
     }
 
+    /**
+     * Executes several SQL queries on the character database at the same time and passes all their [ElunaQuery] results to one callback function.
+     *
+     * The queries are sent together instead of one after the other from nested [Global:CharDBQueryAsync] callbacks,
+     *   so the results of all of them arrive after one round trip.
+     * The callback is called once, when every query has finished, with one argument for each query in the same order.
+     * Like with [Global:CharDBQueryAsync] an argument is nil if the query returned no rows.
+     *
+     *     CharDBQueryAsyncMulti({
+     *         "SELECT points FROM my_points WHERE guid = " .. guid,
+     *         "SELECT title FROM my_titles WHERE guid = " .. guid,
+     *     }, function(points, titles)
+     *         -- both results are available here, after a single round trip
+     *     end)
+     *
+     * @param table queries : array of the queries to execute
+     * @param function callback : function that will be called when all the results are available
+     */
+    int CharDBQueryAsyncMulti(lua_State* L)
+    {
+        return DBQueryAsyncMulti(L, CharacterDatabase);
+    }
+
     /**
      * Executes a SQL query on the character database.
      *
@@ -1527,40 +2135,996 @@ namespace LuaGlobalFunctions
     }
 
     /**
-     * Executes an asynchronous SQL query on the character database and passes an [ElunaQuery] to a callback function.
+     * Executes an asynchronous SQL query on the character database and passes an [ElunaQuery] to a callback function.
+     *
+     * The query is executed asynchronously
+     *   (i.e. the server keeps running while the query is executed in parallel, and results are passed to a callback function).
+     * If you need to execute the query synchronously, use [Global:AuthDBQuery] instead.
+     *
+     * For an example see [Global:WorldDBQueryAsync].
+     *
+     * @param string sql : query to execute
+     * @param function callback : function that will be called when the results are available
+     */
+    int AuthDBQueryAsync(lua_State* L)
+    {
+        return DBQueryAsync(L, LoginDatabase);
+    }
+
+    /**
+     * Executes several SQL queries on the auth database at the same time and passes all their [ElunaQuery] results to one callback function.
+     *
+     * The queries are sent together instead of one after the other from nested [Global:AuthDBQueryAsync] callbacks,
+     *   so the results of all of them arrive after one round trip.
+     * The callback is called once, when every query has finished, with one argument for each query in the same order.
+     * Like with [Global:AuthDBQueryAsync] an argument is nil if the query returned no rows.
+     *
+     * For an example see [Global:WorldDBQueryAsyncMulti].
+     *
+     * @param table queries : array of the queries to execute
+     * @param function callback : function that will be called when all the results are available
+     */
+    int AuthDBQueryAsyncMulti(lua_State* L)
+    {
+        return DBQueryAsyncMulti(L, LoginDatabase);
+    }
+
+    /**
+     * Executes a SQL query on the login database.
+     *
+     * The query may be executed *asynchronously* (at a later, unpredictable time).
+     * If you need to execute the query synchronously, use [Global:AuthDBQuery] instead.
+     *
+     * Any results produced are ignored.
+     * If you need results from the query, use [Global:AuthDBQuery] or [Global:AuthDBQueryAsync] instead.
+     *
+     *     AuthDBExecute("DELETE FROM my_table")
+     *
+     * @param string sql : query to execute
+     */
+    int AuthDBExecute(lua_State* L)
+    {
+        const char* query = Eluna::CHECKVAL<const char*>(L, 1);
+        LoginDatabase.Execute(query);
+        return 0;
+    }
+
+    static int DBPrepare(lua_State* L, ElunaDatabase database)
+    {
+        std::string name = Eluna::CHECKVAL<std::string>(L, 1);
+        size_t length;
+        const char* sql = luaL_checklstring(L, 2, &length);
+
+        std::vector<StatementParamType> params;
+        if (!lua_isnoneornil(L, 3))
+        {
+            luaL_checktype(L, 3, LUA_TTABLE);
+            size_t count = lua_rawlen(L, 3);
+            params.reserve(count);
+            for (size_t i = 1; i <= count; ++i)
+            {
+                lua_rawgeti(L, 3, i);
+                const char* typeName = lua_tostring(L, -1);
+                StatementParamType type;
+                if (!typeName || !StatementRegistry::ParseParamType(typeName, type))
+                    return luaL_error(L, "invalid type of parameter %d: %s", (int)i, typeName ? typeName : luaL_typename(L, -1));
+                params.push_back(type);
+                lua_pop(L, 1);
+            }
+        }
+
+        std::string error;
+        if (!Eluna::GEluna->statements.Add(name, database, std::string_view(sql, length), params, error))
+            return luaL_argerror(L, 2, error.c_str());
+        return 0;
+    }
+
+    template <typename T>
+    static void AppendNumber(std::string& sql, T value)
+    {
+        char buffer[32];
+        std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        sql.append(buffer, result.ptr);
+    }
+
+#if !defined(__cpp_lib_to_chars)
+    // Older standard libraries only convert integers, these digits always read back the same
+    static void AppendNumber(std::string& sql, float value)
+    {
+        char buffer[32];
+        sql.append(buffer, snprintf(buffer, sizeof(buffer), "%.9g", value));
+    }
+
+    static void AppendNumber(std::string& sql, double value)
+    {
+        char buffer[32];
+        sql.append(buffer, snprintf(buffer, sizeof(buffer), "%.17g", value));
+    }
+#endif
+
+    // Appends the argument at index as a SQL literal of the parameter's type
+    template <typename T>
+    static void AppendStatementParam(lua_State* L, int index, StatementParamType type, DatabaseWorkerPool<T>& db, std::string& sql)
+    {
+        switch (type)
+        {
+            case STMT_PARAM_BOOL:
+                sql.push_back(Eluna::CHECKVAL<bool>(L, index) ? '1' : '0');
+                break;
+            case STMT_PARAM_INT8:
+                AppendNumber(sql, Eluna::CHECKVAL<int8>(L, index));
+                break;
+            case STMT_PARAM_INT16:
+                AppendNumber(sql, Eluna::CHECKVAL<int16>(L, index));
+                break;
+            case STMT_PARAM_INT32:
+                AppendNumber(sql, Eluna::CHECKVAL<int32>(L, index));
+                break;
+            case STMT_PARAM_INT64:
+                AppendNumber(sql, Eluna::CHECKVAL<int64>(L, index));
+                break;
+            case STMT_PARAM_UINT8:
+                AppendNumber(sql, Eluna::CHECKVAL<uint8>(L, index));
+                break;
+            case STMT_PARAM_UINT16:
+                AppendNumber(sql, Eluna::CHECKVAL<uint16>(L, index));
+                break;
+            case STMT_PARAM_UINT32:
+                AppendNumber(sql, Eluna::CHECKVAL<uint32>(L, index));
+                break;
+            case STMT_PARAM_UINT64:
+                AppendNumber(sql, Eluna::CHECKVAL<uint64>(L, index));
+                break;
+            case STMT_PARAM_FLOAT:
+            case STMT_PARAM_DOUBLE:
+            {
+                double value = Eluna::CHECKVAL<double>(L, index);
+                if (!std::isfinite(value))
+                    luaL_argerror(L, index, "number is not finite");
+                if (type == STMT_PARAM_FLOAT)
+                    AppendNumber(sql, static_cast<float>(value));
+                else
+                    AppendNumber(sql, value);
+                break;
+            }
+            case STMT_PARAM_STRING:
+            {
+                std::string value = Eluna::CHECKVAL<std::string>(L, index);
+                db.EscapeString(value);
+                sql.push_back('\'');
+                sql += value;
+                sql.push_back('\'');
+                break;
+            }
+        }
+    }
+
+    // Builds the SQL of the statement with the arguments starting at firstArg
+    template <typename T>
+    static void BindStatement(lua_State* L, LuaStatement const& statement, int firstArg, DatabaseWorkerPool<T>& db, std::string& sql)
+    {
+        sql.reserve(statement.length + statement.params.size() * 16);
+        for (size_t i = 0; i < statement.params.size(); ++i)
+        {
+            sql += statement.fragments[i];
+            AppendStatementParam(L, firstArg + static_cast<int>(i), statement.params[i], db, sql);
+        }
+        sql += statement.fragments.back();
+    }
+
+    static LuaStatement const& CheckStatement(lua_State* L, int index = 1)
+    {
+        std::string name = Eluna::CHECKVAL<std::string>(L, index);
+        LuaStatement const* statement = Eluna::GEluna->statements.Find(name);
+        if (!statement)
+            luaL_argerror(L, index, "no statement with this name was prepared");
+        return *statement;
+    }
+
+    template <typename T>
+    static int ExecuteStatement(lua_State* L, LuaStatement const& statement, DatabaseWorkerPool<T>& db)
+    {
+        std::string sql;
+        BindStatement(L, statement, 2, db, sql);
+        db.Execute(sql.c_str());
+        return 0;
+    }
+
+    template <typename T>
+    static int QueryStatement(lua_State* L, LuaStatement const& statement, DatabaseWorkerPool<T>& db)
+    {
+        std::string sql;
+        BindStatement(L, statement, 2, db, sql);
+
+        ElunaQuery result = db.Query(sql.c_str());
+        if (result)
+            Eluna::Push(L, new ElunaQuery(result));
+        else
+            Eluna::Push(L);
+        return 1;
+    }
+
+    template <typename T>
+    static int QueryStatementAsync(lua_State* L, LuaStatement const& statement, DatabaseWorkerPool<T>& db)
+    {
+        std::string sql;
+        BindStatement(L, statement, 2, db, sql);
+        return DBQueryAsync(L, db, sql.c_str(), static_cast<int>(statement.params.size()) + 2);
+    }
+
+    // Key of a cached query, the SQL prefixed with its database
+    static std::string QueryCacheKey(ElunaDatabase database, std::string_view sql)
+    {
+        std::string key;
+        key.reserve(sql.size() + 1);
+        key.push_back(static_cast<char>('0' + database));
+        key += sql;
+        return key;
+    }
+
+    // Copies the field like ElunaQuery:GetRow converts it
+    static void AddCachedField(Field& field, QueryCache::Result& result)
+    {
+        // Cached rows must read back like the rows of ElunaQuery
+        bool read = ElunaUtil::ReadField(field,
+            [&result](double value) { result.AddNumber(value); },
+            [&result](const char* str, size_t length) { result.AddString(str, length); });
+        if (!read)
+            result.AddNull();
+    }
+
+    // Pushes the rows of the query from the cache, running the query and caching its rows on a miss
+    template <typename T>
+    static int QueryCached(lua_State* L, DatabaseWorkerPool<T>& db, ElunaDatabase database, std::string_view sql, uint32 ttl)
+    {
+        std::string key = QueryCacheKey(database, sql);
+        std::shared_ptr<QueryCache::Result const> cached = Eluna::GEluna->queryCache.Find(key);
+        if (!cached)
+        {
+            std::shared_ptr<QueryCache::Result> result = std::make_shared<QueryCache::Result>();
+#if defined TRINITY || AZEROTHCORE
+            if (ElunaQuery query = db.Query(key.c_str() + 1))
+            {
+                uint32 columns = query->GetFieldCount();
+                for (uint32 i = 0; i < columns; ++i)
+                    result->AddColumn(query->GetFieldName(i));
+#else
+            if (std::unique_ptr<ElunaQuery> query{ db.QueryNamed(key.c_str() + 1) })
+            {
+                uint32 columns = query->GetFieldCount();
+                const QueryFieldNames& names = query->GetFieldNames();
+                for (uint32 i = 0; i < columns; ++i)
+                    result->AddColumn(names[i]);
+#endif
+
+                do
+                {
+                    Field* row = query->Fetch();
+                    for (uint32 i = 0; i < columns; ++i)
+                        AddCachedField(row[i], *result);
+                } while (query->NextRow());
+            }
+
+            // Empty results are cached too, they are as costly to query
+            Eluna::GEluna->queryCache.Store(key, result, ttl);
+            cached = std::move(result);
+        }
+
+        if (cached->GetRowCount())
+            cached->Push(L);
+        else
+            Eluna::Push(L);
+        return 1;
+    }
+
+    template <typename T>
+    static int QueryStatementCached(lua_State* L, LuaStatement const& statement, DatabaseWorkerPool<T>& db)
+    {
+        std::string sql;
+        BindStatement(L, statement, 2, db, sql);
+        return QueryCached(L, db, statement.database, sql, 0);
+    }
+
+    // Executes the statements in one transaction, calling the function of funcRef with the outcome unless it is LUA_NOREF
+    template <typename T>
+    static void CommitStatements(DatabaseWorkerPool<T>& db, std::vector<std::string> const& statements, int funcRef)
+    {
+        SQLTransaction<T> sqlTrans = db.BeginTransaction();
+        for (std::string const& statement : statements)
+            sqlTrans->Append(statement);
+
+        if (funcRef == LUA_NOREF)
+        {
+            db.CommitTransaction(sqlTrans);
+            return;
+        }
+
+        ++Eluna::GEluna->metrics.dbCallbacksPending;
+        uint32 generation = Eluna::GEluna->stateGeneration;
+        Eluna::GEluna->transactionProcessor.AddCallback(db.AsyncCommitTransaction(sqlTrans)).AfterComplete([generation, funcRef](bool success)
+            {
+                LOCK_ELUNA;
+                --Eluna::GEluna->metrics.dbCallbacksPending;
+
+                // The function belonged to a state closed by a reload since
+                if (Eluna::GEluna->stateGeneration != generation)
+                    return;
+                lua_State* L = Eluna::GEluna->L;
+
+                // Get function
+                lua_rawgeti(L, LUA_REGISTRYINDEX, funcRef);
+
+                // Push parameters
+                Eluna::Push(L, success);
+
+                // Call function
+                Eluna::GEluna->ExecuteCall(1, 0);
+
+                luaL_unref(L, LUA_REGISTRYINDEX, funcRef);
+            });
+    }
+
+    // Appends the name quoted with backticks, schema.table names are quoted separately
+    static void AppendIdentifier(lua_State* L, int index, std::string_view name, std::string& sql)
+    {
+        if (name.empty() || name.find('`') != std::string_view::npos)
+            luaL_argerror(L, index, "invalid table or column name");
+
+        size_t dot = name.find('.');
+        if (dot != std::string_view::npos)
+        {
+            AppendIdentifier(L, index, name.substr(0, dot), sql);
+            sql.push_back('.');
+            AppendIdentifier(L, index, name.substr(dot + 1), sql);
+            return;
+        }
+
+        sql.push_back('`');
+        sql += name;
+        sql.push_back('`');
+    }
+
+    // Appends the Lua value at index as a SQL literal, nil and json.null are NULL
+    template <typename T>
+    static void AppendValue(lua_State* L, int index, DatabaseWorkerPool<T>& db, std::string& sql, std::string& scratch)
+    {
+        switch (lua_type(L, index))
+        {
+            case LUA_TNIL:
+                sql += "NULL";
+                break;
+            case LUA_TLIGHTUSERDATA:
+                if (lua_touserdata(L, index))
+                    luaL_error(L, "can't insert a %s value", luaL_typename(L, index));
+                sql += "NULL";
+                break;
+            case LUA_TBOOLEAN:
+                sql.push_back(lua_toboolean(L, index) ? '1' : '0');
+                break;
+            case LUA_TNUMBER:
+            {
+                double value = lua_tonumber(L, index);
+                if (!std::isfinite(value))
+                    luaL_error(L, "number is not finite");
+                // Whole numbers are written without an exponent or decimals
+                if (value == std::floor(value) && std::fabs(value) < 9223372036854775808.0)
+                    AppendNumber(sql, static_cast<int64>(value));
+                else
+                    AppendNumber(sql, value);
+                break;
+            }
+            case LUA_TSTRING:
+            {
+                size_t length;
+                const char* str = lua_tolstring(L, index, &length);
+                scratch.assign(str, length);
+                db.EscapeString(scratch);
+                sql.push_back('\'');
+                sql += scratch;
+                sql.push_back('\'');
+                break;
+            }
+            default:
+            {
+                // 64-bit integers are userdata converted with __tostring
+                size_t length;
+                const char* str = luaL_tolstring(L, index, &length);
+                std::string_view digits(str, length);
+                if (!digits.empty() && digits[0] == '-')
+                    digits.remove_prefix(1);
+                if (digits.empty() || digits.find_first_not_of("0123456789") != std::string_view::npos)
+                    luaL_error(L, "can't insert a %s value", luaL_typename(L, index));
+                sql.append(str, length);
+                lua_pop(L, 1);
+                break;
+            }
+        }
+    }
+
+    /*
+     * Builds INSERT statements from the arguments of the Insert functions: table, columns, rows[, options].
+     * The rows are split between statements so none is longer than maxSize, unless a single row is.
+     */
+    template <typename T>
+    static void BuildInsert(lua_State* L, int firstArg, DatabaseWorkerPool<T>& db, std::vector<std::string>& statements)
+    {
+        int tableIdx = firstArg;
+        int columnsIdx = firstArg + 1;
+        int rowsIdx = firstArg + 2;
+        int optionsIdx = firstArg + 3;
+
+        size_t tableLength;
+        const char* table = luaL_checklstring(L, tableIdx, &tableLength);
+        luaL_checktype(L, columnsIdx, LUA_TTABLE);
+        luaL_checktype(L, rowsIdx, LUA_TTABLE);
+
+        bool ignore = false;
+        size_t maxSize = 1024 * 1024;
+        if (lua_istable(L, optionsIdx))
+        {
+            lua_getfield(L, optionsIdx, "ignore");
+            ignore = lua_toboolean(L, -1) != 0;
+            lua_getfield(L, optionsIdx, "maxSize");
+            maxSize = std::max<uint32>(Eluna::CHECKVAL<uint32>(L, -1, static_cast<uint32>(maxSize)), 1024);
+            lua_pop(L, 2);
+        }
+
+        int columnCount = static_cast<int>(lua_rawlen(L, columnsIdx));
+        if (!columnCount)
+            luaL_argerror(L, columnsIdx, "no columns");
+        luaL_checkstack(L, columnCount + LUA_MINSTACK, "too many columns");
+
+        // INSERT INTO `table` (`a`,`b`) VALUES
+        std::string prefix = ignore ? "INSERT IGNORE INTO " : "INSERT INTO ";
+        AppendIdentifier(L, tableIdx, std::string_view(table, tableLength), prefix);
+        prefix += " (";
+        int names = lua_gettop(L) + 1;
+        for (int i = 1; i <= columnCount; ++i)
+        {
+            lua_rawgeti(L, columnsIdx, i);
+            if (lua_type(L, -1) != LUA_TSTRING)
+                luaL_argerror(L, columnsIdx, "column names must be strings");
+            size_t length;
+            const char* column = lua_tolstring(L, -1, &length);
+            if (i > 1)
+                prefix.push_back(',');
+            AppendIdentifier(L, columnsIdx, std::string_view(column, length), prefix);
+        }
+        prefix += ") VALUES ";
+
+        // ON DUPLICATE KEY UPDATE `a`=VALUES(`a`) for every column or the listed ones.
+        // VALUES() is deprecated since MySQL 8.0.20, but the row alias replacing it isn't supported by MariaDB.
+        std::string suffix;
+        if (lua_istable(L, optionsIdx))
+        {
+            lua_getfield(L, optionsIdx, "update");
+            int updateIdx = lua_gettop(L);
+            bool updateAll = lua_toboolean(L, updateIdx) && !lua_istable(L, updateIdx);
+            int updateCount = updateAll ? columnCount : (lua_istable(L, updateIdx) ? static_cast<int>(lua_rawlen(L, updateIdx)) : 0);
+            for (int i = 1; i <= updateCount; ++i)
+            {
+                if (updateAll)
+                    lua_pushvalue(L, names + i - 1);
+                else
+                    lua_rawgeti(L, updateIdx, i);
+
+                if (lua_type(L, -1) != LUA_TSTRING)
+                    luaL_argerror(L, optionsIdx, "update column names must be strings");
+                size_t length;
+                const char* column = lua_tolstring(L, -1, &length);
+
+                suffix += i > 1 ? "," : " ON DUPLICATE KEY UPDATE ";
+                AppendIdentifier(L, optionsIdx, std::string_view(column, length), suffix);
+                suffix += "=VALUES(";
+                AppendIdentifier(L, optionsIdx, std::string_view(column, length), suffix);
+                suffix.push_back(')');
+                lua_pop(L, 1);
+            }
+            lua_pop(L, 1);
+        }
+
+        std::string statement;
+        std::string row;
+        std::string scratch;
+        size_t rowCount = lua_rawlen(L, rowsIdx);
+        for (size_t r = 1; r <= rowCount; ++r)
+        {
+            lua_rawgeti(L, rowsIdx, static_cast<int>(r));
+            int rowIdx = lua_gettop(L);
+            if (!lua_istable(L, rowIdx))
+                luaL_error(L, "row %d is not a table", static_cast<int>(r));
+
+            // Rows are arrays in column order or tables keyed by column name.
+            // A row with any string key is keyed, an array can start with nil.
+            bool positional = true;
+            lua_pushnil(L);
+            while (lua_next(L, rowIdx))
+            {
+                lua_pop(L, 1);
+                if (lua_type(L, -1) == LUA_TSTRING)
+                {
+                    positional = false;
+                    lua_pop(L, 1);
+                    break;
+                }
+            }
+
+            row.clear();
+            row.push_back('(');
+            for (int i = 0; i < columnCount; ++i)
+            {
+                if (positional)
+                    lua_rawgeti(L, rowIdx, i + 1);
+                else
+                {
+                    lua_pushvalue(L, names + i);
+                    lua_rawget(L, rowIdx);
+                }
+
+                if (i)
+                    row.push_back(',');
+                AppendValue(L, lua_gettop(L), db, row, scratch);
+                lua_pop(L, 1);
+            }
+            row.push_back(')');
+            lua_pop(L, 1);
+
+            if (!statement.empty() && statement.size() + 1 + row.size() + suffix.size() > maxSize)
+            {
+                statement += suffix;
+                statements.push_back(std::move(statement));
+                statement.clear();
+            }
+
+            if (statement.empty())
+            {
+                statement.reserve(std::min(maxSize, prefix.size() + row.size() * (rowCount - r + 1) + suffix.size()));
+                statement += prefix;
+            }
+            else
+                statement.push_back(',');
+            statement += row;
+        }
+
+        if (!statement.empty())
+        {
+            statement += suffix;
+            statements.push_back(std::move(statement));
+        }
+
+        lua_settop(L, names - 1);
+    }
+
+    template <typename T>
+    static int DBInsert(lua_State* L, DatabaseWorkerPool<T>& db)
+    {
+        std::vector<std::string> statements;
+        BuildInsert(L, 1, db, statements);
+
+        int funcIdx = lua_isfunction(L, 4) ? 4 : 5;
+        int funcRef = LUA_NOREF;
+        if (!lua_isnoneornil(L, funcIdx))
+        {
+            luaL_checktype(L, funcIdx, LUA_TFUNCTION);
+            lua_pushvalue(L, funcIdx);
+            funcRef = luaL_ref(L, LUA_REGISTRYINDEX);
+            if (funcRef == LUA_REFNIL || funcRef == LUA_NOREF)
+                return luaL_argerror(L, funcIdx, "unable to make a ref to function");
+        }
+
+        // One statement needs no transaction unless someone waits for the outcome
+        if (statements.size() == 1 && funcRef == LUA_NOREF)
+            db.Execute(statements.front().c_str());
+        else if (!statements.empty() || funcRef != LUA_NOREF)
+            CommitStatements(db, statements, funcRef);
+
+        Eluna::Push(L, static_cast<uint32>(statements.size()));
+        return 1;
+    }
+
+    /**
+     * Declares a named statement on the world database, to be called later with [Global:ExecuteStatement],
+     *   [Global:QueryStatement] or [Global:QueryStatementAsync].
+     *
+     * Each `?` in the SQL is a parameter, its type is given in the types table in order.
+     * The types are `"bool"`, `"int8"`, `"int16"`, `"int32"`, `"int64"`, `"uint8"`, `"uint16"`, `"uint32"`, `"uint64"`,
+     *   `"float"`, `"double"` and `"string"`.
+     * The SQL is split at the parameters once here, each call only checks the arguments against their types
+     *   and joins them with the SQL, escaping strings, so scripts don't build queries with `string.format`.
+     *
+     * Declaring a statement with an existing name replaces it. Statements are removed when Eluna is reloaded.
+     *
+     *     WorldDBPrepare("creature_name", "SELECT name FROM creature_template WHERE entry = ?", { "uint32" })
+     *     local Q = QueryStatement("creature_name", 6)
+     *
+     * @param string name : name of the statement
+     * @param string sql : SQL of the statement with `?` for each parameter
+     * @param table types = nil : array of the parameter types
+     */
+    int WorldDBPrepare(lua_State* L)
+    {
+        return DBPrepare(L, ELUNA_WORLD_DB);
+    }
+
+    /**
+     * Declares a named statement on the character database, see [Global:WorldDBPrepare].
+     *
+     *     CharDBPrepare("set_flag", "REPLACE INTO my_flags (guid, flag) VALUES (?, ?)", { "uint32", "string" })
+     *     ExecuteStatement("set_flag", player:GetGUIDLow(), "visited")
+     *
+     * @param string name : name of the statement
+     * @param string sql : SQL of the statement with `?` for each parameter
+     * @param table types = nil : array of the parameter types
+     */
+    int CharDBPrepare(lua_State* L)
+    {
+        return DBPrepare(L, ELUNA_CHARACTER_DB);
+    }
+
+    /**
+     * Declares a named statement on the auth database, see [Global:WorldDBPrepare].
+     *
+     * @param string name : name of the statement
+     * @param string sql : SQL of the statement with `?` for each parameter
+     * @param table types = nil : array of the parameter types
+     */
+    int AuthDBPrepare(lua_State* L)
+    {
+        return DBPrepare(L, ELUNA_AUTH_DB);
+    }
+
+    /**
+     * Executes a statement declared with [Global:WorldDBPrepare], [Global:CharDBPrepare] or [Global:AuthDBPrepare],
+     *   ignoring its results like [Global:WorldDBExecute].
+     *
+     * @param string name : name of the statement
+     * @param ... : one argument for each parameter of the statement
+     */
+    int ExecuteStatement(lua_State* L)
+    {
+        LuaStatement const& statement = CheckStatement(L);
+        switch (statement.database)
+        {
+            case ELUNA_CHARACTER_DB:
+                return ExecuteStatement(L, statement, CharacterDatabase);
+            case ELUNA_AUTH_DB:
+                return ExecuteStatement(L, statement, LoginDatabase);
+            default:
+                return ExecuteStatement(L, statement, WorldDatabase);
+        }
+    }
+
+    /**
+     * Executes a statement declared with [Global:WorldDBPrepare], [Global:CharDBPrepare] or [Global:AuthDBPrepare]
+     *   and returns its results like [Global:WorldDBQuery].
+     *
+     * @param string name : name of the statement
+     * @param ... : one argument for each parameter of the statement
+     * @return [ElunaQuery] results or nil if no rows found
+     */
+    int QueryStatement(lua_State* L)
+    {
+        LuaStatement const& statement = CheckStatement(L);
+        switch (statement.database)
+        {
+            case ELUNA_CHARACTER_DB:
+                return QueryStatement(L, statement, CharacterDatabase);
+            case ELUNA_AUTH_DB:
+                return QueryStatement(L, statement, LoginDatabase);
+            default:
+                return QueryStatement(L, statement, WorldDatabase);
+        }
+    }
+
+    /**
+     * Executes a statement declared with [Global:WorldDBPrepare], [Global:CharDBPrepare] or [Global:AuthDBPrepare] asynchronously
+     *   and passes its results to the callback like [Global:WorldDBQueryAsync].
+     *
+     *     QueryStatementAsync("creature_name", 6, function(Q)
+     *         if Q then
+     *             print(Q:GetString(0))
+     *         end
+     *     end)
+     *
+     * @param string name : name of the statement
+     * @param ... : one argument for each parameter of the statement
+     * @param function callback : function that will be called when the results are available
+     */
+    int QueryStatementAsync(lua_State* L)
+    {
+        LuaStatement const& statement = CheckStatement(L);
+        switch (statement.database)
+        {
+            case ELUNA_CHARACTER_DB:
+                return QueryStatementAsync(L, statement, CharacterDatabase);
+            case ELUNA_AUTH_DB:
+                return QueryStatementAsync(L, statement, LoginDatabase);
+            default:
+                return QueryStatementAsync(L, statement, WorldDatabase);
+        }
+    }
+
+    /**
+     * Returns the rows of a query on the world database, keeping them in a cache so the same query doesn't go to the database again
+     *   until the rows expire.
+     *
+     * Meant for queries on tables that don't change while the server runs, like `creature_template` or custom configuration tables.
+     * The rows are returned as an array of tables like [ElunaQuery:GetRows]. The tables are new on every call and can be modified.
+     * Queries are cached by their SQL text, `ttl` and the size of the cache default to `Eluna.QueryCache.DefaultTTL`
+     *   and `Eluna.QueryCache.MaxSize` in the configuration. Use [Global:InvalidateQueryCache] after changing the tables.
+     *
+     *     local rows = WorldDBQueryCached("SELECT entry, text FROM my_gossip_texts", 600)
+     *     if rows then
+     *         for i, row in ipairs(rows) do
+     *             print(row.entry, row.text)
+     *         end
+     *     end
+     *
+     * @param string sql : query to run
+     * @param uint32 ttl = 0 : seconds the rows are kept, 0 for the configured default
+     * @return table rows : array of the rows where `T[i][column] = data`, or nil if no rows found
+     */
+    int WorldDBQueryCached(lua_State* L)
+    {
+        size_t length;
+        const char* sql = luaL_checklstring(L, 1, &length);
+        uint32 ttl = Eluna::CHECKVAL<uint32>(L, 2, 0);
+        return QueryCached(L, WorldDatabase, ELUNA_WORLD_DB, std::string_view(sql, length), ttl);
+    }
+
+    /**
+     * Returns the rows of a query on the character database, keeping them in a cache like [Global:WorldDBQueryCached].
+     *
+     * @param string sql : query to run
+     * @param uint32 ttl = 0 : seconds the rows are kept, 0 for the configured default
+     * @return table rows : array of the rows where `T[i][column] = data`, or nil if no rows found
+     */
+    int CharDBQueryCached(lua_State* L)
+    {
+        size_t length;
+        const char* sql = luaL_checklstring(L, 1, &length);
+        uint32 ttl = Eluna::CHECKVAL<uint32>(L, 2, 0);
+        return QueryCached(L, CharacterDatabase, ELUNA_CHARACTER_DB, std::string_view(sql, length), ttl);
+    }
+
+    /**
+     * Returns the rows of a query on the auth database, keeping them in a cache like [Global:WorldDBQueryCached].
+     *
+     * @param string sql : query to run
+     * @param uint32 ttl = 0 : seconds the rows are kept, 0 for the configured default
+     * @return table rows : array of the rows where `T[i][column] = data`, or nil if no rows found
+     */
+    int AuthDBQueryCached(lua_State* L)
+    {
+        size_t length;
+        const char* sql = luaL_checklstring(L, 1, &length);
+        uint32 ttl = Eluna::CHECKVAL<uint32>(L, 2, 0);
+        return QueryCached(L, LoginDatabase, ELUNA_AUTH_DB, std::string_view(sql, length), ttl);
+    }
+
+    /**
+     * Executes a statement declared with [Global:WorldDBPrepare], [Global:CharDBPrepare] or [Global:AuthDBPrepare]
+     *   and returns its rows from the cache like [Global:WorldDBQueryCached].
+     *
+     * Every combination of arguments is cached separately, for `Eluna.QueryCache.DefaultTTL` seconds.
+     *
+     *     WorldDBPrepare("creature_name", "SELECT name FROM creature_template WHERE entry = ?", { "uint32" })
+     *     local rows = QueryStatementCached("creature_name", 6)
+     *
+     * @param string name : name of the statement
+     * @param ... : one argument for each parameter of the statement
+     * @return table rows : array of the rows where `T[i][column] = data`, or nil if no rows found
+     */
+    int QueryStatementCached(lua_State* L)
+    {
+        LuaStatement const& statement = CheckStatement(L);
+        switch (statement.database)
+        {
+            case ELUNA_CHARACTER_DB:
+                return QueryStatementCached(L, statement, CharacterDatabase);
+            case ELUNA_AUTH_DB:
+                return QueryStatementCached(L, statement, LoginDatabase);
+            default:
+                return QueryStatementCached(L, statement, WorldDatabase);
+        }
+    }
+
+    /**
+     * Removes queries from the cache of [Global:WorldDBQueryCached] and the like, so they are run again when next used.
+     *
+     * Without arguments the whole cache is emptied. With `partial` every query containing the text is removed,
+     *   which can be used with a table name after changing the table.
+     *
+     *     WorldDBExecute("UPDATE my_gossip_texts SET text = 'Hello' WHERE entry = 1")
+     *     InvalidateQueryCache("my_gossip_texts", true)
+     *
+     * @proto count = ()
+     * @proto count = (sql)
+     * @proto count = (text, partial)
+     * @param string sql : SQL of the query to remove, as it was passed
+     * @param bool partial = false : remove every query containing the text instead
+     * @return uint32 count : number of queries removed
+     */
+    int InvalidateQueryCache(lua_State* L)
+    {
+        QueryCache& cache = Eluna::GEluna->queryCache;
+        if (lua_isnoneornil(L, 1))
+        {
+            uint32 count = static_cast<uint32>(cache.GetStats().entries);
+            cache.Clear();
+            Eluna::Push(L, count);
+            return 1;
+        }
+
+        size_t length;
+        const char* text = luaL_checklstring(L, 1, &length);
+        bool partial = Eluna::CHECKVAL<bool>(L, 2, false);
+
+        size_t count = 0;
+        if (partial)
+            count = cache.Invalidate(std::string_view(text, length), true);
+        else
+        {
+            for (ElunaDatabase database : { ELUNA_WORLD_DB, ELUNA_CHARACTER_DB, ELUNA_AUTH_DB })
+                count += cache.Invalidate(QueryCacheKey(database, std::string_view(text, length)), false);
+        }
+
+        Eluna::Push(L, static_cast<uint32>(count));
+        return 1;
+    }
+
+    /**
+     * Returns the counters of the cache used by [Global:WorldDBQueryCached] and the like.
+     *
+     * The table contains:
+     *
+     * - hits : queries answered from the cache
+     * - misses : queries that were not cached or had expired and went to the database
+     * - evictions : queries removed before expiring to keep the cache under its maximum size
+     * - entries : queries in the cache
+     * - size : approximate memory used by the cache in bytes
+     *
+     * @return table stats
+     */
+    int GetQueryCacheStats(lua_State* L)
+    {
+        QueryCache::Stats stats = Eluna::GEluna->queryCache.GetStats();
+
+        lua_createtable(L, 0, 5);
+        Eluna::Push(L, static_cast<double>(stats.hits));
+        lua_setfield(L, -2, "hits");
+        Eluna::Push(L, static_cast<double>(stats.misses));
+        lua_setfield(L, -2, "misses");
+        Eluna::Push(L, static_cast<double>(stats.evictions));
+        lua_setfield(L, -2, "evictions");
+        Eluna::Push(L, static_cast<uint32>(stats.entries));
+        lua_setfield(L, -2, "entries");
+        Eluna::Push(L, static_cast<double>(stats.size));
+        lua_setfield(L, -2, "size");
+        return 1;
+    }
+
+    /**
+     * Returns a new [ElunaTransaction] on the world database.
+     *
+     * @return [ElunaTransaction] transaction
+     */
+    int WorldDBTransaction(lua_State* L)
+    {
+        Eluna::Push(L, new ElunaTransaction(ELUNA_WORLD_DB));
+        return 1;
+    }
+
+    /**
+     * Returns a new [ElunaTransaction] on the character database.
      *
-     * The query is executed asynchronously
-     *   (i.e. the server keeps running while the query is executed in parallel, and results are passed to a callback function).
-     * If you need to execute the query synchronously, use [Global:AuthDBQuery] instead.
+     *     CharDBPrepare("add_points", "UPDATE my_points SET points = points + ? WHERE guid = ?", { "uint32", "uint32" })
      *
-     * For an example see [Global:WorldDBQueryAsync].
+     *     local trans = CharDBTransaction()
+     *     trans:AppendStatement("add_points", 10, player:GetGUIDLow())
+     *     trans:Append("DELETE FROM my_pending_rewards")
+     *     trans:Commit()
      *
-     * @param string sql : query to execute
-     * @param function callback : function that will be called when the results are available
+     * @return [ElunaTransaction] transaction
      */
-    int AuthDBQueryAsync(lua_State* L)
+    int CharDBTransaction(lua_State* L)
     {
-        return DBQueryAsync(L, LoginDatabase);
+        Eluna::Push(L, new ElunaTransaction(ELUNA_CHARACTER_DB));
+        return 1;
     }
 
     /**
-     * Executes a SQL query on the login database.
-     *
-     * The query may be executed *asynchronously* (at a later, unpredictable time).
-     * If you need to execute the query synchronously, use [Global:AuthDBQuery] instead.
+     * Returns a new [ElunaTransaction] on the auth database.
      *
-     * Any results produced are ignored.
-     * If you need results from the query, use [Global:AuthDBQuery] or [Global:AuthDBQueryAsync] instead.
+     * @return [ElunaTransaction] transaction
+     */
+    int AuthDBTransaction(lua_State* L)
+    {
+        Eluna::Push(L, new ElunaTransaction(ELUNA_AUTH_DB));
+        return 1;
+    }
+
+    /**
+     * Inserts rows into a table of the world database.
+     *
+     * The rows can be arrays with the values in the order of the columns, or tables with the column names as keys.
+     * A row with any string key is read by column name, missing columns are NULL.
+     * Values can be strings (escaped in C++), numbers, booleans, 64-bit integers or nil for `NULL`.
+     * The rows are sent as multi-row `INSERT ... VALUES (...),(...)` statements of at most `maxSize` bytes,
+     *   several statements are committed as one transaction.
+     * The statements are executed asynchronously, like [Global:WorldDBExecute].
+     *
+     * The options table can contain:
+     *
+     * - update : `true` to update every column of rows with a duplicate key, or an array of the columns to update.
+     *   The update uses `col=VALUES(col)`, which MySQL 8.0.20 and later accept with a deprecation warning.
+     *   The newer row alias form is not used, MariaDB and older MySQL versions don't support it.
+     * - ignore : `true` to skip rows with a duplicate key (`INSERT IGNORE`)
+     * - maxSize : maximum length in bytes of a statement, the default is 1MB which is below the default `max_allowed_packet` of MySQL
+     *
+     * If a callback is given it is called with `true` when the rows were inserted, or `false` if the transaction failed.
+     *
+     *     WorldDBInsert("my_spawns", { "id", "map", "x", "y", "z" }, {
+     *         { 1, 0, -8913.2, 554.6, 93.8 },
+     *         { 2, 0, -8920.1, 560.3, 94.1 },
+     *     }, { update = true })
+     *
+     * @proto statementCount = (table, columns, rows)
+     * @proto statementCount = (table, columns, rows, options)
+     * @proto statementCount = (table, columns, rows, callback)
+     * @proto statementCount = (table, columns, rows, options, callback)
+     * @param string table : name of the table
+     * @param table columns : array of the column names
+     * @param table rows : array of the rows to insert
+     * @param table options : see above
+     * @param function callback : function that will be called when the rows have been inserted
+     * @return uint32 statementCount : number of INSERT statements the rows were split into
+     */
+    int WorldDBInsert(lua_State* L)
+    {
+        return DBInsert(L, WorldDatabase);
+    }
+
+    /**
+     * Inserts rows into a table of the character database, see [Global:WorldDBInsert].
      *
-     *     AuthDBExecute("DELETE FROM my_table")
+     *     CharDBInsert("my_scores", { "guid", "score" }, scores, { update = { "score" } }, function(success)
+     *         print("scores saved", success)
+     *     end)
      *
-     * @param string sql : query to execute
+     * @proto statementCount = (table, columns, rows)
+     * @proto statementCount = (table, columns, rows, options)
+     * @proto statementCount = (table, columns, rows, callback)
+     * @proto statementCount = (table, columns, rows, options, callback)
+     * @param string table : name of the table
+     * @param table columns : array of the column names
+     * @param table rows : array of the rows to insert
+     * @param table options : see [Global:WorldDBInsert]
+     * @param function callback : function that will be called when the rows have been inserted
+     * @return uint32 statementCount : number of INSERT statements the rows were split into
      */
-    int AuthDBExecute(lua_State* L)
+    int CharDBInsert(lua_State* L)
     {
-        const char* query = Eluna::CHECKVAL<const char*>(L, 1);
-        LoginDatabase.Execute(query);
-        return 0;
+        return DBInsert(L, CharacterDatabase);
+    }
+
+    /**
+     * Inserts rows into a table of the auth database, see [Global:WorldDBInsert].
+     *
+     * @proto statementCount = (table, columns, rows)
+     * @proto statementCount = (table, columns, rows, options)
+     * @proto statementCount = (table, columns, rows, callback)
+     * @proto statementCount = (table, columns, rows, options, callback)
+     * @param string table : name of the table
+     * @param table columns : array of the column names
+     * @param table rows : array of the rows to insert
+     * @param table options : see [Global:WorldDBInsert]
+     * @param function callback : function that will be called when the rows have been inserted
+     * @return uint32 statementCount : number of INSERT statements the rows were split into
+     */
+    int AuthDBInsert(lua_State* L)
+    {
+        return DBInsert(L, LoginDatabase);
     }
 
     /**
@@ -2012,6 +3576,9 @@ namespace LuaGlobalFunctions
     /**
      * Creates a [WorldPacket].
      *
+     * Packets are taken from a pool of recycled packets and returned to it when garbage collected
+     *   or when [WorldPacket:Release] is called.
+     *
      * @param [Opcodes] opcode : the opcode of the packet
      * @param uint32 size : the size of the packet
      * @return [WorldPacket] packet
@@ -2023,7 +3590,7 @@ namespace LuaGlobalFunctions
         if (opcode >= NUM_MSG_TYPES)
             return luaL_argerror(L, 1, "valid opcode expected");
 
-        Eluna::Push(L, new WorldPacket((OpcodesList)opcode, size));
+        Eluna::Push(L, Eluna::GetEluna(L)->packetPool.Acquire(opcode, size));
         return 1;
     }
 
@@ -2816,6 +4383,72 @@ namespace LuaGlobalFunctions
         return 0;
     }
 
+    /*
+     * Reads the arguments of HttpRequest before the callback: httpMethod, url[, body, contentType][, headers].
+     * Returns the index of the argument after them.
+     */
+    static int ReadHttpRequest(lua_State* L, std::string& httpVerb, std::string& url, std::string& body, std::string& bodyContentType, httplib::Headers& headers)
+    {
+        httpVerb = Eluna::CHECKVAL<std::string>(L, 1);
+        url = Eluna::CHECKVAL<std::string>(L, 2);
+
+        int headersIdx = 3;
+        int nextIdx = 3;
+
+        if (!lua_istable(L, headersIdx) && lua_isstring(L, headersIdx) && lua_isstring(L, headersIdx + 1))
+        {
+            body = Eluna::CHECKVAL<std::string>(L, 3);
+            bodyContentType = Eluna::CHECKVAL<std::string>(L, 4);
+            headersIdx = 5;
+            nextIdx = 5;
+        }
+        else if (lua_istable(L, 3) && lua_isstring(L, 4))
+        {
+            // Encode straight into the request body instead of building a Lua string first
+            std::string error;
+            if (!LuaJson::Encode(L, 3, body, LuaJson::EncodeOptions(), error))
+                luaL_argerror(L, 3, error.c_str());
+            bodyContentType = Eluna::CHECKVAL<std::string>(L, 4);
+            headersIdx = 5;
+            nextIdx = 5;
+        }
+
+        if (lua_istable(L, headersIdx))
+        {
+            ++nextIdx;
+
+            lua_pushnil(L); // First key
+            while (lua_next(L, headersIdx) != 0)
+            {
+                // Uses 'key' (at index -2) and 'value' (at index -1)
+                if (lua_isstring(L, -2))
+                {
+                    std::string key(lua_tostring(L, -2));
+                    std::string value(lua_tostring(L, -1));
+                    headers.insert(std::pair<std::string, std::string>(key, value));
+                }
+                // Removes 'value'; keeps 'key' for next iteration
+                lua_pop(L, 1);
+            }
+        }
+
+        return nextIdx;
+    }
+
+    static void ReadHttpResponseOptions(lua_State* L, int optionsIdx, HttpResponseOptions& options)
+    {
+        if (lua_istable(L, optionsIdx))
+        {
+            lua_getfield(L, optionsIdx, "lazyHeaders");
+            options.lazyHeaders = Eluna::CHECKVAL<bool>(L, -1, false);
+            lua_getfield(L, optionsIdx, "json");
+            options.json = Eluna::CHECKVAL<bool>(L, -1, false);
+            lua_getfield(L, optionsIdx, "chunkSize");
+            options.chunkSize = Eluna::CHECKVAL<uint32>(L, -1, 0);
+            lua_pop(L, 3);
+        }
+    }
+
     /**
      * Performs a non-blocking HTTP request.
      *
@@ -2831,6 +4464,16 @@ namespace LuaGlobalFunctions
      *         print(body)
      *     end)
      *
+     *     -- POST example with the body encoded from a table
+     *     HttpRequest("POST", "https://jsonplaceholder.typicode.com/posts", { userId = 1, title = "Foo", body = "Bar!" }, "application/json", function(status, body, headers)
+     *         print(json.decode(body).id)
+     *     end)
+     *
+     *     -- Large JSON response, decoded without building the body string and with headers read on access
+     *     HttpRequest("GET", "https://example.com/items.json", function(status, items, headers, err)
+     *         print(#items, headers["Content-Type"])
+     *     end, { json = true, lazyHeaders = true })
+     *
      *     -- Example with request headers
      *     HttpRequest("GET", "https://postman-echo.com/headers", { Accept = "application/json", ["User-Agent"] = "Eluna Lua Engine" }, function(status, body, headers)
      *         print(body)
@@ -2840,64 +4483,461 @@ namespace LuaGlobalFunctions
      * @proto (httpMethod, url, headers, function)
      * @proto (httpMethod, url, body, contentType, function)
      * @proto (httpMethod, url, body, contentType, headers, function)
+     * @proto (httpMethod, url, bodyTable, contentType, function)
+     * @proto (httpMethod, url, bodyTable, contentType, headers, function)
+     * @proto (httpMethod, url, ..., function, options)
+     *
+     * The options table after the function can contain:
+     *
+     * - lazyHeaders : pass the headers as a userdata that looks up the header on access (case insensitive) and supports `pairs`, instead of a table
+     * - json : pass the body decoded with `json.decode`, on failure the body is nil and the error is passed as the 4th parameter
+     * - chunkSize : pass the body in chunks of this many bytes, one call per chunk.
+     *   The 4th parameter is true for the last chunk, or the only one of a shorter body, and only the first chunk gets the headers.
+     *
+     * Callbacks are called from the world update within the time and count budget set by the
+     *   Eluna.Http.ResponseBudget and Eluna.Http.ResponsesPerUpdate config, the rest wait for the next update.
      *
      * @param string httpMethod : the HTTP method to use (possible values are: `"GET"`, `"HEAD"`, `"POST"`, `"PUT"`, `"PATCH"`, `"DELETE"`, `"OPTIONS"`)
      * @param string url : the URL to query
      * @param table headers : a table with string key-value pairs containing the request headers
      * @param string body : the request's body (only used for POST, PUT and PATCH requests)
+     * @param table bodyTable : a table encoded as the JSON body, see `json.encode`
      * @param string contentType : the body's content-type
      * @param function function : function that will be called when the request is executed
+     * @param table options : how the response is passed to the function, see above
+     * @return bool queued : false if the request queue was full and the request was discarded, see the Eluna.Http.QueuePolicy config
      */
     int HttpRequest(lua_State* L)
     {
-        std::string httpVerb = Eluna::CHECKVAL<std::string>(L, 1);
-        std::string url = Eluna::CHECKVAL<std::string>(L, 2);
+        std::string httpVerb;
+        std::string url;
         std::string body;
         std::string bodyContentType;
         httplib::Headers headers;
+        int callbackIdx = ReadHttpRequest(L, httpVerb, url, body, bodyContentType, headers);
 
-        int headersIdx = 3;
-        int callbackIdx = 3;
+        HttpResponseOptions options;
+        ReadHttpResponseOptions(L, callbackIdx + 1, options);
 
-        if (!lua_istable(L, headersIdx) && lua_isstring(L, headersIdx) && lua_isstring(L, headersIdx + 1))
+        lua_pushvalue(L, callbackIdx);
+        int funcRef = luaL_ref(L, LUA_REGISTRYINDEX);
+        if (funcRef < 0)
+            return luaL_argerror(L, callbackIdx, "unable to make a ref to function");
+
+        Eluna::Push(L, Eluna::GEluna->httpManager.PushRequest(new HttpWorkItem(funcRef, httpVerb, url, body, bodyContentType, headers, options)));
+        return 1;
+    }
+
+    /**
+     * Returns the state of the [HttpRequest] queue.
+     *
+     * The returned table has the fields:
+     *
+     * - queued : requests waiting for a worker or for a connection to their host
+     * - inFlight : requests being executed
+     * - dropped : requests discarded because the queue was full, since startup
+     * - rejected : requests refused because the queue was full, since startup
+     * - responses : responses waiting for their callback to be called
+     *
+     * @return table stats
+     */
+    int GetHttpStats(lua_State* L)
+    {
+        HttpStats stats = Eluna::GEluna->httpManager.GetStats();
+
+        lua_createtable(L, 0, 5);
+        Eluna::Push(L, static_cast<double>(stats.queued));
+        lua_setfield(L, -2, "queued");
+        Eluna::Push(L, static_cast<double>(stats.inFlight));
+        lua_setfield(L, -2, "inFlight");
+        Eluna::Push(L, static_cast<double>(stats.dropped));
+        lua_setfield(L, -2, "dropped");
+        Eluna::Push(L, static_cast<double>(stats.rejected));
+        lua_setfield(L, -2, "rejected");
+        Eluna::Push(L, static_cast<double>(stats.responses));
+        lua_setfield(L, -2, "responses");
+        return 1;
+    }
+
+    /**
+     * Runs the function as a coroutine that can wait for timers, queries and HTTP requests without callbacks.
+     *
+     * The function runs right away until it calls [Global:Wait], [Global:AwaitWorldDBQuery] or another await function.
+     * It then continues from the world update when what it waits for is done, while the server keeps running.
+     * Errors are reported like errors in event handlers.
+     *
+     * Objects like [Player] passed to the function or returned by methods are only valid until the first await,
+     *   keep their GUID and get them again after awaiting.
+     *
+     *     RegisterPlayerEvent(3, function(event, player)
+     *         local guid, guidLow = player:GetGUID(), player:GetGUIDLow()
+     *         Async(function()
+     *             local Q = AwaitCharDBQuery("SELECT points FROM my_points WHERE guid = " .. guidLow)
+     *             Wait(2000)
+     *             local player = GetPlayerByGUID(guid)
+     *             if player and Q then
+     *                 player:SendBroadcastMessage("You have " .. Q:GetUInt32(0) .. " points")
+     *             end
+     *         end)
+     *     end)
+     *
+     * @param function func : function to run
+     * @param ... : arguments passed to the function
+     */
+    int Async(lua_State* L)
+    {
+        luaL_checktype(L, 1, LUA_TFUNCTION);
+        Eluna::GEluna->coroutines.Start(L, lua_gettop(L) - 1);
+        return 0;
+    }
+
+    /**
+     * Pauses the function started with [Global:Async] for the given time.
+     *
+     * The function continues from the first world update after the delay.
+     *
+     * @param uint32 delay = 0 : time to wait in milliseconds
+     */
+    int Wait(lua_State* L)
+    {
+        uint32 delay = Eluna::CHECKVAL<uint32>(L, 1, 0);
+
+        CoroutineScheduler& coroutines = Eluna::GEluna->coroutines;
+        coroutines.Sleep(coroutines.Suspend(L), delay);
+        return lua_yield(L, 0);
+    }
+
+    /**
+     * Executes a query on the world database from a function started with [Global:Async] and returns its [ElunaQuery] once it is done.
+     *
+     * The server keeps running while the query is executed, like with [Global:WorldDBQueryAsync].
+     *
+     * @param string sql : query to execute
+     * @return [ElunaQuery] results or nil if no rows found
+     */
+    int AwaitWorldDBQuery(lua_State* L)
+    {
+        return AwaitQuery(L, WorldDatabase);
+    }
+
+    /**
+     * Executes a query on the character database from a function started with [Global:Async] and returns its [ElunaQuery] once it is done.
+     *
+     * The server keeps running while the query is executed, like with [Global:CharDBQueryAsync].
+     *
+     * @param string sql : query to execute
+     * @return [ElunaQuery] results or nil if no rows found
+     */
+    int AwaitCharDBQuery(lua_State* L)
+    {
+        return AwaitQuery(L, CharacterDatabase);
+    }
+
+    /**
+     * Executes a query on the auth database from a function started with [Global:Async] and returns its [ElunaQuery] once it is done.
+     *
+     * The server keeps running while the query is executed, like with [Global:AuthDBQueryAsync].
+     *
+     * @param string sql : query to execute
+     * @return [ElunaQuery] results or nil if no rows found
+     */
+    int AwaitAuthDBQuery(lua_State* L)
+    {
+        return AwaitQuery(L, LoginDatabase);
+    }
+
+    /**
+     * Sends an HTTP request from a function started with [Global:Async] and returns the response once it arrives.
+     *
+     * Takes the arguments of [Global:HttpRequest] without the callback, and returns what the callback would get.
+     * The `json` and `lazyHeaders` options are supported, `chunkSize` is not.
+     * Returns nothing if the request could not be sent or failed without a response.
+     *
+     *     Async(function()
+     *         local status, body = AwaitHttp("GET", "https://example.com/motd.txt")
+     *         if status == 200 then
+     *             SendWorldMessage(body)
+     *         end
+     *     end)
+     *
+     * @proto status, body, headers = (httpMethod, url)
+     * @proto status, body, headers = (httpMethod, url, headers)
+     * @proto status, body, headers = (httpMethod, url, body, contentType)
+     * @proto status, body, headers = (httpMethod, url, body, contentType, headers)
+     * @proto status, body, headers = (httpMethod, url, ..., options)
+     * @param string httpMethod : the HTTP method to use
+     * @param string url : the URL to query
+     * @param table headers : a table with string key-value pairs containing the request headers
+     * @param string body : the request's body, or a table encoded as JSON
+     * @param string contentType : the body's content-type
+     * @param table options : how the response is returned, see [Global:HttpRequest]
+     * @return uint32 status : the HTTP status code
+     * @return string body : the response body
+     * @return table headers : the response headers
+     */
+    int AwaitHttp(lua_State* L)
+    {
+        uint64 handle = Eluna::GEluna->coroutines.Suspend(L);
+
+        // Nothing with a destructor can live across lua_yield
+        bool queued;
         {
-            body = Eluna::CHECKVAL<std::string>(L, 3);
-            bodyContentType = Eluna::CHECKVAL<std::string>(L, 4);
-            headersIdx = 5;
-            callbackIdx = 5;
+            std::string httpVerb;
+            std::string url;
+            std::string body;
+            std::string bodyContentType;
+            httplib::Headers headers;
+            int optionsIdx = ReadHttpRequest(L, httpVerb, url, body, bodyContentType, headers);
+
+            HttpResponseOptions options;
+            ReadHttpResponseOptions(L, optionsIdx, options);
+            options.chunkSize = 0;
+
+            HttpWorkItem* item = new HttpWorkItem(LUA_NOREF, httpVerb, url, body, bodyContentType, headers, options);
+            item->task = handle;
+            queued = Eluna::GEluna->httpManager.PushRequest(item);
         }
 
-        if (lua_istable(L, headersIdx))
+        if (!queued)
+            return 0;
+        return lua_yield(L, 0);
+    }
+
+    /**
+     * Calls a module function in a Lua state on a worker thread, and calls the callback with its results on a later world update.
+     *
+     * The function is found by loading the module with `require` in the worker state, from the same folders as the scripts.
+     * Worker states only have the standard Lua libraries and [Global:GetSharedDictionary], so the function can't use the game API,
+     *   it is meant for pure computations like pathing or loot simulations that would stall the world update.
+     * The arguments and the results are copied between the states, tables are copied deeply and userdata is not supported.
+     * Modules stay loaded in the workers until Eluna is reloaded.
+     *
+     * The callback receives true followed by the function's results, or false and the error message if the call failed.
+     *
+     *     -- lua_scripts/lib/simulate.lua: return { Loot = function(entry, rolls) ... return drops end }
+     *     RunAsync("lib.simulate.Loot", { 1234, 10000 }, function(ok, drops)
+     *         if not ok then
+     *             print(drops)
+     *         end
+     *     end)
+     *
+     * @proto (functionName, callback)
+     * @proto (functionName, arguments, callback)
+     * @param string functionName : the module name and the function name separated by the last dot
+     * @param table arguments : the arguments to call the function with, in order. Set `n` to pass trailing nils
+     * @param function callback : function called with the results
+     */
+    int RunAsync(lua_State* L)
+    {
+        size_t nameLength;
+        const char* name = luaL_checklstring(L, 1, &nameLength);
+        int callbackIdx = lua_isfunction(L, 2) ? 2 : 3;
+        if (callbackIdx == 3 && !lua_isnoneornil(L, 2))
+            luaL_checktype(L, 2, LUA_TTABLE);
+        luaL_checktype(L, callbackIdx, LUA_TFUNCTION);
+
+        size_t dot = std::string_view(name, nameLength).rfind('.');
+        if (dot == std::string_view::npos || dot == 0 || dot == nameLength - 1)
+            return luaL_argerror(L, 1, "expected module.function");
+
+        // Encode the arguments
+        lua_pushcfunction(L, &mar_encode);
+        if (callbackIdx == 3 && lua_istable(L, 2))
+            lua_pushvalue(L, 2);
+        else
+            lua_newtable(L);
+        if (lua_pcall(L, 1, 1, 0) != LUA_OK)
+            return luaL_error(L, "could not copy the arguments: %s", lua_tostring(L, -1));
+
+        lua_pushvalue(L, callbackIdx);
+        int funcRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+        // Nothing with a destructor can live across luaL_error
+        bool queued;
         {
-            ++callbackIdx;
+            size_t argsLength;
+            const char* args = lua_tolstring(L, -1, &argsLength);
+            std::string module(name, dot);
+            std::string function(name + dot + 1, nameLength - dot - 1);
+            queued = Eluna::GEluna->workers.Queue(module, function, std::string(args, argsLength), funcRef);
+        }
 
-            lua_pushnil(L); // First key
-            while (lua_next(L, headersIdx) != 0)
+        if (!queued)
+        {
+            luaL_unref(L, LUA_REGISTRYINDEX, funcRef);
+            return luaL_error(L, "RunAsync is disabled, set Eluna.Workers.Threads above 0");
+        }
+        return 0;
+    }
+
+    /**
+     * Returns the [ElunaSharedDictionary] with the name, creating it if needed.
+     *
+     * Every call with the same name returns the same dictionary, and its values are kept when Eluna is reloaded.
+     * The functions run by [Global:RunAsync] get the same dictionaries and use them without the Eluna lock.
+     *
+     * @param string name
+     * @return [ElunaSharedDictionary] dictionary
+     */
+    int GetSharedDictionary(lua_State* L)
+    {
+        size_t length;
+        const char* name = luaL_checklstring(L, 1, &length);
+
+        Eluna::Push(L, new ElunaSharedDictionary(Eluna::GEluna->sharedDictionaries.Get(std::string(name, length))));
+        return 1;
+    }
+
+    /**
+     * Creates a channel that sends the records queued with [SendToHttpChannel] to the URL in batches.
+     *
+     * Each batch is sent as one POST request from a separate thread when it reaches the record or size limit,
+     *   or when its first record has waited for the flush interval.
+     * Failed batches are retried with an exponential backoff, starting at 1 second and capped at 30 seconds.
+     * Calling this again with the same name changes the channel's URL and options and keeps its buffered records.
+     *
+     * The options table can contain:
+     *
+     * - format : `"ndjson"` to send one record per line (default), or `"json"` to send a JSON array of records
+     * - maxRecords : records per batch, 100 by default
+     * - maxBytes : bytes per batch, 65536 by default
+     * - flushInterval : milliseconds a record can wait for its batch to fill, 1000 by default
+     * - maxRetries : times a failed batch is retried before it is discarded, 5 by default
+     * - maxBuffered : bytes of unsent records kept, further records are dropped, 1048576 by default
+     * - headers : a table with string key-value pairs containing the request headers
+     *
+     *     CreateHttpChannel("kills", "http://127.0.0.1:9000/ingest", { format = "json", flushInterval = 5000 })
+     *
+     *     local function OnKill(event, killer, killed)
+     *         SendToHttpChannel("kills", { killer = killer:GetName(), killed = killed:GetName(), time = os.time() })
+     *     end
+     *
+     * @param string name : name of the channel
+     * @param string url : the URL batches are posted to
+     * @param table options : optional channel options
+     */
+    int CreateHttpChannel(lua_State* L)
+    {
+        std::string name = Eluna::CHECKVAL<std::string>(L, 1);
+        std::string url = Eluna::CHECKVAL<std::string>(L, 2);
+
+        HttpChannelOptions options;
+        if (!lua_isnoneornil(L, 3))
+        {
+            luaL_checktype(L, 3, LUA_TTABLE);
+
+            lua_getfield(L, 3, "format");
+            if (!lua_isnil(L, -1))
             {
-                // Uses 'key' (at index -2) and 'value' (at index -1)
-                if (lua_isstring(L, -2))
+                std::string format = Eluna::CHECKVAL<std::string>(L, -1);
+                if (format == "json")
+                    options.format = HTTP_BATCH_JSON_ARRAY;
+                else if (format != "ndjson")
+                    return luaL_argerror(L, 3, "format must be \"ndjson\" or \"json\"");
+            }
+            lua_pop(L, 1);
+
+            lua_getfield(L, 3, "maxRecords");
+            options.maxRecords = std::max<uint32>(Eluna::CHECKVAL<uint32>(L, -1, options.maxRecords), 1);
+            lua_getfield(L, 3, "maxBytes");
+            options.maxBytes = Eluna::CHECKVAL<uint32>(L, -1, options.maxBytes);
+            lua_getfield(L, 3, "flushInterval");
+            options.flushInterval = Eluna::CHECKVAL<uint32>(L, -1, options.flushInterval);
+            lua_getfield(L, 3, "maxRetries");
+            options.maxRetries = Eluna::CHECKVAL<uint32>(L, -1, options.maxRetries);
+            lua_getfield(L, 3, "maxBuffered");
+            options.maxBuffered = Eluna::CHECKVAL<uint32>(L, -1, options.maxBuffered);
+            lua_pop(L, 5);
+
+            lua_getfield(L, 3, "headers");
+            if (lua_istable(L, -1))
+            {
+                int headersIdx = lua_gettop(L);
+                lua_pushnil(L);
+                while (lua_next(L, headersIdx) != 0)
                 {
-                    std::string key(lua_tostring(L, -2));
-                    std::string value(lua_tostring(L, -1));
-                    headers.insert(std::pair<std::string, std::string>(key, value));
+                    if (lua_isstring(L, -2))
+                        options.headers.insert(std::pair<std::string, std::string>(lua_tostring(L, -2), lua_tostring(L, -1)));
+                    lua_pop(L, 1);
                 }
-                // Removes 'value'; keeps 'key' for next iteration
-                lua_pop(L, 1);
             }
+            lua_pop(L, 1);
         }
 
-        lua_pushvalue(L, callbackIdx);
-        int funcRef = luaL_ref(L, LUA_REGISTRYINDEX);
-        if (funcRef >= 0)
+        std::string host;
+        std::string path;
+        if (!Eluna::GEluna->httpManager.ParseUrl(url, host, path))
+            return luaL_argerror(L, 2, "invalid URL");
+
+        Eluna::GEluna->httpManager.batcher.SetChannel(name, host, path, options);
+        return 0;
+    }
+
+    /**
+     * Queues a record to be sent by the channel created with [CreateHttpChannel].
+     *
+     * Tables are encoded as JSON, strings are sent as they are and should be valid JSON for `"json"` channels.
+     * Returns false if the channel doesn't exist or its buffer is full.
+     *
+     * @param string name : name of the channel
+     * @param string record : the record as a string or a table
+     * @return bool queued
+     */
+    int SendToHttpChannel(lua_State* L)
+    {
+        std::string name = Eluna::CHECKVAL<std::string>(L, 1);
+
+        bool queued;
+        if (lua_istable(L, 2))
         {
-            Eluna::GEluna->httpManager.PushRequest(new HttpWorkItem(funcRef, httpVerb, url, body, bodyContentType, headers));
+            std::string record;
+            std::string error;
+            if (!LuaJson::Encode(L, 2, record, LuaJson::EncodeOptions(), error))
+                return luaL_argerror(L, 2, error.c_str());
+            queued = Eluna::GEluna->httpManager.batcher.Queue(name, record.data(), record.size());
         }
         else
         {
-            luaL_argerror(L, callbackIdx, "unable to make a ref to function");
+            size_t length;
+            const char* record = luaL_checklstring(L, 2, &length);
+            queued = Eluna::GEluna->httpManager.batcher.Queue(name, record, length);
         }
 
-        return 0;
+        Eluna::Push(L, queued);
+        return 1;
+    }
+
+    /**
+     * Returns the statistics of a channel created with [CreateHttpChannel], or nil if it doesn't exist.
+     *
+     * The returned table has the fields:
+     *
+     * - sent : records delivered
+     * - failed : records discarded after their batch failed too many times or was rejected with a 4xx status
+     * - dropped : records rejected because the buffer was full
+     * - buffered : bytes of records waiting to be sent
+     *
+     * @param string name : name of the channel
+     * @return table stats
+     */
+    int GetHttpChannelStats(lua_State* L)
+    {
+        std::string name = Eluna::CHECKVAL<std::string>(L, 1);
+
+        HttpChannelStats stats;
+        if (!Eluna::GEluna->httpManager.batcher.GetStats(name, stats))
+            return 1;
+
+        lua_createtable(L, 0, 4);
+        Eluna::Push(L, static_cast<double>(stats.sent));
+        lua_setfield(L, -2, "sent");
+        Eluna::Push(L, static_cast<double>(stats.failed));
+        lua_setfield(L, -2, "failed");
+        Eluna::Push(L, static_cast<double>(stats.dropped));
+        lua_setfield(L, -2, "dropped");
+        Eluna::Push(L, static_cast<double>(stats.buffered));
+        lua_setfield(L, -2, "buffered");
+        return 1;
     }
 
     /**
@@ -19,9 +19,12 @@ template<typename K1, typename K2>
 int Eluna::SetupStack(BindingMap<K1>* bindings1, BindingMap<K2>* bindings2, const K1& key1, const K2& key2, int number_of_arguments)
 {
     ASSERT(number_of_arguments == this->push_counter);
-    ASSERT(key1.event_id == key2.event_id);
+    // The keys may use different event enums sharing the same IDs (server and packet events)
+    ASSERT(static_cast<int>(key1.event_id) == static_cast<int>(key2.event_id));
     // Stack: [arguments]
 
+    metrics.BeginHook(ElunaMetrics::GetHookType(key1.event_id));
+
     Push(key1.event_id);
     this->push_counter = 0;
     ++number_of_arguments;
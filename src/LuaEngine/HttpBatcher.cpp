@@ -0,0 +1,374 @@
+#if defined TRINITY || defined AZEROTHCORE
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#endif
+#include "libs/httplib.h"
+#include "HttpBatcher.h"
+#include "LuaEngine.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // Retries wait 1s, 2s, 4s... up to this
+    const uint32_t MAX_RETRY_DELAY = 30000;
+}
+
+HttpBatcher::HttpBatcher()
+    : started(false),
+    stopping(false),
+    connectTimeout(3000),
+    readTimeout(5000),
+    writeTimeout(5000)
+{
+}
+
+HttpBatcher::~HttpBatcher()
+{
+    Stop();
+}
+
+void HttpBatcher::Start(uint32_t connect, uint32_t read, uint32_t write)
+{
+    std::lock_guard<std::mutex> lock(channelsLock);
+    if (started)
+    {
+        return;
+    }
+
+    connectTimeout = connect;
+    readTimeout = read;
+    writeTimeout = write;
+    stopping = false;
+    started = true;
+    senderThread = std::thread(&HttpBatcher::SenderThread, this);
+}
+
+void HttpBatcher::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(channelsLock);
+        if (!started)
+        {
+            return;
+        }
+        stopping = true;
+    }
+
+    wakeUp.notify_all();
+    senderThread.join();
+
+    std::lock_guard<std::mutex> lock(channelsLock);
+    channels.clear();
+    started = false;
+}
+
+void HttpBatcher::SetChannel(const std::string& name, const std::string& host, const std::string& path, HttpChannelOptions const& options)
+{
+    std::lock_guard<std::mutex> lock(channelsLock);
+
+    std::shared_ptr<Channel>& channel = channels[name];
+    if (!channel)
+    {
+        channel = std::make_shared<Channel>();
+    }
+    // Records already in the batch being filled stay in the old format
+    else if (channel->options.format != options.format)
+    {
+        Seal(*channel);
+    }
+
+    channel->host = host;
+    channel->path = path;
+    channel->options = options;
+}
+
+bool HttpBatcher::Queue(const std::string& name, const char* record, size_t length)
+{
+    bool sealed = false;
+    {
+        std::lock_guard<std::mutex> lock(channelsLock);
+
+        auto itr = channels.find(name);
+        if (itr == channels.end())
+        {
+            return false;
+        }
+
+        Channel& channel = *itr->second;
+        if (channel.stats.buffered + length + 1 > channel.options.maxBuffered)
+        {
+            ++channel.stats.dropped;
+            return false;
+        }
+
+        size_t before = channel.body.size();
+        if (!channel.records)
+        {
+            channel.firstRecord = Clock::now();
+            if (channel.options.format == HTTP_BATCH_JSON_ARRAY)
+            {
+                channel.body.push_back('[');
+            }
+        }
+        else if (channel.options.format == HTTP_BATCH_JSON_ARRAY)
+        {
+            channel.body.push_back(',');
+        }
+
+        channel.body.append(record, length);
+        if (channel.options.format == HTTP_BATCH_NDJSON)
+        {
+            channel.body.push_back('\n');
+        }
+        channel.stats.buffered += channel.body.size() - before;
+        ++channel.records;
+
+        if (channel.records >= channel.options.maxRecords || channel.body.size() >= channel.options.maxBytes)
+        {
+            Seal(channel);
+            sealed = true;
+        }
+    }
+
+    if (sealed)
+    {
+        wakeUp.notify_one();
+    }
+    return true;
+}
+
+bool HttpBatcher::GetStats(const std::string& name, HttpChannelStats& stats)
+{
+    std::lock_guard<std::mutex> lock(channelsLock);
+
+    auto itr = channels.find(name);
+    if (itr == channels.end())
+    {
+        return false;
+    }
+
+    stats = itr->second->stats;
+    return true;
+}
+
+void HttpBatcher::Seal(Channel& channel)
+{
+    if (!channel.records)
+    {
+        return;
+    }
+
+    if (channel.options.format == HTTP_BATCH_JSON_ARRAY)
+    {
+        channel.body.push_back(']');
+        ++channel.stats.buffered;
+    }
+
+    Batch batch;
+    batch.body.swap(channel.body);
+    batch.records = channel.records;
+    batch.attempts = 0;
+    batch.retryAt = Clock::now();
+    channel.sealed.push_back(std::move(batch));
+    channel.records = 0;
+}
+
+std::shared_ptr<HttpBatcher::Channel> HttpBatcher::NextReady(Clock::time_point now, Clock::time_point& wake, bool flushAll)
+{
+    std::shared_ptr<Channel> ready;
+
+    // Start after the channel served last so a busy or retrying channel can't starve the ones after it
+    ChannelMap::iterator itr = channels.upper_bound(lastServed);
+    for (size_t i = 0; i < channels.size(); ++i, ++itr)
+    {
+        if (itr == channels.end())
+        {
+            itr = channels.begin();
+        }
+        Channel& channel = *itr->second;
+
+        if (channel.records)
+        {
+            Clock::time_point due = channel.firstRecord + std::chrono::milliseconds(channel.options.flushInterval);
+            if (flushAll || due <= now)
+            {
+                Seal(channel);
+            }
+            else
+            {
+                wake = std::min(wake, due);
+            }
+        }
+
+        if (channel.sealed.empty() || channel.sending)
+        {
+            continue;
+        }
+
+        Clock::time_point retryAt = channel.sealed.front().retryAt;
+        if (!flushAll && retryAt > now)
+        {
+            wake = std::min(wake, retryAt);
+        }
+        else if (!ready)
+        {
+            ready = itr->second;
+            lastServed = itr->first;
+        }
+    }
+    return ready;
+}
+
+void HttpBatcher::SenderThread()
+{
+    std::unique_lock<std::mutex> lock(channelsLock);
+
+    while (!stopping)
+    {
+        Clock::time_point now = Clock::now();
+        Clock::time_point wake = now + std::chrono::seconds(1);
+
+        std::shared_ptr<Channel> channel = NextReady(now, wake, false);
+        if (!channel)
+        {
+            wakeUp.wait_until(lock, wake);
+            continue;
+        }
+
+        // Send without the lock so scripts can keep queuing records.
+        // Only this thread removes batches, so the reference stays valid.
+        channel->sending = true;
+        Batch const& batch = channel->sealed.front();
+        std::string host = channel->host;
+        std::string path = channel->path;
+        HttpChannelOptions options = channel->options;
+        lock.unlock();
+        SendResult result = Send(*channel, host, path, options, batch.body);
+        lock.lock();
+        channel->sending = false;
+
+        Batch& front = channel->sealed.front();
+        if (result != SEND_RETRY || ++front.attempts > channel->options.maxRetries)
+        {
+            if (result == SEND_DELIVERED)
+            {
+                channel->stats.sent += front.records;
+            }
+            else
+            {
+                channel->stats.failed += front.records;
+            }
+            channel->stats.buffered -= std::min<uint64_t>(channel->stats.buffered, front.body.size());
+            channel->sealed.pop_front();
+        }
+        else
+        {
+            uint32_t delay = std::min<uint32_t>(1000u << std::min<uint32_t>(front.attempts - 1, 5), MAX_RETRY_DELAY);
+            front.retryAt = Clock::now() + std::chrono::milliseconds(delay);
+        }
+    }
+
+    // Give everything buffered one try, skipping the rest of a channel once a batch fails.
+    // The batches are taken out so scripts queuing records meanwhile don't wait for the requests.
+    struct Flush
+    {
+        std::shared_ptr<Channel> channel;
+        std::string host;
+        std::string path;
+        HttpChannelOptions options;
+        std::deque<Batch> batches;
+    };
+
+    Clock::time_point wake = Clock::now();
+    NextReady(wake, wake, true);
+    std::vector<Flush> flushes;
+    for (auto& itr : channels)
+    {
+        Channel& channel = *itr.second;
+        if (channel.sealed.empty())
+        {
+            continue;
+        }
+
+        Flush flush;
+        flush.channel = itr.second;
+        flush.host = channel.host;
+        flush.path = channel.path;
+        flush.options = channel.options;
+        flush.batches.swap(channel.sealed);
+        flushes.push_back(std::move(flush));
+    }
+    lock.unlock();
+
+    for (Flush& flush : flushes)
+    {
+        uint64_t sent = 0;
+        uint64_t failed = 0;
+        uint64_t bytes = 0;
+        for (Batch const& batch : flush.batches)
+        {
+            SendResult result = Send(*flush.channel, flush.host, flush.path, flush.options, batch.body);
+            if (result == SEND_RETRY)
+            {
+                break;
+            }
+
+            if (result == SEND_DELIVERED)
+            {
+                sent += batch.records;
+            }
+            else
+            {
+                failed += batch.records;
+            }
+            bytes += batch.body.size();
+        }
+
+        lock.lock();
+        flush.channel->stats.sent += sent;
+        flush.channel->stats.failed += failed;
+        flush.channel->stats.buffered -= std::min<uint64_t>(flush.channel->stats.buffered, bytes);
+        lock.unlock();
+    }
+}
+
+HttpBatcher::SendResult HttpBatcher::Send(Channel& channel, const std::string& host, const std::string& path, HttpChannelOptions const& options, const std::string& body)
+{
+    try
+    {
+        if (!channel.client || channel.clientHost != host)
+        {
+            channel.client.reset(new httplib::Client(host));
+            channel.clientHost = host;
+            channel.client->set_connection_timeout(connectTimeout / 1000, (connectTimeout % 1000) * 1000);
+            channel.client->set_read_timeout(readTimeout / 1000, (readTimeout % 1000) * 1000);
+            channel.client->set_write_timeout(writeTimeout / 1000, (writeTimeout % 1000) * 1000);
+            channel.client->set_keep_alive(true);
+            channel.client->set_tcp_nodelay(true);
+        }
+
+        const char* contentType = options.format == HTTP_BATCH_JSON_ARRAY ? "application/json" : "application/x-ndjson";
+        httplib::Result res = channel.client->Post(path.c_str(), options.headers, body, contentType);
+        if (res.error() != httplib::Error::Success)
+        {
+            ELUNA_LOG_ERROR("[Eluna]: HTTP channel request error: {}", httplib::to_string(res.error()));
+            channel.client.reset();
+            return SEND_RETRY;
+        }
+
+        // Client errors won't get better by retrying
+        if (res->status >= 400 && res->status < 500 && res->status != 408 && res->status != 429)
+        {
+            ELUNA_LOG_ERROR("[Eluna]: HTTP channel request to {}{} rejected with status {}", host, path, res->status);
+            return SEND_REJECTED;
+        }
+        return res->status < 400 ? SEND_DELIVERED : SEND_RETRY;
+    }
+    catch (const std::exception& ex)
+    {
+        ELUNA_LOG_ERROR("[Eluna]: HTTP channel request error: {}", ex.what());
+        channel.client.reset();
+        return SEND_RETRY;
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef ELUNA_HTTP_BATCHER_H
+#define ELUNA_HTTP_BATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "libs/httplib.h"
+
+enum HttpBatchFormat
+{
+    HTTP_BATCH_NDJSON,     // one record per line
+    HTTP_BATCH_JSON_ARRAY  // records as the elements of a JSON array
+};
+
+struct HttpChannelOptions
+{
+    HttpChannelOptions() : format(HTTP_BATCH_NDJSON), maxRecords(100), maxBytes(64 * 1024), flushInterval(1000), maxRetries(5), maxBuffered(1024 * 1024) { }
+
+    HttpBatchFormat format;
+    // A batch is sent when it has this many records or bytes
+    uint32_t maxRecords;
+    uint32_t maxBytes;
+    // or when its first record is this many milliseconds old
+    uint32_t flushInterval;
+    // Failed batches are retried with an exponential backoff this many times
+    uint32_t maxRetries;
+    // Bytes of unsent records kept per channel, further records are dropped
+    uint32_t maxBuffered;
+    httplib::Headers headers;
+};
+
+struct HttpChannelStats
+{
+    HttpChannelStats() : sent(0), failed(0), dropped(0), buffered(0) { }
+
+    // Records delivered
+    uint64_t sent;
+    // Records discarded after failing to send or being rejected by the server
+    uint64_t failed;
+    // Records rejected because the buffer was full
+    uint64_t dropped;
+    // Bytes of records waiting to be sent
+    uint64_t buffered;
+};
+
+/*
+ * Collects records queued to named channels into batches
+ *   and posts each batch as one request from its own thread.
+ */
+class HttpBatcher
+{
+public:
+    HttpBatcher();
+    ~HttpBatcher();
+
+    void Start(uint32_t connectTimeout, uint32_t readTimeout, uint32_t writeTimeout);
+    // Sends what is buffered once more before returning
+    void Stop();
+
+    // Creates the channel or updates its target and options, keeping the buffered records.
+    // host is scheme://host:port
+    void SetChannel(const std::string& name, const std::string& host, const std::string& path, HttpChannelOptions const& options);
+    // Can be called from any thread, returns false if the record was dropped
+    bool Queue(const std::string& name, const char* record, size_t length);
+    bool GetStats(const std::string& name, HttpChannelStats& stats);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Batch
+    {
+        std::string body;
+        uint32_t records;
+        uint32_t attempts;
+        Clock::time_point retryAt;
+    };
+
+    struct Channel
+    {
+        Channel() : records(0), sending(false) { }
+
+        std::string host;
+        std::string path;
+        HttpChannelOptions options;
+
+        // Batch being filled
+        std::string body;
+        uint32_t records;
+        Clock::time_point firstRecord;
+
+        // Full batches, sent in order
+        std::deque<Batch> sealed;
+        bool sending;
+        HttpChannelStats stats;
+
+        // Only used by the sender thread
+        std::unique_ptr<httplib::Client> client;
+        std::string clientHost;
+    };
+
+    typedef std::map< std::string, std::shared_ptr<Channel> > ChannelMap;
+
+    enum SendResult
+    {
+        SEND_DELIVERED,
+        SEND_RETRY,
+        // The server refused the batch, sending it again won't help
+        SEND_REJECTED
+    };
+
+    void SenderThread();
+    void Seal(Channel& channel);
+    // Called without the lock, the target is copied from the channel by the caller
+    SendResult Send(Channel& channel, const std::string& host, const std::string& path, HttpChannelOptions const& options, const std::string& body);
+    // Seals the due batches and returns the next channel with a batch to send, taking turns between the channels
+    std::shared_ptr<Channel> NextReady(Clock::time_point now, Clock::time_point& wakeUp, bool flushAll);
+
+    ChannelMap channels;
+    // Name of the channel NextReady returned last
+    std::string lastServed;
+    std::mutex channelsLock;
+    std::condition_variable wakeUp;
+    std::thread senderThread;
+    bool started;
+    bool stopping;
+
+    uint32_t connectTimeout;
+    uint32_t readTimeout;
+    uint32_t writeTimeout;
+};
+
+#endif // #ifndef ELUNA_HTTP_BATCHER_H
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <iterator>
+#include <memory>
 #include <thread>
 extern "C"
 {
@@ -11,32 +14,129 @@ extern "C"
 #include "libs/httplib.h"
 #include "HttpManager.h"
 #include "LuaEngine.h"
+#include "LuaJson.h"
 
-HttpWorkItem::HttpWorkItem(int funcRef, const std::string& httpVerb, const std::string& url, const std::string& body, const std::string& contentType, const httplib::Headers& headers)
+namespace
+{
+    const char* const HEADERS_METATABLE = "Eluna.HttpHeaders";
+
+    int HeadersIndex(lua_State* L)
+    {
+        httplib::Headers* headers = static_cast<httplib::Headers*>(luaL_checkudata(L, 1, HEADERS_METATABLE));
+        const char* name = luaL_checkstring(L, 2);
+
+        auto itr = headers->find(name);
+        if (itr == headers->end())
+            return 0;
+        lua_pushlstring(L, itr->second.data(), itr->second.size());
+        return 1;
+    }
+
+    int HeadersNext(lua_State* L)
+    {
+        httplib::Headers* headers = static_cast<httplib::Headers*>(lua_touserdata(L, lua_upvalueindex(1)));
+        lua_Integer position = lua_tointeger(L, lua_upvalueindex(2));
+        if (position < 0 || static_cast<size_t>(position) >= headers->size())
+            return 0;
+
+        auto itr = std::next(headers->begin(), position);
+        lua_pushinteger(L, position + 1);
+        lua_replace(L, lua_upvalueindex(2));
+        lua_pushlstring(L, itr->first.data(), itr->first.size());
+        lua_pushlstring(L, itr->second.data(), itr->second.size());
+        return 2;
+    }
+
+    int HeadersPairs(lua_State* L)
+    {
+        luaL_checkudata(L, 1, HEADERS_METATABLE);
+        lua_pushvalue(L, 1);
+        lua_pushinteger(L, 0);
+        lua_pushcclosure(L, &HeadersNext, 2);
+        return 1;
+    }
+
+    int HeadersGC(lua_State* L)
+    {
+        httplib::Headers* headers = static_cast<httplib::Headers*>(luaL_checkudata(L, 1, HEADERS_METATABLE));
+        std::destroy_at(headers);
+        return 0;
+    }
+
+    // Pushes a userdata owning the headers, indexing it looks a header up by its case insensitive name
+    void PushLazyHeaders(lua_State* L, httplib::Headers&& headers)
+    {
+        void* memory = lua_newuserdata(L, sizeof(httplib::Headers));
+        new (memory) httplib::Headers(std::move(headers));
+
+        if (luaL_newmetatable(L, HEADERS_METATABLE))
+        {
+            lua_pushcfunction(L, &HeadersIndex);
+            lua_setfield(L, -2, "__index");
+            lua_pushcfunction(L, &HeadersPairs);
+            lua_setfield(L, -2, "__pairs");
+            lua_pushcfunction(L, &HeadersGC);
+            lua_setfield(L, -2, "__gc");
+        }
+        lua_setmetatable(L, -2);
+    }
+
+    void PushHeaders(lua_State* L, httplib::Headers const& headers)
+    {
+        lua_createtable(L, 0, headers.size());
+        for (const auto& item : headers)
+        {
+            lua_pushlstring(L, item.first.data(), item.first.size());
+            lua_pushlstring(L, item.second.data(), item.second.size());
+            lua_settable(L, -3);
+        }
+    }
+}
+
+HttpWorkItem::HttpWorkItem(int funcRef, const std::string& httpVerb, const std::string& url, const std::string& body, const std::string& contentType, const httplib::Headers& headers, HttpResponseOptions const& options)
     : funcRef(funcRef),
+    task(0),
     httpVerb(httpVerb),
     url(url),
     body(body),
     contentType(contentType),
-    headers(headers)
+    headers(headers),
+    options(options)
 { }
 
-HttpResponse::HttpResponse(int funcRef, int statusCode, const std::string& body, const httplib::Headers& headers)
+HttpResponse::HttpResponse(int funcRef, int statusCode, std::string body, httplib::Headers headers, HttpResponseOptions const& options)
     : funcRef(funcRef),
+    task(0),
     statusCode(statusCode),
-    body(body),
-    headers(headers)
+    body(std::move(body)),
+    headers(std::move(headers)),
+    options(options),
+    delivered(0)
 { }
 
 HttpManager::HttpManager()
-    : workQueue(16),
-    responseQueue(16),
-    startedWorkerThread(false),
+    : startedWorkerThread(false),
     cancelationToken(false),
     condVar(),
     condVarMutex(),
-    parseUrlRegex("^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\\?([^#]*))?(#(.*))?")
+    queuedRequests(0),
+    inFlightRequests(0),
+    droppedRequests(0),
+    rejectedRequests(0),
+    pendingResponses(0),
+    parseUrlRegex("^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\\?([^#]*))?(#(.*))?"),
+    workerCount(2),
+    maxConnectionsPerHost(1),
+    connectTimeout(3000),
+    readTimeout(5000),
+    writeTimeout(5000),
+    keepAliveTimeout(30000),
+    queueSize(256),
+    queuePolicy(HTTP_QUEUE_REJECT),
+    responseBudget(5),
+    responsesPerUpdate(100)
 {
+    LoadConfig();
     StartHttpWorker();
 }
 
@@ -45,11 +145,111 @@ HttpManager::~HttpManager()
     StopHttpWorker();
 }
 
-void HttpManager::PushRequest(HttpWorkItem* item)
+bool HttpManager::PushRequest(HttpWorkItem* item)
 {
-    std::unique_lock<std::mutex> lock(condVarMutex);
-    workQueue.push(item);
+    std::lock_guard<std::mutex> lock(condVarMutex);
+
+    // Requests waiting for a busy host count too, so the limit holds however the workers are doing
+    if (queuedRequests >= queueSize)
+    {
+        switch (queuePolicy)
+        {
+            case HTTP_QUEUE_DROP:
+            {
+                // Make room by discarding the oldest request no worker has taken yet
+                if (workQueue.empty())
+                {
+                    ++droppedRequests;
+                    DeleteRequest(item);
+                    return false;
+                }
+                HttpWorkItem* oldest = workQueue.front();
+                workQueue.pop_front();
+                --queuedRequests;
+                ++droppedRequests;
+                DeleteRequest(oldest);
+                break;
+            }
+            default:
+                ++rejectedRequests;
+                DeleteRequest(item);
+                return false;
+        }
+    }
+
+    workQueue.push_back(item);
+    ++queuedRequests;
     condVar.notify_one();
+    return true;
+}
+
+void HttpManager::DeleteRequest(HttpWorkItem* item)
+{
+    // The caller holds the Eluna lock
+    luaL_unref(Eluna::GEluna->L, LUA_REGISTRYINDEX, item->funcRef);
+    if (item->task)
+    {
+        // Resumed without a response in the next update
+        Eluna::GEluna->coroutines.Sleep(item->task, 0);
+    }
+    delete item;
+}
+
+void HttpManager::QueueFailure(HttpWorkItem* req)
+{
+    // Callbacks are only called with a response, but a task would wait forever
+    if (!req->task)
+    {
+        return;
+    }
+
+    HttpResponse* response = new HttpResponse(req->funcRef, 0, std::string(), httplib::Headers(), req->options);
+    response->task = req->task;
+    std::lock_guard<std::mutex> lock(responseMutex);
+    responseQueue.push_back(response);
+    ++pendingResponses;
+}
+
+void HttpManager::ReleaseQueueSlot()
+{
+    --queuedRequests;
+}
+
+HttpStats HttpManager::GetStats() const
+{
+    HttpStats stats;
+    stats.queued = queuedRequests.load();
+    stats.inFlight = inFlightRequests.load();
+    stats.dropped = droppedRequests.load();
+    stats.rejected = rejectedRequests.load();
+    stats.responses = pendingResponses.load();
+    return stats;
+}
+
+static uint32_t GetConfigValue(const char* name, uint32_t defaultValue)
+{
+#if defined(AZEROTHCORE)
+    return eConfigMgr->GetOption<uint32>(name, defaultValue);
+#else
+    return eConfigMgr->GetIntDefault(name, defaultValue);
+#endif
+}
+
+void HttpManager::LoadConfig()
+{
+    workerCount = std::max<uint32_t>(GetConfigValue("Eluna.Http.Workers", 2), 1);
+    // One worker is always left for the other hosts unless configured otherwise
+    maxConnectionsPerHost = GetConfigValue("Eluna.Http.MaxConnectionsPerHost", 0);
+    if (!maxConnectionsPerHost)
+        maxConnectionsPerHost = std::max<uint32_t>(workerCount - 1, 1);
+    connectTimeout = GetConfigValue("Eluna.Http.ConnectTimeout", 3000);
+    readTimeout = GetConfigValue("Eluna.Http.ReadTimeout", 5000);
+    writeTimeout = GetConfigValue("Eluna.Http.WriteTimeout", 5000);
+    keepAliveTimeout = GetConfigValue("Eluna.Http.KeepAliveTimeout", 30000);
+    queueSize = std::max<uint32_t>(GetConfigValue("Eluna.Http.QueueSize", 256), 2);
+    queuePolicy = static_cast<HttpQueuePolicy>(std::min<uint32_t>(GetConfigValue("Eluna.Http.QueuePolicy", HTTP_QUEUE_REJECT), HTTP_QUEUE_DROP));
+    responseBudget = GetConfigValue("Eluna.Http.ResponseBudget", 5);
+    responsesPerUpdate = GetConfigValue("Eluna.Http.ResponsesPerUpdate", 100);
 }
 
 void HttpManager::StartHttpWorker()
@@ -59,32 +259,43 @@ void HttpManager::StartHttpWorker()
     if (!startedWorkerThread)
     {
         cancelationToken.store(false);
-        workerThread = std::thread(&HttpManager::HttpWorkerThread, this);
+        for (uint32_t i = 0; i < workerCount; ++i)
+            workerThreads.emplace_back(&HttpManager::HttpWorkerThread, this);
+        batcher.Start(connectTimeout, readTimeout, writeTimeout);
         startedWorkerThread = true;
     }
 }
 
 void HttpManager::ClearQueues()
 {
-    while (workQueue.front())
+    for (HttpWorkItem* item : workQueue)
     {
-        HttpWorkItem* item = *workQueue.front();
-        if (item != nullptr)
-        {
-            delete item;
-        }
-        workQueue.pop();
+        delete item;
     }
+    workQueue.clear();
 
-    while (responseQueue.front())
     {
-        HttpResponse* item = *responseQueue.front();
-        if (item != nullptr)
+        // Workers count their responses in under this lock
+        std::lock_guard<std::mutex> lock(responseMutex);
+        for (HttpResponse* res : responseQueue)
         {
-            delete item;
+            delete res;
         }
-        responseQueue.pop();
+        responseQueue.clear();
+        for (HttpResponse* res : deliveryQueue)
+        {
+            delete res;
+        }
+        deliveryQueue.clear();
+        pendingResponses = 0;
     }
+
+    std::lock_guard<std::mutex> lock(hostsMutex);
+    for (auto& host : hosts)
+        for (HttpWorkItem* pending : host.second.pending)
+            delete pending;
+    hosts.clear();
+    queuedRequests = 0;
 }
 
 void HttpManager::StopHttpWorker()
@@ -94,9 +305,15 @@ void HttpManager::StopHttpWorker()
         return;
     }
 
-    cancelationToken.store(true);
-    condVar.notify_one();
-    workerThread.join();
+    {
+        std::lock_guard<std::mutex> lock(condVarMutex);
+        cancelationToken.store(true);
+    }
+    condVar.notify_all();
+    for (std::thread& thread : workerThreads)
+        thread.join();
+    workerThreads.clear();
+    batcher.Stop();
     ClearQueues();
     startedWorkerThread = false;
 }
@@ -105,77 +322,225 @@ void HttpManager::HttpWorkerThread()
 {
     while (true)
     {
+        HttpWorkItem* req = nullptr;
         {
             std::unique_lock<std::mutex> lock(condVarMutex);
-            condVar.wait(lock, [&] { return workQueue.front() != nullptr || cancelationToken.load(); });
-        }
+            condVar.wait(lock, [&] { return !workQueue.empty() || cancelationToken.load(); });
 
-        if (cancelationToken.load())
-        {
-            break;
+            // The requests left in the queue are deleted by ClearQueues
+            if (cancelationToken.load())
+            {
+                break;
+            }
+
+            req = workQueue.front();
+            workQueue.pop_front();
         }
-        if (!workQueue.front())
+
+        std::string host;
+        std::string path;
+        if (!ParseUrl(req->url, host, path))
         {
+            ELUNA_LOG_ERROR("[Eluna]: Could not parse URL {}", req->url);
+            ReleaseQueueSlot();
+            QueueFailure(req);
+            delete req;
             continue;
         }
 
-        HttpWorkItem* req = *workQueue.front();
-        workQueue.pop();
-        if (!req)
+        // The host is busy, a worker finishing one of its requests picks this up
+        if (!BeginRequest(host, req))
         {
             continue;
         }
 
-        try
+        while (req)
         {
-            std::string host;
-            std::string path;
+            ReleaseQueueSlot();
+            ++inFlightRequests;
+            if (!ProcessRequest(req, host, path))
+            {
+                QueueFailure(req);
+            }
+            --inFlightRequests;
+            delete req;
+
+            if (cancelationToken.load())
+            {
+                break;
+            }
 
-            if (!ParseUrl(req->url, host, path)) {
-                ELUNA_LOG_ERROR("[Eluna]: Could not parse URL {}", req->url);
-                continue;
+            // Queued requests were parsed before, only the path differs
+            req = EndRequest(host);
+            if (req)
+            {
+                ParseUrl(req->url, host, path);
             }
+        }
+    }
+}
+
+bool HttpManager::ProcessRequest(HttpWorkItem* req, const std::string& host, const std::string& path)
+{
+    try
+    {
+        std::unique_ptr<httplib::Client> cli = AcquireClient(host);
+        httplib::Result res = DoRequest(*cli, req, path);
+        httplib::Error err = res.error();
+        if (err != httplib::Error::Success)
+        {
+            // The connection is dropped with the client
+            ELUNA_LOG_ERROR("[Eluna]: HTTP request error: {}", httplib::to_string(err));
+            return false;
+        }
+        ReleaseClient(host, std::move(cli));
 
-            httplib::Client cli(host);
-            cli.set_connection_timeout(0, 3000000); // 3 seconds
-            cli.set_read_timeout(5, 0); // 5 seconds
-            cli.set_write_timeout(5, 0); // 5 seconds
+        if (res->status == 301)
+        {
+            std::string location = res->get_header_value("Location");
+            std::string redirectHost;
+            std::string redirectPath;
 
-            httplib::Result res = DoRequest(cli, req, path);
-            httplib::Error err = res.error();
+            if (!ParseUrl(location, redirectHost, redirectPath))
+            {
+                ELUNA_LOG_ERROR("[Eluna]: Could not parse URL after redirect: {}", location);
+                return false;
+            }
+
+            std::unique_ptr<httplib::Client> cli2 = AcquireClient(redirectHost);
+            res = DoRequest(*cli2, req, redirectPath);
+            err = res.error();
             if (err != httplib::Error::Success)
             {
                 ELUNA_LOG_ERROR("[Eluna]: HTTP request error: {}", httplib::to_string(err));
-                continue;
+                return false;
             }
+            ReleaseClient(redirectHost, std::move(cli2));
+        }
 
-            if (res->status == 301)
-            {
-                std::string location = res->get_header_value("Location");
-                std::string host;
-                std::string path;
+        HttpResponse* response = new HttpResponse(req->funcRef, res->status, std::move(res->body), std::move(res->headers), req->options);
+        response->task = req->task;
+        std::lock_guard<std::mutex> lock(responseMutex);
+        responseQueue.push_back(response);
+        ++pendingResponses;
+        return true;
+    }
+    catch (const std::exception& ex)
+    {
+        ELUNA_LOG_ERROR("[Eluna]: HTTP request error: {}", ex.what());
+        return false;
+    }
+}
 
-                if (!ParseUrl(location, host, path))
-                {
-                    ELUNA_LOG_ERROR("[Eluna]: Could not parse URL after redirect: {}", location);
-                    continue;
-                }
-                httplib::Client cli2(host);
-                cli2.set_connection_timeout(0, 3000000); // 3 seconds
-                cli2.set_read_timeout(5, 0); // 5 seconds
-                cli2.set_write_timeout(5, 0); // 5 seconds
-                res = DoRequest(cli2, req, path);
-            }
+bool HttpManager::BeginRequest(const std::string& host, HttpWorkItem* req)
+{
+    std::lock_guard<std::mutex> lock(hostsMutex);
 
-            responseQueue.push(new HttpResponse(req->funcRef, res->status, res->body, res->headers));
-        }
-        catch (const std::exception& ex)
+    HostState& state = hosts[host];
+    if (state.active >= maxConnectionsPerHost)
+    {
+        state.pending.push_back(req);
+        return false;
+    }
+
+    ++state.active;
+    return true;
+}
+
+HttpWorkItem* HttpManager::EndRequest(const std::string& host)
+{
+    std::lock_guard<std::mutex> lock(hostsMutex);
+
+    auto itr = hosts.find(host);
+    if (itr == hosts.end())
+    {
+        return nullptr;
+    }
+
+    HostState& state = itr->second;
+    if (!state.pending.empty())
+    {
+        HttpWorkItem* next = state.pending.front();
+        state.pending.pop_front();
+        return next;
+    }
+
+    if (state.active)
+    {
+        --state.active;
+    }
+    if (!state.active && state.idle.empty())
+    {
+        hosts.erase(itr);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<httplib::Client> HttpManager::AcquireClient(const std::string& host)
+{
+    std::vector<IdleClient> expired;
+    std::unique_ptr<httplib::Client> client;
+    {
+        std::lock_guard<std::mutex> lock(hostsMutex);
+
+        auto itr = hosts.find(host);
+        if (itr != hosts.end())
         {
-            ELUNA_LOG_ERROR("[Eluna]: HTTP request error: {}", ex.what());
+            std::vector<IdleClient>& idle = itr->second.idle;
+            auto now = std::chrono::steady_clock::now();
+
+            // The least recently used clients are first
+            auto firstAlive = idle.begin();
+            while (firstAlive != idle.end() && now - firstAlive->lastUsed > std::chrono::milliseconds(keepAliveTimeout))
+                ++firstAlive;
+            std::move(idle.begin(), firstAlive, std::back_inserter(expired));
+            idle.erase(idle.begin(), firstAlive);
+
+            if (!idle.empty())
+            {
+                client = std::move(idle.back().client);
+                idle.pop_back();
+            }
         }
+    }
 
-        delete req;
+    // Expired connections are closed outside of the lock
+    expired.clear();
+
+    if (client)
+    {
+        return client;
     }
+
+    client.reset(new httplib::Client(host));
+    client->set_connection_timeout(connectTimeout / 1000, (connectTimeout % 1000) * 1000);
+    client->set_read_timeout(readTimeout / 1000, (readTimeout % 1000) * 1000);
+    client->set_write_timeout(writeTimeout / 1000, (writeTimeout % 1000) * 1000);
+    client->set_keep_alive(keepAliveTimeout > 0);
+    client->set_tcp_nodelay(true);
+    return client;
+}
+
+void HttpManager::ReleaseClient(const std::string& host, std::unique_ptr<httplib::Client> client)
+{
+    if (!keepAliveTimeout)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(hostsMutex);
+
+    // Redirect targets are not limited by connection slots, so cap the idle clients too
+    HostState& state = hosts[host];
+    if (state.idle.size() >= maxConnectionsPerHost)
+    {
+        return;
+    }
+
+    IdleClient idle;
+    idle.client = std::move(client);
+    idle.lastUsed = std::chrono::steady_clock::now();
+    state.idle.push_back(std::move(idle));
 }
 
 httplib::Result HttpManager::DoRequest(httplib::Client& client, HttpWorkItem* req, const std::string& urlPath)
@@ -239,38 +604,116 @@ bool HttpManager::ParseUrl(const std::string& url, std::string& host, std::strin
 
 void HttpManager::HandleHttpResponses()
 {
-    while (!responseQueue.empty())
     {
-        HttpResponse* res = *responseQueue.front();
-        responseQueue.pop();
+        std::lock_guard<std::mutex> lock(responseMutex);
+        deliveryQueue.insert(deliveryQueue.end(), responseQueue.begin(), responseQueue.end());
+        responseQueue.clear();
+    }
+
+    if (deliveryQueue.empty())
+    {
+        return;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(responseBudget);
+    uint32_t delivered = 0;
 
-        if (res == nullptr)
+    LOCK_ELUNA;
+    lua_State* L = Eluna::GEluna->L;
+
+    // Always deliver at least one callback so a slow one can't stall the rest forever
+    while (!deliveryQueue.empty())
+    {
+        HttpResponse* res = deliveryQueue.front();
+        if (DeliverResponse(L, res))
         {
-            continue;
+            deliveryQueue.pop_front();
+            luaL_unref(L, LUA_REGISTRYINDEX, res->funcRef);
+            --pendingResponses;
+            delete res;
         }
 
-        LOCK_ELUNA;
+        if (responsesPerUpdate && ++delivered >= responsesPerUpdate)
+        {
+            break;
+        }
+        if (responseBudget && std::chrono::steady_clock::now() >= deadline)
+        {
+            break;
+        }
+    }
+}
 
-        lua_State* L = Eluna::GEluna->L;
+bool HttpManager::DeliverResponse(lua_State* L, HttpResponse* res)
+{
+    HttpResponseOptions const& options = res->options;
+    // Short bodies are one chunk, the callback still gets the last chunk flag
+    bool chunked = !options.json && options.chunkSize;
+    bool firstCall = res->delivered == 0;
+    bool done = true;
+    std::string error;
+
+    // A task awaiting the request is resumed with what a callback would get
+    if (res->task && !res->statusCode)
+    {
+        Eluna::GEluna->coroutines.Resume(L, res->task, 0);
+        return true;
+    }
 
-        // Get function
+    // Get function
+    if (!res->task)
+    {
         lua_rawgeti(L, LUA_REGISTRYINDEX, res->funcRef);
+    }
 
-        // Push parameters
-        Eluna::Push(L, res->statusCode);
-        Eluna::Push(L, res->body);
-        lua_newtable(L);
-        for (const auto& item : res->headers) {
-            Eluna::Push(L, item.first);
-            Eluna::Push(L, item.second);
-            lua_settable(L, -3);
-        }
+    // Push parameters
+    Eluna::Push(L, res->statusCode);
 
-        // Call function
-        Eluna::GEluna->ExecuteCall(3, 0);
+    if (options.json)
+    {
+        if (!LuaJson::Decode(L, res->body.data(), res->body.size(), 0, LuaJson::EncodeOptions().maxDepth, error))
+            lua_pushnil(L);
+    }
+    else if (chunked)
+    {
+        size_t length = std::min<size_t>(options.chunkSize, res->body.size() - res->delivered);
+        lua_pushlstring(L, res->body.data() + res->delivered, length);
+        res->delivered += length;
+        done = res->delivered >= res->body.size();
+    }
+    else
+    {
+        lua_pushlstring(L, res->body.data(), res->body.size());
+    }
 
-        luaL_unref(L, LUA_REGISTRYINDEX, res->funcRef);
+    // Only the first chunk gets the headers
+    if (!firstCall)
+        lua_pushnil(L);
+    else if (options.lazyHeaders)
+        PushLazyHeaders(L, std::move(res->headers));
+    else
+        PushHeaders(L, res->headers);
 
-        delete res;
+    int params = 3;
+    if (chunked)
+    {
+        Eluna::Push(L, done);
+        ++params;
+    }
+    else if (!error.empty())
+    {
+        Eluna::Push(L, error);
+        ++params;
+    }
+
+    // Call function
+    if (res->task)
+    {
+        Eluna::GEluna->coroutines.Resume(L, res->task, params);
+    }
+    else
+    {
+        Eluna::GEluna->ExecuteCall(params, 0);
     }
+    return done;
 }
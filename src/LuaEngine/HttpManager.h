@@ -1,36 +1,85 @@
 #ifndef ELUNA_HTTP_MANAGER_H
 #define ELUNA_HTTP_MANAGER_H
 
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <regex>
+#include <unordered_map>
+#include <vector>
 
 #include "libs/httplib.h"
-#include "libs/rigtorp/SPSCQueue.h"
+#include "ElunaUtility.h"
+#include "HttpBatcher.h"
+
+struct lua_State;
+
+// How the response of a request is passed to its callback
+struct HttpResponseOptions
+{
+    HttpResponseOptions() : lazyHeaders(false), json(false), chunkSize(0) { }
+
+    // Pass the headers as a userdata looked up on access instead of a table
+    bool lazyHeaders;
+    // Pass the body decoded from JSON instead of a string
+    bool json;
+    // Call the callback once per chunk of this many bytes, over several updates
+    uint32_t chunkSize;
+};
 
 struct HttpWorkItem
 {
 public:
-    HttpWorkItem(int funcRef, const std::string& httpVerb, const std::string& url, const std::string& body, const std::string &contentType, const httplib::Headers& headers);
+    HttpWorkItem(int funcRef, const std::string& httpVerb, const std::string& url, const std::string& body, const std::string &contentType, const httplib::Headers& headers, HttpResponseOptions const& options = HttpResponseOptions());
 
     int funcRef;
+    // Handle of the task awaiting the request with AwaitHttp instead of a callback, 0 if none
+    uint64_t task;
     std::string httpVerb;
     std::string url;
     std::string body;
     std::string contentType;
     httplib::Headers headers;
+    HttpResponseOptions options;
 };
 
 struct HttpResponse
 {
 public:
-    HttpResponse(int funcRef, int statusCode, const std::string& body, const httplib::Headers& headers);
+    HttpResponse(int funcRef, int statusCode, std::string body, httplib::Headers headers, HttpResponseOptions const& options);
 
     int funcRef;
+    uint64_t task;
+    // 0 if the request failed, only passed to tasks
     int statusCode;
     std::string body;
     httplib::Headers headers;
+    HttpResponseOptions options;
+    // Bytes of the body already passed in chunks
+    size_t delivered;
 };
 
 
+struct HttpStats
+{
+    // Requests waiting for a worker or for a connection to their host
+    uint64_t queued;
+    uint64_t inFlight;
+    // Requests discarded with HTTP_QUEUE_DROP
+    uint64_t dropped;
+    // Requests refused with HTTP_QUEUE_REJECT
+    uint64_t rejected;
+    // Responses waiting for their callback to be called
+    uint64_t responses;
+};
+
+// What PushRequest does when the request queue is full
+enum HttpQueuePolicy
+{
+    HTTP_QUEUE_REJECT = 0, // refuse the new request
+    HTTP_QUEUE_DROP   = 1  // discard the oldest queued request to make room
+};
+
 class HttpManager
 {
 public:
@@ -39,23 +88,92 @@ public:
 
     void StartHttpWorker();
     void StopHttpWorker();
-    void PushRequest(HttpWorkItem* item);
+    // Can be called from any thread holding the Eluna lock.
+    // Returns false and deletes the item if it was rejected.
+    bool PushRequest(HttpWorkItem* item);
+    // Calls the callbacks of finished requests until the per update budget is spent
     void HandleHttpResponses();
+    HttpStats GetStats() const;
+    bool ParseUrl(const std::string& url, std::string& host, std::string& path);
+
+    // Batched requests of CreateHttpChannel
+    HttpBatcher batcher;
 
 private:
+    struct IdleClient
+    {
+        std::unique_ptr<httplib::Client> client;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    // Requests to one scheme://host:port
+    struct HostState
+    {
+        HostState() : active(0) { }
+
+        uint32_t active;
+        // Requests waiting for one of the host's connection slots
+        std::deque<HttpWorkItem*> pending;
+        // Keep-alive clients not used by any worker, most recently used last
+        std::vector<IdleClient> idle;
+    };
+
+    void LoadConfig();
     void ClearQueues();
+    void DeleteRequest(HttpWorkItem* item);
+    // Lets the task awaiting a request that got no response continue
+    void QueueFailure(HttpWorkItem* req);
+    // Called by workers when a queued request starts executing
+    void ReleaseQueueSlot();
     void HttpWorkerThread();
-    bool ParseUrl(const std::string& url, std::string& host, std::string& path);
+    // Returns true when the response is fully delivered
+    bool DeliverResponse(lua_State* L, HttpResponse* res);
+    // Returns false if no response was queued
+    bool ProcessRequest(HttpWorkItem* req, const std::string& host, const std::string& path);
     httplib::Result DoRequest(httplib::Client& client, HttpWorkItem* req, const std::string& path);
 
-    rigtorp::SPSCQueue<HttpWorkItem*> workQueue;
-    rigtorp::SPSCQueue<HttpResponse*> responseQueue;
-    std::thread workerThread;
+    // Takes a connection slot of the host, or queues the request if all are in use
+    bool BeginRequest(const std::string& host, HttpWorkItem* req);
+    // Releases the connection slot, or returns the host's next queued request for the slot
+    HttpWorkItem* EndRequest(const std::string& host);
+    std::unique_ptr<httplib::Client> AcquireClient(const std::string& host);
+    void ReleaseClient(const std::string& host, std::unique_ptr<httplib::Client> client);
+
+    // Requests no worker has taken yet, guarded by condVarMutex
+    std::deque<HttpWorkItem*> workQueue;
+    // Unbounded so workers never wait for the world thread
+    std::vector<HttpResponse*> responseQueue;
+    std::mutex responseMutex;
+    // Responses taken from responseQueue that didn't fit in the budget, only used by the world thread
+    std::deque<HttpResponse*> deliveryQueue;
+    std::vector<std::thread> workerThreads;
     bool startedWorkerThread;
     std::atomic_bool cancelationToken;
     std::condition_variable condVar;
     std::mutex condVarMutex;
+
+    std::atomic<uint64_t> queuedRequests;
+    std::atomic<uint64_t> inFlightRequests;
+    std::atomic<uint64_t> droppedRequests;
+    std::atomic<uint64_t> rejectedRequests;
+    std::atomic<uint64_t> pendingResponses;
+
+    std::unordered_map<std::string, HostState> hosts;
+    std::mutex hostsMutex;
     std::regex parseUrlRegex;
+
+    // Config, timeouts are in milliseconds
+    uint32_t workerCount;
+    uint32_t maxConnectionsPerHost;
+    uint32_t connectTimeout;
+    uint32_t readTimeout;
+    uint32_t writeTimeout;
+    uint32_t keepAliveTimeout;
+    uint32_t queueSize;
+    HttpQueuePolicy queuePolicy;
+    // Limits of HandleHttpResponses per update, 0 is unlimited
+    uint32_t responseBudget; // milliseconds
+    uint32_t responsesPerUpdate;
 };
 
 #endif // #ifndef ELUNA_HTTP_MANAGER_H
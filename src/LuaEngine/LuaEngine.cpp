@@ -164,7 +164,17 @@ enabled(false),
 L(NULL),
 eventMgr(NULL),
 httpManager(),
+metrics(),
+packetMirrors(),
+packetPool(),
+addonRouter(),
+addonMessages(),
+chatFilters(),
+commands(),
+statements(),
 queryProcessor(),
+transactionProcessor(),
+stateGeneration(0),
 
 ServerEventBindings(NULL),
 PlayerEventBindings(NULL),
@@ -195,12 +205,16 @@ CreatureUniqueBindings(NULL)
     // Set event manager. Must be after setting sEluna
     // on multithread have a map of state pointers and here insert this pointer to the map and then save a pointer of that pointer to the EventMgr
     eventMgr = new EventMgr(&Eluna::GEluna);
+
+    metrics.StartServer(&httpManager);
 }
 
 Eluna::~Eluna()
 {
     ASSERT(IsInitialized());
 
+    metrics.StopServer();
+
     CloseLua();
 
     delete eventMgr;
@@ -211,12 +225,23 @@ void Eluna::CloseLua()
 {
     OnLuaStateClose();
 
+    packetMirrors.Clear(L);
+    addonRouter.Clear(L);
+    addonMessages.Clear();
+    chatFilters.Clear(L);
+    commands.Clear(L);
+    statements.Clear();
+    queryCache.Clear();
+    coroutines.Clear();
+    workers.Stop();
+    objectVariables.Clear();
     DestroyBindStores();
 
     // Must close lua state after deleting stores and mgr
     if (L)
         lua_close(L);
     L = NULL;
+    ++stateGeneration;
 
     instanceDataRefs.clear();
     continentDataRefs.clear();
@@ -236,7 +261,10 @@ void Eluna::OpenLua()
         return;
     }
 
-    L = luaL_newstate();
+    // Same as luaL_newstate but counts the memory used
+    L = lua_newstate(&ElunaMetrics::Allocate, &metrics);
+    lua_atpanic(L, &AtPanic);
+    metrics.WatchGarbageCollection(L);
 
     lua_pushlightuserdata(L, this);
     lua_setfield(L, LUA_REGISTRYINDEX, ELUNA_STATE_PTR);
@@ -258,6 +286,7 @@ void Eluna::OpenLua()
     lua_pushstring(L, ""); // erase cpath
     lua_setfield(L, -2, "cpath");
     lua_pop(L, 1);
+    workers.SetRequirePath(lua_requirepath);
 }
 
 void Eluna::CreateBindStores()
@@ -552,6 +581,13 @@ void Eluna::Report(lua_State* _L)
     lua_pop(_L, 1);
 }
 
+// Errors outside of a protected call, Lua aborts after this returns
+int Eluna::AtPanic(lua_State* _L)
+{
+    ELUNA_LOG_ERROR("[Eluna]: PANIC: unprotected error in call to Lua API ({})", lua_tostring(_L, -1));
+    return 0;
+}
+
 // Borrowed from http://stackoverflow.com/questions/12256455/print-stacktrace-from-c-code-with-embedded-lua
 int Eluna::StackTrace(lua_State *_L)
 {
@@ -616,6 +652,7 @@ bool Eluna::ExecuteCall(int params, int res)
     ++event_level;
     int result = lua_pcall(L, params, res, usetrace ? base : 0);
     --event_level;
+    metrics.luaCalls.fetch_add(1, std::memory_order_relaxed);
 
     if (usetrace)
     {
@@ -630,9 +667,12 @@ bool Eluna::ExecuteCall(int params, int res)
     {
         // Stack: errmsg
         Report(L);
+        metrics.luaErrors.fetch_add(1, std::memory_order_relaxed);
 
         // Force garbage collect
+        auto collectStart = std::chrono::steady_clock::now();
         lua_gc(L, LUA_GCCOLLECT, 0);
+        metrics.gcCollectNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - collectStart).count(), std::memory_order_relaxed);
 
         // Push nils for expected amount of results
         for (int i = 0; i < res; ++i)
@@ -645,6 +685,46 @@ bool Eluna::ExecuteCall(int params, int res)
     return true;
 }
 
+int Eluna::ExecuteResume(lua_State* thread, lua_State* from, int params)
+{
+    // Objects are invalidated when event_level hits 0
+    ++event_level;
+    int result = lua_resume(thread, from, params);
+    --event_level;
+    metrics.luaCalls.fetch_add(1, std::memory_order_relaxed);
+
+    if (result != LUA_OK && result != LUA_YIELD)
+    {
+#if defined(AZEROTHCORE)
+        bool usetrace = eConfigMgr->GetOption<bool>("Eluna.TraceBack", false);
+#else
+        bool usetrace = eConfigMgr->GetBoolDefault("Eluna.TraceBack", false);
+#endif
+
+        // The stack of a coroutine is kept after an error, so the traceback is taken after unwinding
+        if (usetrace && lua_isstring(thread, -1))
+        {
+            luaL_traceback(L, thread, lua_tostring(thread, -1), 0);
+            OnError(std::string(lua_tostring(L, -1)));
+        }
+        else
+            lua_xmove(thread, L, 1);
+
+        // Stack: errmsg
+        Report(L);
+        metrics.luaErrors.fetch_add(1, std::memory_order_relaxed);
+
+        // Force garbage collect
+        auto collectStart = std::chrono::steady_clock::now();
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        metrics.gcCollectNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - collectStart).count(), std::memory_order_relaxed);
+    }
+
+    if (event_level == 0)
+        InvalidateObjects();
+    return result;
+}
+
 void Eluna::Push(lua_State* luastate)
 {
     lua_pushnil(luastate);
@@ -1211,6 +1291,8 @@ void Eluna::CleanUpStack(int number_of_arguments)
     lua_pop(L, number_of_arguments + 1); // Add 1 because the caller doesn't know about `event_id`.
     // Stack: (empty)
 
+    metrics.EndHook();
+
     if (event_level == 0)
         InvalidateObjects();
 }
@@ -1354,6 +1436,19 @@ void Eluna::FreeInstanceId(uint32 instanceId)
     }
 }
 
+/*
+ * Unrefs the values set with SetData on a world object or map being destroyed.
+ */
+void Eluna::FreeObjectVariables(const void* object)
+{
+    // Most objects never get values, don't wait for the lock for them
+    if (objectVariables.IsEmpty())
+        return;
+
+    LOCK_ELUNA;
+    objectVariables.Free(L, object);
+}
+
 void Eluna::PushInstanceData(lua_State* L, ElunaInstanceAI* ai, bool incrementCounter)
 {
     // Check if the instance data is missing (i.e. someone reloaded Eluna).
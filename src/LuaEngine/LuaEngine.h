@@ -23,6 +23,19 @@
 #include "LFG.h"
 #include "ElunaUtility.h"
 #include "HttpManager.h"
+#include "PacketMirror.h"
+#include "PacketPool.h"
+#include "AddonMessageRouter.h"
+#include "AddonMessageBatcher.h"
+#include "ChatFilter.h"
+#include "CommandTrie.h"
+#include "ElunaStatements.h"
+#include "ElunaQueryCache.h"
+#include "ElunaCoroutines.h"
+#include "ElunaWorkers.h"
+#include "ElunaObjectVariables.h"
+#include "ElunaSharedDictionary.h"
+#include "ElunaMetrics.h"
 #include "EventEmitter.h"
 #include <mutex>
 #include <memory>
@@ -191,6 +204,7 @@ private:
     static void AddScriptPath(std::string filename, const std::string& fullpath);
 
     static int StackTrace(lua_State *_L);
+    static int AtPanic(lua_State* _L);
     static void Report(lua_State* _L);
 
     // Some helpers for hooks to call event handlers.
@@ -241,7 +255,23 @@ public:
     lua_State* L;
     EventMgr* eventMgr;
     HttpManager httpManager;
+    ElunaMetrics metrics;
+    PacketMirrorManager packetMirrors;
+    PacketPool packetPool;
+    AddonMessageRouter addonRouter;
+    AddonMessageBatcher addonMessages;
+    ChatFilterManager chatFilters;
+    CommandTrie commands;
+    StatementRegistry statements;
+    QueryCache queryCache;
+    CoroutineScheduler coroutines;
+    WorkerPool workers;
+    ObjectVariableStore objectVariables;
+    SharedDictionaryManager sharedDictionaries;
     QueryCallbackProcessor queryProcessor;
+    AsyncCallbackProcessor<TransactionCallback> transactionProcessor;
+    // Changes each time the Lua state is closed, database callbacks made for an older state are skipped
+    uint32 stateGeneration;
     EventEmitter<void(std::string)> OnError;
 
     BindingMap< EventKey<Hooks::ServerEvents> >*     ServerEventBindings;
@@ -308,6 +338,8 @@ public:
     }
 
     bool ExecuteCall(int params, int res);
+    // Resumes the coroutine with the params on top of its stack and reports its errors, returns the lua_resume status
+    int ExecuteResume(lua_State* thread, lua_State* from, int params);
 
     /*
      * Returns `true` if Eluna has instance data for `map`.
@@ -355,10 +387,11 @@ public:
     CreatureAI* GetAI(Creature* creature);
     InstanceData* GetInstanceData(Map* map);
     void FreeInstanceId(uint32 instanceId);
+    void FreeObjectVariables(const void* object);
 
     /* Custom */
     void OnTimedEvent(int funcRef, uint32 delay, uint32 calls, WorldObject* obj);
-    bool OnCommand(ChatHandler& handler, const char* text);
+    bool OnCommand(ChatHandler& handler, std::string_view text);
     void OnWorldUpdate(uint32 diff);
     void OnLootItem(Player* pPlayer, Item* pItem, uint32 count, ObjectGuid guid);
     void OnLootMoney(Player* pPlayer, uint32 amount);
@@ -442,11 +475,7 @@ public:
 
     /* Packet */
     bool OnPacketSend(WorldSession* session, const WorldPacket& packet);
-    void OnPacketSendAny(Player* player, const WorldPacket& packet, bool& result);
-    void OnPacketSendOne(Player* player, const WorldPacket& packet, bool& result);
     bool OnPacketReceive(WorldSession* session, WorldPacket& packet);
-    void OnPacketReceiveAny(Player* player, WorldPacket& packet, bool& result);
-    void OnPacketReceiveOne(Player* player, WorldPacket& packet, bool& result);
 
     /* Player */
     void OnPlayerEnterCombat(Player* pPlayer, Unit* pEnemy);
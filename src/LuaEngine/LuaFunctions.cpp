@@ -15,6 +15,7 @@ extern "C"
 #include "ElunaIncludes.h"
 #include "ElunaTemplate.h"
 #include "ElunaUtility.h"
+#include "LuaJson.h"
 
 // Method includes
 #include "GlobalMethods.h"
@@ -27,6 +28,8 @@ extern "C"
 #include "GuildMethods.h"
 #include "GameObjectMethods.h"
 #include "ElunaQueryMethods.h"
+#include "ElunaTransactionMethods.h"
+#include "ElunaSharedDictionaryMethods.h"
 #include "AuraMethods.h"
 #include "ItemMethods.h"
 #include "WorldPacketMethods.h"
@@ -45,8 +48,13 @@ luaL_Reg GlobalMethods[] =
 {
     // Hooks
     { "RegisterPacketEvent", &LuaGlobalFunctions::RegisterPacketEvent },
+    { "RegisterPacketMirror", &LuaGlobalFunctions::RegisterPacketMirror },
+    { "RegisterAddonMessageHandler", &LuaGlobalFunctions::RegisterAddonMessageHandler },
+    { "RegisterChunkedAddonMessageHandler", &LuaGlobalFunctions::RegisterChunkedAddonMessageHandler },
     { "RegisterServerEvent", &LuaGlobalFunctions::RegisterServerEvent },
     { "RegisterPlayerEvent", &LuaGlobalFunctions::RegisterPlayerEvent },
+    { "RegisterPlayerChatEvent", &LuaGlobalFunctions::RegisterPlayerChatEvent },
+    { "RegisterCommand", &LuaGlobalFunctions::RegisterCommand },
     { "RegisterGuildEvent", &LuaGlobalFunctions::RegisterGuildEvent },
     { "RegisterGroupEvent", &LuaGlobalFunctions::RegisterGroupEvent },
     { "RegisterCreatureEvent", &LuaGlobalFunctions::RegisterCreatureEvent },
@@ -132,15 +140,40 @@ luaL_Reg GlobalMethods[] =
     { "ReloadEluna", &LuaGlobalFunctions::ReloadEluna },
     { "RunCommand", &LuaGlobalFunctions::RunCommand },
     { "SendWorldMessage", &LuaGlobalFunctions::SendWorldMessage },
+    { "SendPacketToWorld", &LuaGlobalFunctions::SendPacketToWorld },
+    { "SendPacketToZone", &LuaGlobalFunctions::SendPacketToZone },
+    { "SendPacketToArea", &LuaGlobalFunctions::SendPacketToArea },
+    { "SendPacketToPlayers", &LuaGlobalFunctions::SendPacketToPlayers },
     { "WorldDBQuery", &LuaGlobalFunctions::WorldDBQuery },
     { "WorldDBQueryAsync", &LuaGlobalFunctions::WorldDBQueryAsync },
+    { "WorldDBQueryAsyncMulti", &LuaGlobalFunctions::WorldDBQueryAsyncMulti },
     { "WorldDBExecute", &LuaGlobalFunctions::WorldDBExecute },
     { "CharDBQuery", &LuaGlobalFunctions::CharDBQuery },
     { "CharDBQueryAsync", &LuaGlobalFunctions::CharDBQueryAsync },
+    { "CharDBQueryAsyncMulti", &LuaGlobalFunctions::CharDBQueryAsyncMulti },
     { "CharDBExecute", &LuaGlobalFunctions::CharDBExecute },
     { "AuthDBQuery", &LuaGlobalFunctions::AuthDBQuery },
     { "AuthDBQueryAsync", &LuaGlobalFunctions::AuthDBQueryAsync },
+    { "AuthDBQueryAsyncMulti", &LuaGlobalFunctions::AuthDBQueryAsyncMulti },
     { "AuthDBExecute", &LuaGlobalFunctions::AuthDBExecute },
+    { "WorldDBPrepare", &LuaGlobalFunctions::WorldDBPrepare },
+    { "CharDBPrepare", &LuaGlobalFunctions::CharDBPrepare },
+    { "AuthDBPrepare", &LuaGlobalFunctions::AuthDBPrepare },
+    { "ExecuteStatement", &LuaGlobalFunctions::ExecuteStatement },
+    { "QueryStatement", &LuaGlobalFunctions::QueryStatement },
+    { "QueryStatementAsync", &LuaGlobalFunctions::QueryStatementAsync },
+    { "WorldDBQueryCached", &LuaGlobalFunctions::WorldDBQueryCached },
+    { "CharDBQueryCached", &LuaGlobalFunctions::CharDBQueryCached },
+    { "AuthDBQueryCached", &LuaGlobalFunctions::AuthDBQueryCached },
+    { "QueryStatementCached", &LuaGlobalFunctions::QueryStatementCached },
+    { "InvalidateQueryCache", &LuaGlobalFunctions::InvalidateQueryCache },
+    { "GetQueryCacheStats", &LuaGlobalFunctions::GetQueryCacheStats },
+    { "WorldDBTransaction", &LuaGlobalFunctions::WorldDBTransaction },
+    { "CharDBTransaction", &LuaGlobalFunctions::CharDBTransaction },
+    { "AuthDBTransaction", &LuaGlobalFunctions::AuthDBTransaction },
+    { "WorldDBInsert", &LuaGlobalFunctions::WorldDBInsert },
+    { "CharDBInsert", &LuaGlobalFunctions::CharDBInsert },
+    { "AuthDBInsert", &LuaGlobalFunctions::AuthDBInsert },
     { "CreateLuaEvent", &LuaGlobalFunctions::CreateLuaEvent },
     { "RemoveEventById", &LuaGlobalFunctions::RemoveEventById },
     { "RemoveEvents", &LuaGlobalFunctions::RemoveEvents },
@@ -159,6 +192,18 @@ luaL_Reg GlobalMethods[] =
     { "StartGameEvent", &LuaGlobalFunctions::StartGameEvent },
     { "StopGameEvent", &LuaGlobalFunctions::StopGameEvent },
     { "HttpRequest", &LuaGlobalFunctions::HttpRequest },
+    { "GetHttpStats", &LuaGlobalFunctions::GetHttpStats },
+    { "Async", &LuaGlobalFunctions::Async },
+    { "Wait", &LuaGlobalFunctions::Wait },
+    { "AwaitWorldDBQuery", &LuaGlobalFunctions::AwaitWorldDBQuery },
+    { "AwaitCharDBQuery", &LuaGlobalFunctions::AwaitCharDBQuery },
+    { "AwaitAuthDBQuery", &LuaGlobalFunctions::AwaitAuthDBQuery },
+    { "AwaitHttp", &LuaGlobalFunctions::AwaitHttp },
+    { "RunAsync", &LuaGlobalFunctions::RunAsync },
+    { "GetSharedDictionary", &LuaGlobalFunctions::GetSharedDictionary },
+    { "CreateHttpChannel", &LuaGlobalFunctions::CreateHttpChannel },
+    { "SendToHttpChannel", &LuaGlobalFunctions::SendToHttpChannel },
+    { "GetHttpChannelStats", &LuaGlobalFunctions::GetHttpChannelStats },
     { "SetOwnerHalaa", &LuaGlobalFunctions::SetOwnerHalaa },
 
     { NULL, NULL }
@@ -239,6 +284,10 @@ ElunaRegister<WorldObject> WorldObjectMethods[] =
     { "GetExactDistance2d", &LuaWorldObject::GetExactDistance2d },
     { "GetRelativePoint", &LuaWorldObject::GetRelativePoint },
     { "GetAngle", &LuaWorldObject::GetAngle },
+    { "GetData", &LuaWorldObject::GetData },
+
+    // Setters
+    { "SetData", &LuaWorldObject::SetData },
 
     // Boolean
     { "IsWithinLoS", &LuaWorldObject::IsWithinLoS },
@@ -257,6 +306,7 @@ ElunaRegister<WorldObject> WorldObjectMethods[] =
     { "SummonGameObject", &LuaWorldObject::SummonGameObject },
     { "SpawnCreature", &LuaWorldObject::SpawnCreature },
     { "SendPacket", &LuaWorldObject::SendPacket },
+    { "SendPacketToPlayersInRange", &LuaWorldObject::SendPacketToPlayersInRange },
     { "RegisterEvent", &LuaWorldObject::RegisterEvent },
     { "RemoveEventById", &LuaWorldObject::RemoveEventById },
     { "RemoveEvents", &LuaWorldObject::RemoveEvents },
@@ -702,6 +752,7 @@ ElunaRegister<Player> PlayerMethods[] =
     { "SendNotification", &LuaPlayer::SendNotification },
     { "SendPacket", &LuaPlayer::SendPacket },
     { "SendAddonMessage", &LuaPlayer::SendAddonMessage },
+    { "QueueAddonMessage", &LuaPlayer::QueueAddonMessage },
     { "ModifyMoney", &LuaPlayer::ModifyMoney },
     { "LearnSpell", &LuaPlayer::LearnSpell },
     { "LearnTalent", &LuaPlayer::LearnTalent },
@@ -1232,6 +1283,8 @@ ElunaRegister<ElunaQuery> QueryMethods[] =
     { "GetColumnCount", &LuaQuery::GetColumnCount },
     { "GetRowCount", &LuaQuery::GetRowCount },
     { "GetRow", &LuaQuery::GetRow },
+    { "GetRows", &LuaQuery::GetRows },
+    { "GetColumns", &LuaQuery::GetColumns },
     { "GetBool", &LuaQuery::GetBool },
     { "GetUInt8", &LuaQuery::GetUInt8 },
     { "GetUInt16", &LuaQuery::GetUInt16 },
@@ -1252,6 +1305,38 @@ ElunaRegister<ElunaQuery> QueryMethods[] =
     { NULL, NULL }
 };
 
+ElunaRegister<ElunaTransaction> TransactionMethods[] =
+{
+    // Getters
+    { "GetSize", &LuaTransaction::GetSize },
+
+    // Other
+    { "Append", &LuaTransaction::Append },
+    { "AppendStatement", &LuaTransaction::AppendStatement },
+    { "Commit", &LuaTransaction::Commit },
+
+    { NULL, NULL }
+};
+
+ElunaRegister<ElunaSharedDictionary> SharedDictionaryMethods[] =
+{
+    // Getters
+    { "Get", &LuaSharedDictionary::Get },
+    { "GetCount", &LuaSharedDictionary::GetCount },
+
+    // Setters
+    { "Set", &LuaSharedDictionary::Set },
+
+    // Other
+    { "Add", &LuaSharedDictionary::Add },
+    { "Increment", &LuaSharedDictionary::Increment },
+    { "CompareAndSet", &LuaSharedDictionary::CompareAndSet },
+    { "Delete", &LuaSharedDictionary::Delete },
+    { "Clear", &LuaSharedDictionary::Clear },
+
+    { NULL, NULL }
+};
+
 ElunaRegister<WorldPacket> PacketMethods[] =
 {
     // Getters
@@ -1261,6 +1346,10 @@ ElunaRegister<WorldPacket> PacketMethods[] =
     // Setters
     { "SetOpcode", &LuaPacket::SetOpcode },
 
+    // Other
+    { "Reset", &LuaPacket::Reset },
+    { "Release", &LuaPacket::Release },
+
     // Readers
     { "ReadByte", &LuaPacket::ReadByte },
     { "ReadUByte", &LuaPacket::ReadUByte },
@@ -1272,6 +1361,8 @@ ElunaRegister<WorldPacket> PacketMethods[] =
     { "ReadString", &LuaPacket::ReadString },
     { "ReadFloat", &LuaPacket::ReadFloat },
     { "ReadDouble", &LuaPacket::ReadDouble },
+    { "ReadFormat", &LuaPacket::ReadFormat },
+    { "ReadFormatTable", &LuaPacket::ReadFormatTable },
 
     // Writers
     { "WriteByte", &LuaPacket::WriteByte },
@@ -1284,6 +1375,8 @@ ElunaRegister<WorldPacket> PacketMethods[] =
     { "WriteString", &LuaPacket::WriteString },
     { "WriteFloat", &LuaPacket::WriteFloat },
     { "WriteDouble", &LuaPacket::WriteDouble },
+    { "WriteFormat", &LuaPacket::WriteFormat },
+    { "WriteFormatTable", &LuaPacket::WriteFormatTable },
 
     { NULL, NULL }
 };
@@ -1301,9 +1394,11 @@ ElunaRegister<Map> MapMethods[] =
     { "GetAreaId", &LuaMap::GetAreaId },
     { "GetHeight", &LuaMap::GetHeight },
     { "GetWorldObject", &LuaMap::GetWorldObject },
+    { "GetData", &LuaMap::GetData },
 
     // Setters
     { "SetWeather", &LuaMap::SetWeather },
+    { "SetData", &LuaMap::SetData },
 
     // Boolean
 #ifndef CLASSIC
@@ -1319,6 +1414,7 @@ ElunaRegister<Map> MapMethods[] =
 
     // Other
     { "SaveInstanceData", &LuaMap::SaveInstanceData },
+    { "SendPacket", &LuaMap::SendPacket },
 
     { NULL, NULL }
 };
@@ -1416,6 +1512,17 @@ ElunaRegister<Roll> RollMethods[] =
     { NULL, NULL }
 };
 
+// return packets owned by lua to the packet pool instead of deleting them
+template<> int ElunaTemplate<WorldPacket>::CollectGarbage(lua_State* L)
+{
+    // Get object pointer (and check type, no error)
+    ElunaObject* obj = Eluna::CHECKOBJ<ElunaObject>(L, 1, false);
+    if (obj && manageMemory && !obj->IsView() && obj->GetObj())
+        Eluna::GetEluna(L)->packetPool.Release(static_cast<WorldPacket*>(obj->GetObj()));
+    delete obj;
+    return 0;
+}
+
 #if (!defined(TBC) && !defined(CLASSIC))
 // fix compile error about accessing vehicle destructor
 template<> int ElunaTemplate<Vehicle>::CollectGarbage(lua_State* L)
@@ -1480,6 +1587,9 @@ void RegisterFunctions(Eluna* E)
 {
     ElunaGlobal::SetMethods(E, GlobalMethods);
 
+    // json.encode and json.decode
+    LuaJson::Register(E->L);
+
     ElunaTemplate<Object>::Register(E, "Object");
     ElunaTemplate<Object>::SetMethods(E, ObjectMethods);
 
@@ -1561,6 +1671,12 @@ void RegisterFunctions(Eluna* E)
     ElunaTemplate<ElunaQuery>::Register(E, "ElunaQuery", true);
     ElunaTemplate<ElunaQuery>::SetMethods(E, QueryMethods);
 
+    ElunaTemplate<ElunaTransaction>::Register(E, "ElunaTransaction", true);
+    ElunaTemplate<ElunaTransaction>::SetMethods(E, TransactionMethods);
+
+    ElunaTemplate<ElunaSharedDictionary>::Register(E, "ElunaSharedDictionary", true);
+    ElunaTemplate<ElunaSharedDictionary>::SetMethods(E, SharedDictionaryMethods);
+
     ElunaTemplate<AchievementEntry>::Register(E, "AchievementEntry");
     ElunaTemplate<AchievementEntry>::SetMethods(E, AchievementMethods);
 
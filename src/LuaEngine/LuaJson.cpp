@@ -0,0 +1,821 @@
+/*
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ * This program is free software licensed under GPL version 3
+ * Please see the included DOCS/LICENSE.md for more information
+ */
+
+#include "LuaJson.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+};
+
+namespace
+{
+    // Strings larger than this are not kept around between calls
+    const size_t MAX_SCRATCH_CAPACITY = 1024 * 1024;
+
+    const uint64_t ONES = 0x0101010101010101ULL;
+    const uint64_t HIGHS = 0x8080808080808080ULL;
+
+    // Bytes that can't appear unescaped in a JSON string
+    inline bool NeedsEscape(unsigned char c)
+    {
+        return c < 0x20 || c == '"' || c == '\\';
+    }
+
+    // Returns the position of the first byte needing escaping, or length.
+    // Checks 8 bytes at a time, the exact byte is then found by the byte loop.
+    size_t FindEscape(const char* str, size_t pos, size_t length)
+    {
+        for (; pos + 8 <= length; pos += 8)
+        {
+            uint64_t word;
+            memcpy(&word, str + pos, sizeof(word));
+
+            uint64_t control = (word - ONES * 0x20) & ~word;
+            uint64_t quote = word ^ (ONES * '"');
+            quote = (quote - ONES) & ~quote;
+            uint64_t backslash = word ^ (ONES * '\\');
+            backslash = (backslash - ONES) & ~backslash;
+
+            if ((control | quote | backslash) & HIGHS)
+                break;
+        }
+
+        for (; pos < length; ++pos)
+            if (NeedsEscape(static_cast<unsigned char>(str[pos])))
+                return pos;
+        return length;
+    }
+
+    void AppendString(std::string& out, const char* str, size_t length)
+    {
+        static const char hex[] = "0123456789abcdef";
+
+        out.push_back('"');
+
+        size_t pos = 0;
+        while (pos < length)
+        {
+            size_t next = FindEscape(str, pos, length);
+            out.append(str + pos, next - pos);
+            if (next == length)
+                break;
+
+            unsigned char c = static_cast<unsigned char>(str[next]);
+            switch (c)
+            {
+                case '"': out.append("\\\"", 2); break;
+                case '\\': out.append("\\\\", 2); break;
+                case '\b': out.append("\\b", 2); break;
+                case '\f': out.append("\\f", 2); break;
+                case '\n': out.append("\\n", 2); break;
+                case '\r': out.append("\\r", 2); break;
+                case '\t': out.append("\\t", 2); break;
+                default:
+                {
+                    char escaped[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+                    out.append(escaped, sizeof(escaped));
+                    break;
+                }
+            }
+            pos = next + 1;
+        }
+
+        out.push_back('"');
+    }
+
+    // Integral values are written without a fraction, others in the shortest form that reads back the same
+    bool AppendNumber(std::string& out, double value)
+    {
+        if (!std::isfinite(value))
+            return false;
+
+        char buffer[32];
+        if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0) // 2^53
+        {
+            std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<long long>(value));
+            out.append(buffer, result.ptr);
+        }
+        else
+        {
+#if defined(__cpp_lib_to_chars)
+            std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            out.append(buffer, result.ptr);
+#else
+            // Older standard libraries only convert integers, 17 digits always read back the same
+            out.append(buffer, snprintf(buffer, sizeof(buffer), "%.17g", value));
+#endif
+        }
+        return true;
+    }
+
+    class Encoder
+    {
+    public:
+        Encoder(lua_State* L, std::string& out, LuaJson::EncodeOptions const& options, std::string& error)
+            : L(L), out(out), options(options), error(error)
+        {
+        }
+
+        bool EncodeValue(int index, int depth)
+        {
+            switch (lua_type(L, index))
+            {
+                case LUA_TNIL:
+                    out.append("null", 4);
+                    return true;
+                case LUA_TBOOLEAN:
+                    if (lua_toboolean(L, index))
+                        out.append("true", 4);
+                    else
+                        out.append("false", 5);
+                    return true;
+                case LUA_TNUMBER:
+                    if (!AppendNumber(out, lua_tonumber(L, index)))
+                        return Fail("cannot encode NaN or infinity");
+                    return true;
+                case LUA_TSTRING:
+                {
+                    size_t length;
+                    const char* str = lua_tolstring(L, index, &length);
+                    AppendString(out, str, length);
+                    return true;
+                }
+                case LUA_TTABLE:
+                    return EncodeTable(index, depth + 1);
+                case LUA_TLIGHTUSERDATA:
+                    // json.null
+                    if (!lua_touserdata(L, index))
+                    {
+                        out.append("null", 4);
+                        return true;
+                    }
+                    break;
+                default:
+                    break;
+            }
+
+            error = "cannot encode ";
+            error += lua_typename(L, lua_type(L, index));
+            return false;
+        }
+
+    private:
+        bool Fail(const char* message)
+        {
+            error = message;
+            return false;
+        }
+
+        // Returns the array length if the table only has the keys 1..n, otherwise -1
+        lua_Number ArrayLength(int index)
+        {
+            lua_Number count = 0;
+            lua_Number max = 0;
+
+            lua_pushnil(L);
+            while (lua_next(L, index))
+            {
+                lua_pop(L, 1);
+
+                if (lua_type(L, -1) != LUA_TNUMBER)
+                {
+                    lua_pop(L, 1);
+                    return -1;
+                }
+
+                lua_Number key = lua_tonumber(L, -1);
+                if (key < 1 || key != std::floor(key))
+                {
+                    lua_pop(L, 1);
+                    return -1;
+                }
+
+                if (key > max)
+                    max = key;
+                ++count;
+            }
+
+            return count == max ? count : -1;
+        }
+
+        bool EncodeTable(int index, int depth)
+        {
+            if (depth > options.maxDepth)
+                return Fail("table is nested too deep or contains a reference cycle");
+            // Key and value
+            if (!lua_checkstack(L, 3))
+                return Fail("stack overflow");
+
+            if (index < 0)
+                index = lua_gettop(L) + index + 1;
+
+            lua_Number length = ArrayLength(index);
+            if (length == 0)
+            {
+                if (options.emptyTableAsArray)
+                    out.append("[]", 2);
+                else
+                    out.append("{}", 2);
+                return true;
+            }
+
+            if (length > 0)
+            {
+                out.push_back('[');
+                int count = static_cast<int>(length);
+                for (int i = 1; i <= count; ++i)
+                {
+                    if (i > 1)
+                        out.push_back(',');
+
+                    lua_rawgeti(L, index, i);
+                    bool encoded = EncodeValue(-1, depth);
+                    lua_pop(L, 1);
+                    if (!encoded)
+                        return false;
+                }
+                out.push_back(']');
+                return true;
+            }
+
+            out.push_back('{');
+            bool first = true;
+            lua_pushnil(L);
+            while (lua_next(L, index))
+            {
+                if (!first)
+                    out.push_back(',');
+                first = false;
+
+                // lua_tolstring would convert number keys in place and break lua_next
+                int keyType = lua_type(L, -2);
+                if (keyType == LUA_TSTRING)
+                {
+                    size_t length;
+                    const char* key = lua_tolstring(L, -2, &length);
+                    AppendString(out, key, length);
+                }
+                else if (keyType == LUA_TNUMBER)
+                {
+                    out.push_back('"');
+                    if (!AppendNumber(out, lua_tonumber(L, -2)))
+                    {
+                        lua_pop(L, 2);
+                        return Fail("cannot encode NaN or infinity");
+                    }
+                    out.push_back('"');
+                }
+                else
+                {
+                    lua_pop(L, 2);
+                    return Fail("table keys must be strings or numbers");
+                }
+
+                out.push_back(':');
+                if (!EncodeValue(-1, depth))
+                {
+                    lua_pop(L, 2);
+                    return false;
+                }
+                lua_pop(L, 1);
+            }
+            out.push_back('}');
+            return true;
+        }
+
+        lua_State* L;
+        std::string& out;
+        LuaJson::EncodeOptions const& options;
+        std::string& error;
+    };
+
+    class Decoder
+    {
+    public:
+        Decoder(lua_State* L, const char* text, size_t length, int nullIndex, int maxDepth, std::string& error)
+            : L(L), begin(text), pos(text), end(text + length), nullIndex(nullIndex), maxDepth(maxDepth), error(error)
+        {
+        }
+
+        bool Decode()
+        {
+            int top = lua_gettop(L);
+
+            SkipWhitespace();
+            if (!DecodeValue(0))
+            {
+                lua_settop(L, top);
+                return false;
+            }
+
+            SkipWhitespace();
+            if (pos != end)
+            {
+                lua_settop(L, top);
+                return Fail("unexpected data after the value");
+            }
+            return true;
+        }
+
+    private:
+        bool Fail(const char* message)
+        {
+            error = message;
+            error += " at character ";
+            error += std::to_string(pos - begin + 1);
+            return false;
+        }
+
+        void SkipWhitespace()
+        {
+            while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t'))
+                ++pos;
+        }
+
+        bool Match(const char* literal, size_t length)
+        {
+            if (static_cast<size_t>(end - pos) < length || memcmp(pos, literal, length) != 0)
+                return Fail("invalid value");
+            pos += length;
+            return true;
+        }
+
+        bool DecodeValue(int depth)
+        {
+            if (pos == end)
+                return Fail("unexpected end of data");
+
+            switch (*pos)
+            {
+                case '{':
+                    return DecodeObject(depth + 1);
+                case '[':
+                    return DecodeArray(depth + 1);
+                case '"':
+                    return DecodeString();
+                case 't':
+                    if (!Match("true", 4))
+                        return false;
+                    lua_pushboolean(L, 1);
+                    return true;
+                case 'f':
+                    if (!Match("false", 5))
+                        return false;
+                    lua_pushboolean(L, 0);
+                    return true;
+                case 'n':
+                    if (!Match("null", 4))
+                        return false;
+                    if (nullIndex)
+                        lua_pushvalue(L, nullIndex);
+                    else
+                        lua_pushnil(L);
+                    return true;
+                default:
+                    return DecodeNumber();
+            }
+        }
+
+        bool DecodeObject(int depth)
+        {
+            if (depth > maxDepth)
+                return Fail("data is nested too deep");
+            // Table, key and value
+            if (!lua_checkstack(L, 3))
+                return Fail("stack overflow");
+
+            ++pos;
+            lua_newtable(L);
+
+            SkipWhitespace();
+            if (pos < end && *pos == '}')
+            {
+                ++pos;
+                return true;
+            }
+
+            while (true)
+            {
+                SkipWhitespace();
+                if (pos == end || *pos != '"')
+                    return Fail("expected a string key");
+                if (!DecodeString())
+                    return false;
+
+                SkipWhitespace();
+                if (pos == end || *pos != ':')
+                    return Fail("expected ':'");
+                ++pos;
+
+                SkipWhitespace();
+                if (!DecodeValue(depth))
+                    return false;
+                lua_rawset(L, -3);
+
+                SkipWhitespace();
+                if (pos == end)
+                    return Fail("unexpected end of data");
+                if (*pos == '}')
+                {
+                    ++pos;
+                    return true;
+                }
+                if (*pos != ',')
+                    return Fail("expected ',' or '}'");
+                ++pos;
+            }
+        }
+
+        bool DecodeArray(int depth)
+        {
+            if (depth > maxDepth)
+                return Fail("data is nested too deep");
+            // Table and value
+            if (!lua_checkstack(L, 2))
+                return Fail("stack overflow");
+
+            ++pos;
+            lua_newtable(L);
+
+            SkipWhitespace();
+            if (pos < end && *pos == ']')
+            {
+                ++pos;
+                return true;
+            }
+
+            for (int i = 1; ; ++i)
+            {
+                SkipWhitespace();
+                if (!DecodeValue(depth))
+                    return false;
+                lua_rawseti(L, -2, i);
+
+                SkipWhitespace();
+                if (pos == end)
+                    return Fail("unexpected end of data");
+                if (*pos == ']')
+                {
+                    ++pos;
+                    return true;
+                }
+                if (*pos != ',')
+                    return Fail("expected ',' or ']'");
+                ++pos;
+            }
+        }
+
+        bool ReadHex(uint32_t& code)
+        {
+            if (end - pos < 4)
+                return false;
+
+            code = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                char c = *pos++;
+                code <<= 4;
+                if (c >= '0' && c <= '9')
+                    code |= c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    code |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    code |= c - 'A' + 10;
+                else
+                    return false;
+            }
+            return true;
+        }
+
+        bool DecodeEscape()
+        {
+            if (pos == end)
+                return Fail("unexpected end of data");
+
+            switch (*pos++)
+            {
+                case '"': scratch.push_back('"'); return true;
+                case '\\': scratch.push_back('\\'); return true;
+                case '/': scratch.push_back('/'); return true;
+                case 'b': scratch.push_back('\b'); return true;
+                case 'f': scratch.push_back('\f'); return true;
+                case 'n': scratch.push_back('\n'); return true;
+                case 'r': scratch.push_back('\r'); return true;
+                case 't': scratch.push_back('\t'); return true;
+                case 'u':
+                    break;
+                default:
+                    return Fail("invalid escape sequence");
+            }
+
+            uint32_t code;
+            if (!ReadHex(code))
+                return Fail("invalid unicode escape");
+
+            // Surrogate pair
+            if (code >= 0xD800 && code <= 0xDBFF)
+            {
+                uint32_t low;
+                if (end - pos < 2 || pos[0] != '\\' || pos[1] != 'u')
+                    return Fail("invalid unicode escape");
+                pos += 2;
+                if (!ReadHex(low) || low < 0xDC00 || low > 0xDFFF)
+                    return Fail("invalid unicode escape");
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else if (code >= 0xDC00 && code <= 0xDFFF)
+                return Fail("invalid unicode escape");
+
+            // UTF-8
+            if (code < 0x80)
+                scratch.push_back(static_cast<char>(code));
+            else if (code < 0x800)
+            {
+                scratch.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                scratch.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            else if (code < 0x10000)
+            {
+                scratch.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                scratch.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                scratch.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            else
+            {
+                scratch.push_back(static_cast<char>(0xF0 | (code >> 18)));
+                scratch.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+                scratch.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                scratch.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            return true;
+        }
+
+        bool DecodeString()
+        {
+            ++pos;
+
+            size_t length = end - pos;
+            size_t stop = FindEscape(pos, 0, length);
+            if (stop == length)
+                return Fail("unterminated string");
+
+            // Strings without escapes are pushed straight from the input
+            if (pos[stop] == '"')
+            {
+                lua_pushlstring(L, pos, stop);
+                pos += stop + 1;
+                return true;
+            }
+
+            scratch.clear();
+            while (true)
+            {
+                scratch.append(pos, stop);
+                pos += stop;
+
+                if (*pos == '"')
+                {
+                    ++pos;
+                    lua_pushlstring(L, scratch.data(), scratch.size());
+                    return true;
+                }
+                if (*pos != '\\')
+                    return Fail("control character in string");
+
+                ++pos;
+                if (!DecodeEscape())
+                    return false;
+
+                length = end - pos;
+                stop = FindEscape(pos, 0, length);
+                if (stop == length)
+                    return Fail("unterminated string");
+            }
+        }
+
+        bool DecodeNumber()
+        {
+            const char* start = pos;
+
+            if (pos < end && *pos == '-')
+                ++pos;
+            if (pos == end || *pos < '0' || *pos > '9')
+                return Fail("invalid value");
+            if (*pos == '0')
+                ++pos;
+            else
+                while (pos < end && *pos >= '0' && *pos <= '9')
+                    ++pos;
+
+            if (pos < end && *pos == '.')
+            {
+                ++pos;
+                if (pos == end || *pos < '0' || *pos > '9')
+                    return Fail("invalid number");
+                while (pos < end && *pos >= '0' && *pos <= '9')
+                    ++pos;
+            }
+
+            if (pos < end && (*pos == 'e' || *pos == 'E'))
+            {
+                ++pos;
+                if (pos < end && (*pos == '+' || *pos == '-'))
+                    ++pos;
+                if (pos == end || *pos < '0' || *pos > '9')
+                    return Fail("invalid number");
+                while (pos < end && *pos >= '0' && *pos <= '9')
+                    ++pos;
+            }
+
+            double value = 0;
+#if defined(__cpp_lib_to_chars)
+            std::from_chars_result result = std::from_chars(start, pos, value);
+            // Out of range values are still valid JSON
+            if (result.ec == std::errc::result_out_of_range)
+                value = strtod(std::string(start, pos).c_str(), nullptr);
+#else
+            // The number is already validated, strtod only needs it terminated
+            scratch.assign(start, pos);
+            value = strtod(scratch.c_str(), nullptr);
+#endif
+
+            lua_pushnumber(L, value);
+            return true;
+        }
+
+        lua_State* L;
+        const char* begin;
+        const char* pos;
+        const char* end;
+        int nullIndex;
+        int maxDepth;
+        std::string& error;
+        std::string scratch;
+    };
+
+    int CheckDepth(lua_State* L, int index, const char* field, int defaultDepth)
+    {
+        lua_getfield(L, index, field);
+        if (!lua_isnil(L, -1) && !lua_isnumber(L, -1))
+            luaL_error(L, "%s must be a number", field);
+        int depth = lua_isnil(L, -1) ? defaultDepth : static_cast<int>(lua_tointeger(L, -1));
+        lua_pop(L, 1);
+        return depth;
+    }
+
+    /**
+     * Returns the value encoded as a JSON string.
+     *
+     * Tables with only the keys 1..n are encoded as arrays, other tables as objects with their keys converted to strings.
+     * nil and `json.null` are encoded as null. Functions, userdata, NaN and infinity can't be encoded.
+     *
+     * The options table can contain:
+     *
+     * - emptyTableAsArray : encode empty tables as [] instead of {}, false by default
+     * - maxDepth : maximum table nesting, 128 by default
+     *
+     *     local body = json.encode({ name = player:GetName(), items = { 6948, 2589 } })
+     *
+     * @param value : the value to encode
+     * @param table options : optional encoding options
+     * @return string json
+     */
+    int json_encode(lua_State* L)
+    {
+        LuaJson::EncodeOptions options;
+        if (!lua_isnoneornil(L, 2))
+        {
+            luaL_checktype(L, 2, LUA_TTABLE);
+            LuaJson::ReadEncodeOptions(L, 2, options);
+        }
+        lua_settop(L, 1);
+
+        // The string is reused between calls to avoid growing it every time
+        static thread_local std::string buffer;
+
+        bool encoded;
+        {
+            std::string error;
+            buffer.clear();
+            encoded = LuaJson::Encode(L, 1, buffer, options, error);
+            if (encoded)
+                lua_pushlstring(L, buffer.data(), buffer.size());
+            else
+                lua_pushstring(L, error.c_str());
+
+            if (buffer.capacity() > MAX_SCRATCH_CAPACITY)
+                std::string().swap(buffer);
+        }
+
+        if (!encoded)
+            return lua_error(L);
+        return 1;
+    }
+
+    /**
+     * Returns the value decoded from a JSON string.
+     *
+     * Arrays and objects are decoded as tables and all numbers as Lua numbers.
+     * Raises an error if the string is not valid JSON.
+     *
+     * The options table can contain:
+     *
+     * - null : the value JSON null is decoded as, nil by default. Pass `json.null` to keep nulls in arrays and objects.
+     * - maxDepth : maximum array and object nesting, 128 by default
+     *
+     * @param string json : the string to decode
+     * @param table options : optional decoding options
+     * @return value
+     */
+    int json_decode(lua_State* L)
+    {
+        size_t length;
+        const char* text = luaL_checklstring(L, 1, &length);
+
+        int nullIndex = 0;
+        int maxDepth = LuaJson::EncodeOptions().maxDepth;
+        if (!lua_isnoneornil(L, 2))
+        {
+            luaL_checktype(L, 2, LUA_TTABLE);
+            maxDepth = CheckDepth(L, 2, "maxDepth", maxDepth);
+
+            lua_getfield(L, 2, "null");
+            if (!lua_isnil(L, -1))
+                nullIndex = lua_gettop(L);
+            else
+                lua_pop(L, 1);
+        }
+
+        bool decoded;
+        {
+            std::string error;
+            decoded = LuaJson::Decode(L, text, length, nullIndex, maxDepth, error);
+            if (!decoded)
+                lua_pushstring(L, error.c_str());
+        }
+
+        if (!decoded)
+            return lua_error(L);
+        return 1;
+    }
+
+    const luaL_Reg functions[] =
+    {
+        { "encode", json_encode },
+        { "decode", json_decode },
+        { NULL, NULL }
+    };
+};
+
+void LuaJson::ReadEncodeOptions(lua_State* L, int index, EncodeOptions& options)
+{
+    lua_getfield(L, index, "emptyTableAsArray");
+    if (!lua_isnil(L, -1))
+        options.emptyTableAsArray = lua_toboolean(L, -1) != 0;
+    lua_pop(L, 1);
+
+    options.maxDepth = CheckDepth(L, index, "maxDepth", options.maxDepth);
+}
+
+bool LuaJson::Encode(lua_State* L, int index, std::string& out, EncodeOptions const& options, std::string& error)
+{
+    if (index < 0)
+        index = lua_gettop(L) + index + 1;
+
+    int top = lua_gettop(L);
+    bool encoded = Encoder(L, out, options, error).EncodeValue(index, 0);
+    lua_settop(L, top);
+    return encoded;
+}
+
+bool LuaJson::Decode(lua_State* L, const char* text, size_t length, int nullIndex, int maxDepth, std::string& error)
+{
+    if (nullIndex < 0)
+        nullIndex = lua_gettop(L) + nullIndex + 1;
+
+    return Decoder(L, text, length, nullIndex, maxDepth, error).Decode();
+}
+
+void LuaJson::Register(lua_State* L)
+{
+    lua_newtable(L);
+    luaL_setfuncs(L, functions, 0);
+
+    // Sentinel for null values that can be stored in tables
+    lua_pushlightuserdata(L, NULL);
+    lua_setfield(L, -2, "null");
+
+    lua_setglobal(L, "json");
+}
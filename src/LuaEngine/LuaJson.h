@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ * This program is free software licensed under GPL version 3
+ * Please see the included DOCS/LICENSE.md for more information
+ */
+
+#ifndef _ELUNA_LUA_JSON_H
+#define _ELUNA_LUA_JSON_H
+
+#include <string>
+
+struct lua_State;
+
+/*
+ * Native JSON encoding and decoding of Lua values, available to scripts as `json.encode` and `json.decode`.
+ */
+namespace LuaJson
+{
+    struct EncodeOptions
+    {
+        EncodeOptions() : emptyTableAsArray(false), maxDepth(128) { }
+
+        // Encode {} as [] instead of an empty object
+        bool emptyTableAsArray;
+        // Deeper tables are an error, this also catches reference cycles
+        int maxDepth;
+    };
+
+    // Reads the encode options from the table at index, missing fields keep their defaults
+    void ReadEncodeOptions(lua_State* L, int index, EncodeOptions& options);
+
+    // Appends the JSON representation of the value at index to out.
+    // Does not raise Lua errors, on failure returns false and sets error.
+    bool Encode(lua_State* L, int index, std::string& out, EncodeOptions const& options, std::string& error);
+
+    // Pushes the decoded value, or pushes nothing and sets error.
+    // nullIndex is the stack index of the value JSON null decodes to, 0 for nil.
+    bool Decode(lua_State* L, const char* text, size_t length, int nullIndex, int maxDepth, std::string& error);
+
+    // Creates the global json table
+    void Register(lua_State* L);
+};
+
+#endif // _ELUNA_LUA_JSON_H
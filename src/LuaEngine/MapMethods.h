@@ -369,5 +369,75 @@ namespace LuaMap
         lua_settop(L, tbl);
         return 1;
     }
+
+    /**
+    * Sends a [WorldPacket] to all [Player]s in the map
+    *
+    *     enum TeamId
+    *     {
+    *         TEAM_ALLIANCE = 0,
+    *         TEAM_HORDE = 1,
+    *         TEAM_NEUTRAL = 2
+    *     };
+    *
+    * @param [WorldPacket] packet : the packet to send
+    * @param [TeamId] team : optional check team of the [Player], Alliance, Horde or Neutral (All)
+    * @return uint32 count : amount of [Player]s the packet was sent to
+    */
+    int SendPacket(lua_State* L, Map* map)
+    {
+        WorldPacket* data = Eluna::CHECKOBJ<WorldPacket>(L, 2);
+        uint32 team = Eluna::CHECKVAL<uint32>(L, 3, TEAM_NEUTRAL);
+        if (team > TEAM_NEUTRAL)
+            return luaL_argerror(L, 3, "valid TeamId expected");
+
+        uint32 count = 0;
+        Map::PlayerList const& players = map->GetPlayers();
+        for (Map::PlayerList::const_iterator itr = players.begin(); itr != players.end(); ++itr)
+        {
+#if defined TRINITY || AZEROTHCORE
+            Player* player = itr->GetSource();
+#else
+            Player* player = itr->getSource();
+#endif
+            if (!player)
+                continue;
+            if ((team == TEAM_NEUTRAL || player->GetTeamId() == team) && ElunaUtil::SendPacket(player, data))
+                ++count;
+        }
+
+        Eluna::Push(L, count);
+        return 1;
+    }
+
+    /**
+     * Returns the value stored on the [Map] for the key with [Map:SetData], or the table of all its values if no key is given.
+     *
+     * The values are kept until the [Map] is destroyed or Eluna is reloaded.
+     *
+     * @proto table = ()
+     * @proto value = (key)
+     * @param key : the key of the value
+     * @return value : the value, or nil if none is set
+     */
+    int GetData(lua_State* L, Map* map)
+    {
+        Eluna::GEluna->objectVariables.Get(L, map, 2);
+        return 1;
+    }
+
+    /**
+     * Stores a value of any type on the [Map] for the key, a nil value removes it.
+     *
+     * See also [Map:GetData]
+     *
+     * @param key : the key of the value, anything but nil
+     * @param value : the value to store
+     */
+    int SetData(lua_State* L, Map* map)
+    {
+        Eluna::GEluna->objectVariables.Set(L, map, 2, 3);
+        return 0;
+    }
 };
 #endif
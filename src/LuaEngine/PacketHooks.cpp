@@ -13,61 +13,46 @@
 
 using namespace Hooks;
 
-#define START_HOOK_SERVER(EVENT) \
+#define START_HOOK_PACKET(SERVER_EVENT, PACKET_EVENT, OPCODE) \
     if (!IsEnabled())\
-        return;\
-    auto key = EventKey<ServerEvents>(EVENT);\
-    if (!ServerEventBindings->HasBindingsFor(key))\
-        return;\
-    LOCK_ELUNA
-
-#define START_HOOK_PACKET(EVENT, OPCODE) \
-    if (!IsEnabled())\
-        return;\
-    auto key = EntryKey<PacketEvents>(EVENT, OPCODE);\
-    if (!PacketEventBindings->HasBindingsFor(key))\
-        return;\
+        return true;\
+    auto server_key = EventKey<ServerEvents>(SERVER_EVENT);\
+    auto packet_key = EntryKey<PacketEvents>(PACKET_EVENT, OPCODE);\
+    if (!ServerEventBindings->HasBindingsFor(server_key))\
+        if (!PacketEventBindings->HasBindingsFor(packet_key))\
+            return true;\
     LOCK_ELUNA
 
+/*
+ * Both the "any opcode" server event and the per opcode packet event handlers
+ *   get the same read-only view of the core's packet instead of a copy.
+ * Writing to the view gives the handler its own copy (see LuaPacket).
+ *
+ * Every handler starts reading at the core's read position, which is restored afterwards.
+ * The view is invalidated before returning since the packet may not outlive the hook.
+ */
 bool Eluna::OnPacketSend(WorldSession* session, const WorldPacket& packet)
 {
+    packetMirrors.Mirror(PACKET_EVENT_ON_PACKET_SEND, session, packet);
+
+    START_HOOK_PACKET(SERVER_EVENT_ON_PACKET_SEND, PACKET_EVENT_ON_PACKET_SEND, packet.GetOpcode());
     bool result = true;
     Player* player = NULL;
     if (session)
         player = session->GetPlayer();
-    OnPacketSendAny(player, packet, result);
-    OnPacketSendOne(player, packet, result);
-    return result;
-}
-void Eluna::OnPacketSendAny(Player* player, const WorldPacket& packet, bool& result)
-{
-    START_HOOK_SERVER(SERVER_EVENT_ON_PACKET_SEND);
-    Push(new WorldPacket(packet));
-    Push(player);
-    int n = SetupStack(ServerEventBindings, key, 2);
-
-    while (n > 0)
-    {
-        int r = CallOneFunction(n--, 2, 1);
-
-        if (lua_isboolean(L, r + 0) && !lua_toboolean(L, r + 0))
-            result = false;
-
-        lua_pop(L, 1);
-    }
 
-    CleanUpStack(2);
-}
+    WorldPacket& data = const_cast<WorldPacket&>(packet);
+    size_t rpos = data.rpos();
 
-void Eluna::OnPacketSendOne(Player* player, const WorldPacket& packet, bool& result)
-{
-    START_HOOK_PACKET(PACKET_EVENT_ON_PACKET_SEND, packet.GetOpcode());
-    Push(new WorldPacket(packet));
+    ElunaObject* view = ElunaTemplate<WorldPacket>::PushView(L, &data);
+    ++push_counter;
     Push(player);
-    int n = SetupStack(PacketEventBindings, key, 2);
+    // Packet event handlers are pushed first so that server event handlers are called first
+    int n = SetupStack(PacketEventBindings, ServerEventBindings, packet_key, server_key, 2);
 
     while (n > 0)
     {
+        data.rpos(rpos);
         int r = CallOneFunction(n--, 2, 1);
 
         if (lua_isboolean(L, r + 0) && !lua_toboolean(L, r + 0))
@@ -76,64 +61,61 @@ void Eluna::OnPacketSendOne(Player* player, const WorldPacket& packet, bool& res
         lua_pop(L, 1);
     }
 
+    data.rpos(rpos);
+    if (view)
+        view->Invalidate();
     CleanUpStack(2);
+    return result;
 }
 
 bool Eluna::OnPacketReceive(WorldSession* session, WorldPacket& packet)
 {
+    packetMirrors.Mirror(PACKET_EVENT_ON_PACKET_RECEIVE, session, packet);
+
+    START_HOOK_PACKET(SERVER_EVENT_ON_PACKET_RECEIVE, PACKET_EVENT_ON_PACKET_RECEIVE, packet.GetOpcode());
     bool result = true;
+    bool replaced = false;
     Player* player = NULL;
     if (session)
         player = session->GetPlayer();
-    OnPacketReceiveAny(player, packet, result);
-    OnPacketReceiveOne(player, packet, result);
-    return result;
-}
-
-void Eluna::OnPacketReceiveAny(Player* player, WorldPacket& packet, bool& result)
-{
-    START_HOOK_SERVER(SERVER_EVENT_ON_PACKET_RECEIVE);
-    Push(new WorldPacket(packet));
-    Push(player);
-    int n = SetupStack(ServerEventBindings, key, 2);
 
-    while (n > 0)
-    {
-        int r = CallOneFunction(n--, 2, 2);
-
-        if (lua_isboolean(L, r + 0) && !lua_toboolean(L, r + 0))
-            result = false;
+    size_t rpos = packet.rpos();
 
-        if (lua_isuserdata(L, r + 1))
-            if (WorldPacket* data = CHECKOBJ<WorldPacket>(L, r + 1, false))
-                packet = *data;
-
-        lua_pop(L, 2);
-    }
-
-    CleanUpStack(2);
-}
-
-void Eluna::OnPacketReceiveOne(Player* player, WorldPacket& packet, bool& result)
-{
-    START_HOOK_PACKET(PACKET_EVENT_ON_PACKET_RECEIVE, packet.GetOpcode());
-    Push(new WorldPacket(packet));
+    ElunaObject* view = ElunaTemplate<WorldPacket>::PushView(L, &packet);
+    ++push_counter;
     Push(player);
-    int n = SetupStack(PacketEventBindings, key, 2);
+    // Packet event handlers are pushed first so that server event handlers are called first
+    int n = SetupStack(PacketEventBindings, ServerEventBindings, packet_key, server_key, 2);
 
     while (n > 0)
     {
+        if (!replaced)
+            packet.rpos(rpos);
         int r = CallOneFunction(n--, 2, 2);
 
         if (lua_isboolean(L, r + 0) && !lua_toboolean(L, r + 0))
             result = false;
 
+        // An untouched view points to the packet itself, only copies need to be applied
         if (lua_isuserdata(L, r + 1))
+        {
             if (WorldPacket* data = CHECKOBJ<WorldPacket>(L, r + 1, false))
-                packet = *data;
+            {
+                if (data != &packet)
+                {
+                    packet = *data;
+                    replaced = true;
+                }
+            }
+        }
 
         lua_pop(L, 2);
     }
 
+    if (!replaced)
+        packet.rpos(rpos);
+    if (view)
+        view->Invalidate();
     CleanUpStack(2);
+    return result;
 }
@@ -0,0 +1,220 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "PacketMirror.h"
+#include "Hooks.h"
+#include "LuaEngine.h"
+#include "ElunaIncludes.h"
+#include "ElunaTemplate.h"
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+};
+
+PacketMirror::PacketMirror(uint64 id, uint32 event_id, std::vector<uint32> const& opcodeList, uint32 sampleRate, uint32 capacity, int functionRef)
+    : id(id),
+    event_id(event_id),
+    sampleRate(sampleRate ? sampleRate : 1),
+    functionRef(functionRef),
+    seen(0),
+    dropped(0),
+    queue(capacity)
+{
+    if (!opcodeList.empty())
+    {
+        opcodes.resize(NUM_MSG_TYPES, false);
+        for (uint32 opcode : opcodeList)
+            if (opcode < NUM_MSG_TYPES)
+                opcodes[opcode] = true;
+    }
+}
+
+PacketMirror::~PacketMirror()
+{
+    MirroredPacket entry;
+    while (queue.TryPop(entry))
+        delete entry.packet;
+}
+
+bool PacketMirror::Matches(uint32 opcode) const
+{
+    if (opcodes.empty())
+        return true;
+    return opcode < opcodes.size() && opcodes[opcode];
+}
+
+PacketMirrorManager::PacketMirrorManager()
+    : sendMirrors(0),
+    receiveMirrors(0),
+    maxMirrorID(0)
+{
+}
+
+PacketMirrorManager::~PacketMirrorManager()
+{
+}
+
+uint64 PacketMirrorManager::Add(uint32 event_id, std::vector<uint32> const& opcodes, uint32 sampleRate, uint32 capacity, int functionRef)
+{
+    std::unique_lock<std::shared_mutex> guard(mirrorsLock);
+
+    uint64 id = ++maxMirrorID;
+    mirrors.push_back(std::unique_ptr<PacketMirror>(new PacketMirror(id, event_id, opcodes, sampleRate, capacity, functionRef)));
+
+    if (event_id == Hooks::PACKET_EVENT_ON_PACKET_SEND)
+        ++sendMirrors;
+    else
+        ++receiveMirrors;
+    return id;
+}
+
+void PacketMirrorManager::Remove(lua_State* L, uint64 id)
+{
+    std::unique_lock<std::shared_mutex> guard(mirrorsLock);
+
+    for (auto itr = mirrors.begin(); itr != mirrors.end(); ++itr)
+    {
+        PacketMirror* mirror = itr->get();
+        if (mirror->id != id)
+            continue;
+
+        if (mirror->event_id == Hooks::PACKET_EVENT_ON_PACKET_SEND)
+            --sendMirrors;
+        else
+            --receiveMirrors;
+
+        luaL_unref(L, LUA_REGISTRYINDEX, mirror->functionRef);
+        mirrors.erase(itr);
+        return;
+    }
+}
+
+void PacketMirrorManager::Clear(lua_State* L)
+{
+    std::unique_lock<std::shared_mutex> guard(mirrorsLock);
+
+    if (L)
+        for (auto& mirror : mirrors)
+            luaL_unref(L, LUA_REGISTRYINDEX, mirror->functionRef);
+
+    mirrors.clear();
+    sendMirrors = 0;
+    receiveMirrors = 0;
+}
+
+void PacketMirrorManager::Mirror(uint32 event_id, WorldSession* session, WorldPacket const& packet)
+{
+    std::atomic<uint32>& count = event_id == Hooks::PACKET_EVENT_ON_PACKET_SEND ? sendMirrors : receiveMirrors;
+    if (!count.load(std::memory_order_relaxed))
+        return;
+
+    ObjectGuid guid;
+    if (session && session->GetPlayer())
+        guid = session->GetPlayer()->GET_GUID();
+
+    std::shared_lock<std::shared_mutex> guard(mirrorsLock);
+
+    for (auto& mirror : mirrors)
+    {
+        if (mirror->event_id != event_id || !mirror->Matches(packet.GetOpcode()))
+            continue;
+
+        if (mirror->seen.fetch_add(1, std::memory_order_relaxed) % mirror->sampleRate)
+            continue;
+
+        // Don't copy the packet if it would be dropped anyway
+        if (mirror->queue.Size() >= mirror->queue.Capacity())
+        {
+            mirror->dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        MirroredPacket entry;
+        entry.packet = new WorldPacket(packet);
+        entry.guid = guid;
+        if (!mirror->queue.TryPush(entry))
+        {
+            delete entry.packet;
+            mirror->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void PacketMirrorManager::Deliver()
+{
+    if (!sendMirrors.load(std::memory_order_relaxed) && !receiveMirrors.load(std::memory_order_relaxed))
+        return;
+
+    LOCK_ELUNA;
+
+    lua_State* L = Eluna::GEluna->L;
+
+    std::vector<uint64> ids;
+    {
+        std::shared_lock<std::shared_mutex> guard(mirrorsLock);
+        for (auto& mirror : mirrors)
+            ids.push_back(mirror->id);
+    }
+
+    std::vector<MirroredPacket> batch;
+    for (uint64 id : ids)
+    {
+        // The mirror can be removed by a previous callback
+        uint32 event_id = 0;
+        uint64 dropped = 0;
+        int functionRef = LUA_NOREF;
+        batch.clear();
+        {
+            std::shared_lock<std::shared_mutex> guard(mirrorsLock);
+            for (auto& mirror : mirrors)
+            {
+                if (mirror->id != id)
+                    continue;
+
+                MirroredPacket entry;
+                while (batch.size() < mirror->queue.Capacity() && mirror->queue.TryPop(entry))
+                    batch.push_back(entry);
+
+                event_id = mirror->event_id;
+                dropped = mirror->dropped.exchange(0, std::memory_order_relaxed);
+                functionRef = mirror->functionRef;
+                break;
+            }
+        }
+
+        if (batch.empty() && !dropped)
+            continue;
+
+        // Get function
+        lua_rawgeti(L, LUA_REGISTRYINDEX, functionRef);
+
+        // Push parameters
+        Eluna::Push(L, event_id);
+
+        lua_createtable(L, static_cast<int>(batch.size()), 0);
+        int packets = lua_gettop(L);
+        lua_createtable(L, static_cast<int>(batch.size()), 0);
+        int guids = lua_gettop(L);
+
+        int i = 1;
+        for (MirroredPacket& entry : batch)
+        {
+            // Lua owns the copies from here on
+            Eluna::Push(L, entry.packet);
+            lua_rawseti(L, packets, i);
+            Eluna::Push(L, entry.guid);
+            lua_rawseti(L, guids, i);
+            ++i;
+        }
+
+        Eluna::Push(L, static_cast<uint32>(dropped));
+
+        // Call function
+        Eluna::GEluna->ExecuteCall(4, 0);
+    }
+}
@@ -0,0 +1,77 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_PACKET_MIRROR_H
+#define _ELUNA_PACKET_MIRROR_H
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include "ElunaUtility.h"
+
+class WorldPacket;
+class WorldSession;
+struct lua_State;
+
+struct MirroredPacket
+{
+    WorldPacket* packet;
+    ObjectGuid guid;
+};
+
+/*
+ * A read-only observer of packet events.
+ *
+ * Matching packets are copied into a bounded queue by the thread handling the packet
+ *   and delivered to the Lua function in batches on the world thread.
+ */
+struct PacketMirror
+{
+    PacketMirror(uint64 id, uint32 event_id, std::vector<uint32> const& opcodes, uint32 sampleRate, uint32 capacity, int functionRef);
+    ~PacketMirror();
+
+    bool Matches(uint32 opcode) const;
+
+    uint64 id;
+    uint32 event_id;
+    std::vector<bool> opcodes; // empty for all opcodes
+    uint32 sampleRate;
+    int functionRef;
+
+    std::atomic<uint64> seen;
+    std::atomic<uint64> dropped;
+    ElunaUtil::BoundedQueue<MirroredPacket> queue;
+};
+
+class PacketMirrorManager
+{
+public:
+    PacketMirrorManager();
+    ~PacketMirrorManager();
+
+    uint64 Add(uint32 event_id, std::vector<uint32> const& opcodes, uint32 sampleRate, uint32 capacity, int functionRef);
+    void Remove(lua_State* L, uint64 id);
+    void Clear(lua_State* L);
+
+    // Called from any thread, never takes the Eluna lock
+    void Mirror(uint32 event_id, WorldSession* session, WorldPacket const& packet);
+    // Called on the world thread
+    void Deliver();
+
+private:
+    typedef std::vector< std::unique_ptr<PacketMirror> > MirrorList;
+
+    // Mirror count per packet event, checked before taking any lock
+    std::atomic<uint32> sendMirrors;
+    std::atomic<uint32> receiveMirrors;
+
+    uint64 maxMirrorID;
+    MirrorList mirrors;
+    std::shared_mutex mirrorsLock;
+};
+
+#endif // _ELUNA_PACKET_MIRROR_H
@@ -0,0 +1,92 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#include "PacketPool.h"
+#include "ElunaIncludes.h"
+
+const size_t PacketPool::classCapacity[PacketPool::CLASS_COUNT] = { 64, 256, 1024, 4096, 16384 };
+
+PacketPool::PacketPool()
+{
+}
+
+PacketPool::~PacketPool()
+{
+    Clear();
+}
+
+WorldPacket* PacketPool::Acquire(uint16 opcode, size_t size)
+{
+    uint32 index = 0;
+    while (index < CLASS_COUNT && classCapacity[index] < size)
+        ++index;
+
+    // Too large to be pooled
+    if (index == CLASS_COUNT)
+        return new WorldPacket((OpcodesList)opcode, size);
+
+    WorldPacket* packet;
+    std::vector<WorldPacket*>& list = freePackets[index];
+    if (list.empty())
+        packet = new WorldPacket((OpcodesList)opcode, classCapacity[index]);
+    else
+    {
+        packet = list.back();
+        list.pop_back();
+        packet->SetOpcode((OpcodesList)opcode);
+    }
+
+    packetClasses[packet] = index;
+    return packet;
+}
+
+void PacketPool::Release(WorldPacket* packet)
+{
+    if (!packet)
+        return;
+
+    uint32 index = 0;
+    auto itr = packetClasses.find(packet);
+    if (itr != packetClasses.end())
+    {
+        index = itr->second;
+        packetClasses.erase(itr);
+    }
+
+    size_t size = packet->size();
+    if (size > classCapacity[CLASS_COUNT - 1] * 2)
+    {
+        delete packet;
+        return;
+    }
+
+    // A packet has at least its size allocated, writing past its class capacity moved it to a larger class
+    while (index + 1 < CLASS_COUNT && classCapacity[index + 1] <= size)
+        ++index;
+
+    std::vector<WorldPacket*>& list = freePackets[index];
+    if (list.size() >= MAX_FREE)
+    {
+        delete packet;
+        return;
+    }
+
+    // Packets not created by the pool may have less than the class capacity reserved
+    packet->clear();
+    packet->reserve(classCapacity[index]);
+    list.push_back(packet);
+}
+
+void PacketPool::Clear()
+{
+    for (uint32 i = 0; i < CLASS_COUNT; ++i)
+    {
+        for (WorldPacket* packet : freePackets[i])
+            delete packet;
+        freePackets[i].clear();
+    }
+    packetClasses.clear();
+}
@@ -0,0 +1,46 @@
+/*
+* Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+* This program is free software licensed under GPL version 3
+* Please see the included DOCS/LICENSE.md for more information
+*/
+
+#ifndef _ELUNA_PACKET_POOL_H
+#define _ELUNA_PACKET_POOL_H
+
+#include <unordered_map>
+#include <vector>
+#include "Define.h"
+
+class WorldPacket;
+
+/*
+ * Recycles the buffers of packets created by scripts.
+ *
+ * Free packets are kept in a list per capacity class, so a packet taken from a class
+ *   has at least the class capacity reserved and writing to it does not reallocate.
+ * Only used while holding the Eluna lock.
+ */
+class PacketPool
+{
+public:
+    PacketPool();
+    ~PacketPool();
+
+    // Returns an empty packet with at least size bytes reserved
+    WorldPacket* Acquire(uint16 opcode, size_t size);
+    // Takes ownership of the packet, it is deleted if it does not fit the pool
+    void Release(WorldPacket* packet);
+    void Clear();
+
+private:
+    static const uint32 CLASS_COUNT = 5;
+    static const size_t classCapacity[CLASS_COUNT];
+    // Maximum amount of free packets kept per class
+    static const size_t MAX_FREE = 64;
+
+    std::vector<WorldPacket*> freePackets[CLASS_COUNT];
+    // Class of the packets given out by Acquire, their written size says nothing about their capacity
+    std::unordered_map<WorldPacket const*, uint32> packetClasses;
+};
+
+#endif // _ELUNA_PACKET_POOL_H
@@ -29,6 +29,16 @@ using namespace Hooks;
         return RETVAL;\
     LOCK_ELUNA
 
+// Filtered chat handlers are matched before taking the lock, lines no handler wants never reach Lua
+#define START_CHAT_HOOK(EVENT) \
+    if (!IsEnabled())\
+        return true;\
+    auto key = EventKey<PlayerEvents>(EVENT);\
+    std::vector<uint64> filtered_ids;\
+    if (!chatFilters.Match(EVENT, type, msg, filtered_ids) && !PlayerEventBindings->HasBindingsFor(key))\
+        return true;\
+    LOCK_ELUNA
+
 void Eluna::OnLearnTalents(Player* pPlayer, uint32 talentId, uint32 talentRank, uint32 spellid)
 {
     START_HOOK(PLAYER_EVENT_ON_LEARN_TALENTS);
@@ -39,24 +49,59 @@ void Eluna::OnLearnTalents(Player* pPlayer, uint32 talentId, uint32 talentRank,
     CallAllFunctions(PlayerEventBindings, key);
 }
 
-bool Eluna::OnCommand(ChatHandler& handler, const char* text)
+bool Eluna::OnCommand(ChatHandler& handler, std::string_view text)
 {
     Player* player = handler.IsConsole() ? nullptr : handler.GetSession()->GetPlayer();
     // If from console, player is NULL
-    if (!player || player->GetSession()->GetSecurity() >= SEC_ADMINISTRATOR)
+    uint32 security = player ? uint32(player->GetSession()->GetSecurity()) : uint32(SEC_CONSOLE);
+    if (security >= SEC_ADMINISTRATOR)
     {
-        std::string reload = text;
-        std::transform(reload.begin(), reload.end(), reload.begin(), ::tolower);
-        if (reload.find("reload eluna") == 0)
+        static const std::string_view reload = "reload eluna";
+        if (text.size() >= reload.size() && std::equal(reload.begin(), reload.end(), text.begin(),
+            [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); }))
         {
             ReloadEluna();
             return false;
         }
     }
 
+    if (!IsEnabled())
+        return true;
+
+    // Commands registered with RegisterCommand are found without entering Lua
+    std::string_view args;
+    if (uint64 commandID = commands.Find(text, security, args))
+    {
+        LOCK_ELUNA;
+        if (commands.PushRef(L, commandID))
+        {
+            Push(L, player);
+            lua_createtable(L, 4, 0);
+            int i = 0;
+            std::string_view rest = args;
+            for (std::string_view word = CommandTrie::NextWord(rest); !word.empty(); word = CommandTrie::NextWord(rest))
+            {
+                lua_pushlstring(L, word.data(), word.size());
+                lua_rawseti(L, -2, ++i);
+            }
+            Push(L, &handler);
+            lua_pushlstring(L, args.data(), args.size());
+
+            // The command is handled unless the handler returns false
+            ExecuteCall(4, 1);
+            bool handled = !lua_isboolean(L, -1) || lua_toboolean(L, -1);
+            lua_pop(L, 1);
+            if (event_level == 0)
+                InvalidateObjects();
+            if (handled)
+                return false;
+        }
+    }
+
     START_HOOK_WITH_RETVAL(PLAYER_EVENT_ON_COMMAND, true);
     Push(player);
-    Push(text);
+    lua_pushlstring(L, text.data(), text.size());
+    ++push_counter;
     Push(&handler);
     return CallAllFunctionsBool(PlayerEventBindings, key, true);
 }
@@ -412,13 +457,14 @@ bool Eluna::OnChat(Player* pPlayer, uint32 type, uint32 lang, std::string& msg)
     if (lang == LANG_ADDON)
         return OnAddonMessage(pPlayer, type, msg, NULL, NULL, NULL, NULL);
 
-    START_HOOK_WITH_RETVAL(PLAYER_EVENT_ON_CHAT, true);
+    START_CHAT_HOOK(PLAYER_EVENT_ON_CHAT);
     bool result = true;
     Push(pPlayer);
     Push(msg);
     Push(type);
     Push(lang);
     int n = SetupStack(PlayerEventBindings, key, 4);
+    n += chatFilters.PushRefs(L, filtered_ids);
 
     while (n > 0)
     {
@@ -442,7 +488,7 @@ bool Eluna::OnChat(Player* pPlayer, uint32 type, uint32 lang, std::string& msg,
     if (lang == LANG_ADDON)
         return OnAddonMessage(pPlayer, type, msg, NULL, NULL, pGroup, NULL);
 
-    START_HOOK_WITH_RETVAL(PLAYER_EVENT_ON_GROUP_CHAT, true);
+    START_CHAT_HOOK(PLAYER_EVENT_ON_GROUP_CHAT);
     bool result = true;
     Push(pPlayer);
     Push(msg);
@@ -450,6 +496,7 @@ bool Eluna::OnChat(Player* pPlayer, uint32 type, uint32 lang, std::string& msg,
     Push(lang);
     Push(pGroup);
     int n = SetupStack(PlayerEventBindings, key, 5);
+    n += chatFilters.PushRefs(L, filtered_ids);
 
     while (n > 0)
     {
@@ -473,7 +520,7 @@ bool Eluna::OnChat(Player* pPlayer, uint32 type, uint32 lang, std::string& msg,
     if (lang == LANG_ADDON)
         return OnAddonMessage(pPlayer, type, msg, NULL, pGuild, NULL, NULL);
 
-    START_HOOK_WITH_RETVAL(PLAYER_EVENT_ON_GUILD_CHAT, true);
+    START_CHAT_HOOK(PLAYER_EVENT_ON_GUILD_CHAT);
     bool result = true;
     Push(pPlayer);
     Push(msg);
@@ -481,6 +528,7 @@ bool Eluna::OnChat(Player* pPlayer, uint32 type, uint32 lang, std::string& msg,
     Push(lang);
     Push(pGuild);
     int n = SetupStack(PlayerEventBindings, key, 5);
+    n += chatFilters.PushRefs(L, filtered_ids);
 
     while (n > 0)
     {
@@ -504,7 +552,7 @@ bool Eluna::OnChat(Player* pPlayer, uint32 type, uint32 lang, std::string& msg,
     if (lang == LANG_ADDON)
         return OnAddonMessage(pPlayer, type, msg, NULL, NULL, NULL, pChannel);
 
-    START_HOOK_WITH_RETVAL(PLAYER_EVENT_ON_CHANNEL_CHAT, true);
+    START_CHAT_HOOK(PLAYER_EVENT_ON_CHANNEL_CHAT);
     bool result = true;
     Push(pPlayer);
     Push(msg);
@@ -512,6 +560,7 @@ bool Eluna::OnChat(Player* pPlayer, uint32 type, uint32 lang, std::string& msg,
     Push(lang);
     Push(pChannel->IsConstant() ? static_cast<int32>(pChannel->GetChannelId()) : -static_cast<int32>(pChannel->GetChannelDBId()));
     int n = SetupStack(PlayerEventBindings, key, 5);
+    n += chatFilters.PushRefs(L, filtered_ids);
 
     while (n > 0)
     {
@@ -535,7 +584,7 @@ bool Eluna::OnChat(Player* pPlayer, uint32 type, uint32 lang, std::string& msg,
     if (lang == LANG_ADDON)
         return OnAddonMessage(pPlayer, type, msg, pReceiver, NULL, NULL, NULL);
 
-    START_HOOK_WITH_RETVAL(PLAYER_EVENT_ON_WHISPER, true);
+    START_CHAT_HOOK(PLAYER_EVENT_ON_WHISPER);
     bool result = true;
     Push(pPlayer);
     Push(msg);
@@ -543,6 +592,7 @@ bool Eluna::OnChat(Player* pPlayer, uint32 type, uint32 lang, std::string& msg,
     Push(lang);
     Push(pReceiver);
     int n = SetupStack(PlayerEventBindings, key, 5);
+    n += chatFilters.PushRefs(L, filtered_ids);
 
     while (n > 0)
     {
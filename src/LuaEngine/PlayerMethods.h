@@ -3847,19 +3847,8 @@ namespace LuaPlayer
         uint8 channel = Eluna::CHECKVAL<uint8>(L, 4);
         Player* receiver = Eluna::CHECKOBJ<Player>(L, 5);
 
-        std::string fullmsg = prefix + "\t" + message;
-
-        WorldPacket data(SMSG_MESSAGECHAT, 100);
-        data << uint8(channel);
-        data << int32(LANG_ADDON);
-        data << player->GET_GUID();
-#ifndef CLASSIC
-        data << uint32(0);
-        data << receiver->GET_GUID();
-#endif
-        data << uint32(fullmsg.length() + 1);
-        data << fullmsg;
-        data << uint8(0);
+        WorldPacket data(SMSG_MESSAGECHAT, 64 + prefix.length() + message.length());
+        AddonMessageBatcher::BuildPacket(data, channel, player->GET_GUID(), receiver->GET_GUID(), prefix, "", message);
 #ifdef CMANGOS
         receiver->GetSession()->SendPacket(data);
 #else
@@ -3868,6 +3857,41 @@ namespace LuaPlayer
         return 0;
     }
 
+    /**
+     * Queues an addon message of any length to the [Player] receiver
+     *
+     * All messages queued to the same receiver with the same prefix and channel during a world update
+     *   are sent together in as few addon messages as possible at the end of the update.
+     *   Messages that do not fit a single addon message are split into several.
+     *
+     * The receiving addon has to reassemble the messages, each addon message starts with a header character:
+     *   `S` for a complete stream, `F`, `M` and `L` for the first, middle and last part of a stream.
+     *   A stream is a sequence of messages, each written as its length in decimal digits, a `:` and the message.
+     *
+     * Messages sent by clients in the same format can be received with [Global:RegisterChunkedAddonMessageHandler].
+     *
+     * @param string prefix
+     * @param string message : can not contain null characters
+     * @param [ChatMsg] channel
+     * @param [Player] receiver
+     */
+    int QueueAddonMessage(lua_State* L, Player* player)
+    {
+        std::string prefix = Eluna::CHECKVAL<std::string>(L, 2);
+        size_t length = 0;
+        const char* message = luaL_checklstring(L, 3, &length);
+        uint8 channel = Eluna::CHECKVAL<uint8>(L, 4);
+        Player* receiver = Eluna::CHECKOBJ<Player>(L, 5);
+
+        if (prefix.empty() || prefix.length() > 16 || prefix.find('\t') != std::string::npos)
+            return luaL_argerror(L, 2, "prefix of 1 to 16 characters without tabs expected");
+        if (memchr(message, '\0', length))
+            return luaL_argerror(L, 3, "message can not contain null characters");
+
+        Eluna::GetEluna(L)->addonMessages.Queue(player->GET_GUID(), receiver->GET_GUID(), channel, prefix, std::string_view(message, length));
+        return 0;
+    }
+
     /**
      * Kicks the [Player] from the server
      */
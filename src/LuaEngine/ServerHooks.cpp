@@ -32,22 +32,30 @@ using namespace Hooks;
 
 bool Eluna::OnAddonMessage(Player* sender, uint32 type, std::string& msg, Player* receiver, Guild* guild, Group* group, Channel* channel)
 {
-    START_HOOK_WITH_RETVAL(ADDON_EVENT_ON_MESSAGE, true);
+    if (!IsEnabled())
+        return true;
+
+    auto delimeter_position = msg.find('\t');
+    std::string_view prefix(msg.data(), delimeter_position == std::string::npos ? msg.size() : delimeter_position);
+
+    // Messages are only passed to Lua if a handler for all messages or for the prefix exists
+    auto key = EventKey<ServerEvents>(ADDON_EVENT_ON_MESSAGE);
+    if (!ServerEventBindings->HasBindingsFor(key) && !addonRouter.HasRoutesFor(prefix))
+        return true;
+    LOCK_ELUNA;
+
     Push(sender);
     Push(type);
 
-    auto delimeter_position = msg.find('\t');
+    // Push the prefix and message from the original buffer
+    lua_pushlstring(L, prefix.data(), prefix.size());
+    ++push_counter;
     if (delimeter_position == std::string::npos)
-    {
-        Push(msg); // prefix
         Push(); // msg
-    }
     else
     {
-        std::string prefix = msg.substr(0, delimeter_position);
-        std::string content = msg.substr(delimeter_position + 1, std::string::npos);
-        Push(prefix);
-        Push(content);
+        lua_pushlstring(L, msg.data() + delimeter_position + 1, msg.size() - delimeter_position - 1);
+        ++push_counter;
     }
 
     if (receiver)
@@ -61,7 +69,51 @@ bool Eluna::OnAddonMessage(Player* sender, uint32 type, std::string& msg, Player
     else
         Push();
 
-    return CallAllFunctionsBool(ServerEventBindings, key, true);
+    bool result = true;
+    int number_of_arguments = push_counter;
+    int number_of_functions = SetupStack(ServerEventBindings, key, number_of_arguments);
+    number_of_functions += addonRouter.PushRefsFor(L, prefix);
+    // Stack: event_id, [arguments], [event functions], [prefix functions]
+
+    while (number_of_functions > 0)
+    {
+        int r = CallOneFunction(number_of_functions, number_of_arguments, 1);
+        --number_of_functions;
+
+        if (lua_isboolean(L, r) && !lua_toboolean(L, r))
+            result = false;
+        lua_pop(L, 1);
+    }
+    // Stack: event_id, [arguments]
+
+    if (delimeter_position != std::string::npos && addonRouter.HasChunkedRoutesFor(prefix))
+    {
+        std::vector<std::string> messages;
+        std::string_view chunk(msg.data() + delimeter_position + 1, msg.size() - delimeter_position - 1);
+        addonMessages.Receive(sender->GET_GUID(), prefix, chunk, messages);
+
+        // Call the chunked handlers once per reassembled message, replacing the msg argument
+        int msg_index = lua_gettop(L) - number_of_arguments + 4;
+        for (std::string const& message : messages)
+        {
+            lua_pushlstring(L, message.data(), message.size());
+            lua_replace(L, msg_index);
+
+            number_of_functions = addonRouter.PushChunkedRefsFor(L, prefix);
+            while (number_of_functions > 0)
+            {
+                int r = CallOneFunction(number_of_functions, number_of_arguments, 1);
+                --number_of_functions;
+
+                if (lua_isboolean(L, r) && !lua_toboolean(L, r))
+                    result = false;
+                lua_pop(L, 1);
+            }
+        }
+    }
+
+    CleanUpStack(number_of_arguments);
+    return result;
 }
 
 void Eluna::OnTimedEvent(int funcRef, uint32 delay, uint32 calls, WorldObject* obj)
@@ -80,6 +132,7 @@ void Eluna::OnTimedEvent(int funcRef, uint32 delay, uint32 calls, WorldObject* o
 
     // Call function
     ExecuteCall(4, 0);
+    metrics.timedEventCalls.fetch_add(1, std::memory_order_relaxed);
 
     ASSERT(!event_level);
     InvalidateObjects();
@@ -321,12 +374,29 @@ void Eluna::OnWorldUpdate(uint32 diff)
     }
 
     eventMgr->globalProcessor->Update(diff);
+    {
+        LOCK_ELUNA;
+        coroutines.Update(L, diff);
+        workers.DeliverResults(L);
+    }
     httpManager.HandleHttpResponses();
+    packetMirrors.Deliver();
     queryProcessor.ProcessReadyCallbacks();
+    transactionProcessor.ProcessReadyCallbacks();
 
-    START_HOOK(WORLD_EVENT_ON_UPDATE);
-    Push(diff);
-    CallAllFunctions(ServerEventBindings, key);
+    if (!IsEnabled())
+        return;
+
+    LOCK_ELUNA;
+    auto key = EventKey<ServerEvents>(WORLD_EVENT_ON_UPDATE);
+    if (ServerEventBindings->HasBindingsFor(key))
+    {
+        Push(diff);
+        CallAllFunctions(ServerEventBindings, key);
+    }
+
+    // Send the addon messages queued during this update
+    addonMessages.Flush();
 }
 
 void Eluna::OnStartup()
@@ -696,6 +696,48 @@ namespace LuaWorldObject
         return 0;
     }
 
+    /**
+     * Sends a [WorldPacket] to all [Player]s within the given range of the [WorldObject].
+     *
+     * Unlike [WorldObject:SendPacket] the range is not limited to the sight of the [WorldObject].
+     *
+     * @param [WorldPacket] packet
+     * @param float range = 533.33333 : optionally set range. Default range is grid size
+     * @param [TeamId] team = TEAM_NEUTRAL : optional check team of the [Player], Alliance, Horde or Neutral (All)
+     * @return uint32 count : amount of [Player]s the packet was sent to
+     */
+    int SendPacketToPlayersInRange(lua_State* L, WorldObject* obj)
+    {
+        WorldPacket* data = Eluna::CHECKOBJ<WorldPacket>(L, 2);
+        float range = Eluna::CHECKVAL<float>(L, 3, SIZE_OF_GRIDS);
+        uint32 team = Eluna::CHECKVAL<uint32>(L, 4, TEAM_NEUTRAL);
+        if (team > TEAM_NEUTRAL)
+            return luaL_argerror(L, 4, "valid TeamId expected");
+
+        std::list<Player*> list;
+        ElunaUtil::WorldObjectInRangeCheck checker(false, obj, range, TYPEMASK_PLAYER, 0, 0, 0);
+#ifdef TRINITY
+        Trinity::PlayerListSearcher<ElunaUtil::WorldObjectInRangeCheck> searcher(obj, list, checker);
+        Cell::VisitAllObjects(obj, searcher, range);
+#elif AZEROTHCORE
+        Acore::PlayerListSearcher<ElunaUtil::WorldObjectInRangeCheck> searcher(obj, list, checker);
+        Cell::VisitAllObjects(obj, searcher, range);
+#else
+        MaNGOS::PlayerListSearcher<ElunaUtil::WorldObjectInRangeCheck> searcher(list, checker);
+        Cell::VisitWorldObjects(obj, searcher, range);
+#endif
+
+        uint32 count = 0;
+        for (std::list<Player*>::const_iterator it = list.begin(); it != list.end(); ++it)
+        {
+            if ((team == TEAM_NEUTRAL || (*it)->GetTeamId() == team) && ElunaUtil::SendPacket(*it, data))
+                ++count;
+        }
+
+        Eluna::Push(L, count);
+        return 1;
+    }
+
     /**
      * Spawns a [GameObject] at specified location.
      *
@@ -1229,5 +1271,38 @@ namespace LuaWorldObject
             obj->PlayDistanceSound(soundId);
         return 0;
     }
+
+    /**
+     * Returns the value stored on the [WorldObject] for the key with [WorldObject:SetData], or the table of all its values if no key is given.
+     *
+     * The values are kept until the [WorldObject] is destroyed or Eluna is reloaded.
+     *   They stay while it is removed from the world and added again, like a [Player] changing maps.
+     *
+     *     player:SetData("kills", (player:GetData("kills") or 0) + 1)
+     *
+     * @proto table = ()
+     * @proto value = (key)
+     * @param key : the key of the value
+     * @return value : the value, or nil if none is set
+     */
+    int GetData(lua_State* L, WorldObject* obj)
+    {
+        Eluna::GEluna->objectVariables.Get(L, obj, 2);
+        return 1;
+    }
+
+    /**
+     * Stores a value of any type on the [WorldObject] for the key, a nil value removes it.
+     *
+     * See also [WorldObject:GetData]
+     *
+     * @param key : the key of the value, anything but nil
+     * @param value : the value to store
+     */
+    int SetData(lua_State* L, WorldObject* obj)
+    {
+        Eluna::GEluna->objectVariables.Set(L, obj, 2, 3);
+        return 0;
+    }
 };
 #endif
@@ -16,10 +16,399 @@
  *
  * The packet can contain further data, the format of which depends on the opcode.
  *
+ * Packets passed to packet events are read-only views of the packet being handled by the core.
+ *   The first `Write` or [WorldPacket:SetOpcode] call on such a packet gives the handler its own copy,
+ *   the view itself is only valid during the event.
+ *
  * Inherits all methods from: none
  */
 namespace LuaPacket
 {
+    // Helpers of the format string methods, see ReadFormat below for the format
+    namespace Format
+    {
+        static void CheckReadable(lua_State* L, WorldPacket* packet, size_t size)
+        {
+            if (packet->rpos() + size > packet->size())
+                luaL_error(L, "reading %d bytes at position %d exceeds packet size %d", (int)size, (int)packet->rpos(), (int)packet->size());
+        }
+
+        static const char* ParseCount(lua_State* L, const char* fmt, uint32 last, uint32& count)
+        {
+            if (*fmt == '*')
+            {
+                count = last;
+                return fmt + 1;
+            }
+
+            if (!isdigit(static_cast<unsigned char>(*fmt)))
+            {
+                count = 1;
+                return fmt;
+            }
+
+            uint64 value = 0;
+            while (isdigit(static_cast<unsigned char>(*fmt)))
+            {
+                value = value * 10 + (*fmt++ - '0');
+                if (value > std::numeric_limits<uint32>::max())
+                    luaL_error(L, "repeat count too large in format");
+            }
+            count = static_cast<uint32>(value);
+            return fmt;
+        }
+
+        // Returns the position after the ')' closing the group starting at fmt
+        static const char* SkipGroup(lua_State* L, const char* fmt)
+        {
+            const char* body = fmt;
+            while (isspace(static_cast<unsigned char>(*body)))
+                ++body;
+            if (*body == ')')
+                luaL_error(L, "empty group in format");
+
+            uint32 depth = 1;
+            for (; *fmt; ++fmt)
+            {
+                if (*fmt == '(')
+                    ++depth;
+                else if (*fmt == ')' && !--depth)
+                    return fmt + 1;
+            }
+            luaL_error(L, "missing ')' in format");
+            return fmt;
+        }
+
+        static void ReadField(lua_State* L, WorldPacket* packet, char type, uint32& last)
+        {
+            switch (type)
+            {
+                case 'b':
+                {
+                    CheckReadable(L, packet, sizeof(int8));
+                    int8 value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    last = value < 0 ? 0 : value;
+                    break;
+                }
+                case 'B':
+                {
+                    CheckReadable(L, packet, sizeof(uint8));
+                    uint8 value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    last = value;
+                    break;
+                }
+                case 'h':
+                {
+                    CheckReadable(L, packet, sizeof(int16));
+                    int16 value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    last = value < 0 ? 0 : value;
+                    break;
+                }
+                case 'H':
+                {
+                    CheckReadable(L, packet, sizeof(uint16));
+                    uint16 value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    last = value;
+                    break;
+                }
+                case 'i':
+                {
+                    CheckReadable(L, packet, sizeof(int32));
+                    int32 value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    last = value < 0 ? 0 : value;
+                    break;
+                }
+                case 'I':
+                {
+                    CheckReadable(L, packet, sizeof(uint32));
+                    uint32 value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    last = value;
+                    break;
+                }
+                case 'l':
+                {
+                    CheckReadable(L, packet, sizeof(int64));
+                    int64 value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    break;
+                }
+                case 'L':
+                {
+                    CheckReadable(L, packet, sizeof(uint64));
+                    uint64 value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    break;
+                }
+                case 'f':
+                {
+                    CheckReadable(L, packet, sizeof(float));
+                    float value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    break;
+                }
+                case 'd':
+                {
+                    CheckReadable(L, packet, sizeof(double));
+                    double value;
+                    (*packet) >> value;
+                    Eluna::Push(L, value);
+                    break;
+                }
+                case 'g':
+                {
+                    CheckReadable(L, packet, sizeof(uint64));
+                    ObjectGuid guid;
+                    (*packet) >> guid;
+                    Eluna::Push(L, guid);
+                    break;
+                }
+                case 'p':
+                {
+                    CheckReadable(L, packet, sizeof(uint8));
+                    uint8 mask;
+                    (*packet) >> mask;
+                    uint64 value = 0;
+                    for (uint8 i = 0; i < 8; ++i)
+                    {
+                        if (!(mask & (1 << i)))
+                            continue;
+                        CheckReadable(L, packet, sizeof(uint8));
+                        uint8 byte;
+                        (*packet) >> byte;
+                        value |= uint64(byte) << (i * 8);
+                    }
+                    Eluna::Push(L, ObjectGuid(value));
+                    break;
+                }
+                case 's':
+                {
+                    // Even an empty string has its terminator, a string cut short is an error
+                    CheckReadable(L, packet, sizeof(uint8));
+                    const char* start = reinterpret_cast<const char*>(packet->contents()) + packet->rpos();
+                    const char* end = static_cast<const char*>(memchr(start, 0, packet->size() - packet->rpos()));
+                    if (!end)
+                        luaL_error(L, "string at position %d is not terminated", (int)packet->rpos());
+                    lua_pushlstring(L, start, end - start);
+                    packet->rpos(packet->rpos() + (end - start) + 1);
+                    break;
+                }
+                default:
+                    luaL_error(L, "invalid format option '%c'", type);
+                    break;
+            }
+        }
+
+        static void WriteField(lua_State* L, WorldPacket* packet, char type, int narg, uint32& last)
+        {
+            switch (type)
+            {
+                case 'b':
+                {
+                    int8 value = Eluna::CHECKVAL<int8>(L, narg);
+                    (*packet) << value;
+                    last = value < 0 ? 0 : value;
+                    break;
+                }
+                case 'B':
+                {
+                    uint8 value = Eluna::CHECKVAL<uint8>(L, narg);
+                    (*packet) << value;
+                    last = value;
+                    break;
+                }
+                case 'h':
+                {
+                    int16 value = Eluna::CHECKVAL<int16>(L, narg);
+                    (*packet) << value;
+                    last = value < 0 ? 0 : value;
+                    break;
+                }
+                case 'H':
+                {
+                    uint16 value = Eluna::CHECKVAL<uint16>(L, narg);
+                    (*packet) << value;
+                    last = value;
+                    break;
+                }
+                case 'i':
+                {
+                    int32 value = Eluna::CHECKVAL<int32>(L, narg);
+                    (*packet) << value;
+                    last = value < 0 ? 0 : value;
+                    break;
+                }
+                case 'I':
+                {
+                    uint32 value = Eluna::CHECKVAL<uint32>(L, narg);
+                    (*packet) << value;
+                    last = value;
+                    break;
+                }
+                case 'l':
+                    (*packet) << Eluna::CHECKVAL<int64>(L, narg);
+                    break;
+                case 'L':
+                    (*packet) << Eluna::CHECKVAL<uint64>(L, narg);
+                    break;
+                case 'f':
+                    (*packet) << Eluna::CHECKVAL<float>(L, narg);
+                    break;
+                case 'd':
+                    (*packet) << Eluna::CHECKVAL<double>(L, narg);
+                    break;
+                case 'g':
+                    (*packet) << Eluna::CHECKVAL<ObjectGuid>(L, narg);
+                    break;
+                case 'p':
+                    (*packet) << Eluna::CHECKVAL<ObjectGuid>(L, narg).WriteAsPacked();
+                    break;
+                case 's':
+                    (*packet) << Eluna::CHECKVAL<std::string>(L, narg);
+                    break;
+                default:
+                    luaL_error(L, "invalid format option '%c'", type);
+                    break;
+            }
+        }
+
+        // Reads the fields of fmt up to the end of the current group.
+        // Values are appended to the table at index table, or pushed to the stack when table is 0.
+        static const char* ReadFields(lua_State* L, WorldPacket* packet, const char* fmt, int table, int& index, uint32& last)
+        {
+            while (true)
+            {
+                while (isspace(static_cast<unsigned char>(*fmt)))
+                    ++fmt;
+                if (!*fmt || *fmt == ')')
+                    return fmt;
+
+                uint32 count;
+                fmt = ParseCount(L, fmt, last, count);
+
+                // Every field reads at least one byte, so a count taken from the packet can't exceed what is left
+                if (count > packet->size() - packet->rpos())
+                    luaL_error(L, "repeat count %d exceeds the %d bytes left in the packet", (int)count, (int)(packet->size() - packet->rpos()));
+
+                if (*fmt == '(')
+                {
+                    const char* body = fmt + 1;
+                    fmt = SkipGroup(L, body);
+
+                    if (!table)
+                    {
+                        for (uint32 i = 0; i < count; ++i)
+                            ReadFields(L, packet, body, 0, index, last);
+                        continue;
+                    }
+
+                    lua_createtable(L, count, 0);
+                    for (uint32 i = 0; i < count; ++i)
+                    {
+                        lua_newtable(L);
+                        int rowIndex = 0;
+                        ReadFields(L, packet, body, lua_gettop(L), rowIndex, last);
+                        lua_rawseti(L, -2, i + 1);
+                    }
+                    lua_rawseti(L, table, ++index);
+                    continue;
+                }
+
+                if (!*fmt || *fmt == ')')
+                    luaL_error(L, "missing format option after repeat count");
+
+                char type = *fmt++;
+                for (uint32 i = 0; i < count; ++i)
+                {
+                    luaL_checkstack(L, 1, "too many values read from packet");
+                    ReadField(L, packet, type, last);
+                    if (table)
+                        lua_rawseti(L, table, ++index);
+                    else
+                        ++index;
+                }
+            }
+        }
+
+        // Writes the fields of fmt up to the end of the current group.
+        // Values are taken from the table at index table, or from the stack after index when table is 0.
+        static const char* WriteFields(lua_State* L, WorldPacket* packet, const char* fmt, int table, int& index, uint32& last)
+        {
+            while (true)
+            {
+                while (isspace(static_cast<unsigned char>(*fmt)))
+                    ++fmt;
+                if (!*fmt || *fmt == ')')
+                    return fmt;
+
+                uint32 count;
+                fmt = ParseCount(L, fmt, last, count);
+
+                if (*fmt == '(')
+                {
+                    const char* body = fmt + 1;
+                    fmt = SkipGroup(L, body);
+
+                    if (!table)
+                    {
+                        for (uint32 i = 0; i < count; ++i)
+                            WriteFields(L, packet, body, 0, index, last);
+                        continue;
+                    }
+
+                    lua_rawgeti(L, table, ++index);
+                    if (!lua_istable(L, -1))
+                        luaL_error(L, "table of rows expected for group at value %d", index);
+                    int rows = lua_gettop(L);
+                    for (uint32 i = 0; i < count; ++i)
+                    {
+                        lua_rawgeti(L, rows, i + 1);
+                        if (!lua_istable(L, -1))
+                            luaL_error(L, "row %d of group at value %d is not a table", (int)i + 1, index);
+                        int rowIndex = 0;
+                        WriteFields(L, packet, body, lua_gettop(L), rowIndex, last);
+                        lua_pop(L, 1);
+                    }
+                    lua_pop(L, 1);
+                    continue;
+                }
+
+                if (!*fmt || *fmt == ')')
+                    luaL_error(L, "missing format option after repeat count");
+
+                char type = *fmt++;
+                for (uint32 i = 0; i < count; ++i)
+                {
+                    if (!table)
+                    {
+                        WriteField(L, packet, type, ++index, last);
+                        continue;
+                    }
+
+                    lua_rawgeti(L, table, ++index);
+                    if (lua_isnil(L, -1))
+                        luaL_error(L, "missing value %d for format option '%c'", index, type);
+                    WriteField(L, packet, type, lua_gettop(L), last);
+                    lua_pop(L, 1);
+                }
+            }
+        }
+    };
+
     /**
      * Returns the opcode of the [WorldPacket].
      *
@@ -52,10 +441,55 @@ namespace LuaPacket
         uint32 opcode = Eluna::CHECKVAL<uint32>(L, 2);
         if (opcode >= NUM_MSG_TYPES)
             return luaL_argerror(L, 2, "valid opcode expected");
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         packet->SetOpcode((OpcodesList)opcode);
         return 0;
     }
 
+    /**
+     * Clears the contents of the [WorldPacket] so it can be reused for another message.
+     *
+     * The memory reserved by the packet is kept, so reusing one packet for repeated sends
+     *   avoids allocating a new packet each time.
+     *
+     * @param [Opcodes] opcode = current : the new opcode of the packet
+     */
+    int Reset(lua_State* L, WorldPacket* packet)
+    {
+        uint32 opcode = Eluna::CHECKVAL<uint32>(L, 2, packet->GetOpcode());
+        if (opcode >= NUM_MSG_TYPES)
+            return luaL_argerror(L, 2, "valid opcode expected");
+
+        ElunaObject* elunaObj = Eluna::CHECKOBJ<ElunaObject>(L, 1);
+        if (elunaObj->IsView())
+        {
+            // Don't copy the contents of a view just to throw them away
+            elunaObj->Detach(Eluna::GetEluna(L)->packetPool.Acquire(opcode, packet->size()));
+            return 0;
+        }
+
+        packet->clear();
+        packet->SetOpcode((OpcodesList)opcode);
+        return 0;
+    }
+
+    /**
+     * Returns the [WorldPacket] to the packet pool immediately instead of waiting for it to be garbage collected.
+     *
+     * The packet can not be used after calling this.
+     * Releasing a packet passed to a packet event does nothing.
+     */
+    int Release(lua_State* L, WorldPacket* packet)
+    {
+        ElunaObject* elunaObj = Eluna::CHECKOBJ<ElunaObject>(L, 1);
+        if (elunaObj->IsView() || !ElunaTemplate<WorldPacket>::manageMemory)
+            return 0;
+
+        elunaObj->Disown();
+        Eluna::GetEluna(L)->packetPool.Release(packet);
+        return 0;
+    }
+
     /**
      * Reads and returns a signed 8-bit integer value from the [WorldPacket].
      *
@@ -194,6 +628,7 @@ namespace LuaPacket
     int WriteGUID(lua_State* L, WorldPacket* packet)
     {
         ObjectGuid guid = Eluna::CHECKVAL<ObjectGuid>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << guid;
         return 0;
     }
@@ -206,6 +641,7 @@ namespace LuaPacket
     int WriteString(lua_State* L, WorldPacket* packet)
     {
         std::string _val = Eluna::CHECKVAL<std::string>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << _val;
         return 0;
     }
@@ -218,6 +654,7 @@ namespace LuaPacket
     int WriteByte(lua_State* L, WorldPacket* packet)
     {
         int8 byte = Eluna::CHECKVAL<int8>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << byte;
         return 0;
     }
@@ -230,6 +667,7 @@ namespace LuaPacket
     int WriteUByte(lua_State* L, WorldPacket* packet)
     {
         uint8 byte = Eluna::CHECKVAL<uint8>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << byte;
         return 0;
     }
@@ -242,6 +680,7 @@ namespace LuaPacket
     int WriteShort(lua_State* L, WorldPacket* packet)
     {
         int16 _short = Eluna::CHECKVAL<int16>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << _short;
         return 0;
     }
@@ -254,6 +693,7 @@ namespace LuaPacket
     int WriteUShort(lua_State* L, WorldPacket* packet)
     {
         uint16 _ushort = Eluna::CHECKVAL<uint16>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << _ushort;
         return 0;
     }
@@ -266,6 +706,7 @@ namespace LuaPacket
     int WriteLong(lua_State* L, WorldPacket* packet)
     {
         int32 _long = Eluna::CHECKVAL<int32>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << _long;
         return 0;
     }
@@ -278,6 +719,7 @@ namespace LuaPacket
     int WriteULong(lua_State* L, WorldPacket* packet)
     {
         uint32 _ulong = Eluna::CHECKVAL<uint32>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << _ulong;
         return 0;
     }
@@ -290,6 +732,7 @@ namespace LuaPacket
     int WriteFloat(lua_State* L, WorldPacket* packet)
     {
         float _val = Eluna::CHECKVAL<float>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << _val;
         return 0;
     }
@@ -302,9 +745,113 @@ namespace LuaPacket
     int WriteDouble(lua_State* L, WorldPacket* packet)
     {
         double _val = Eluna::CHECKVAL<double>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
         (*packet) << _val;
         return 0;
     }
+
+    /**
+     * Reads the fields described by a format string from the [WorldPacket] and returns them.
+     *
+     * Reading a whole structure with one call is considerably cheaper than
+     *   calling a `Read` method for each field.
+     *
+     * The format string is a sequence of the following options, whitespace is ignored:
+     *
+     *     b : int8               B : uint8
+     *     h : int16              H : uint16
+     *     i : int32              I : uint32
+     *     l : int64              L : uint64
+     *     f : float              d : double
+     *     g : ObjectGuid         p : packed ObjectGuid
+     *     s : null terminated string
+     *
+     * Any option or a group of options in parentheses can be preceded by a repeat count,
+     *   e.g. `3I` reads three uint32 values. A `*` repeat count uses the value of the
+     *   last 8, 16 or 32-bit integer read, so `B*(Ig)` reads a uint8 count followed by that many
+     *   pairs of uint32 and guid.
+     *
+     *     local count, id1, guid1, id2, guid2 = packet:ReadFormat("B*(Ig)")
+     *
+     * @param string format : the fields to read
+     * @return ... values : the values read, groups are flattened
+     */
+    int ReadFormat(lua_State* L, WorldPacket* packet)
+    {
+        const char* fmt = Eluna::CHECKVAL<const char*>(L, 2);
+        int index = 0;
+        uint32 last = 0;
+        if (*Format::ReadFields(L, packet, fmt, 0, index, last))
+            return luaL_argerror(L, 2, "unexpected ')' in format");
+        return index;
+    }
+
+    /**
+     * Reads the fields described by a format string from the [WorldPacket] and returns them in a table.
+     *
+     * Uses the same format as [WorldPacket:ReadFormat]. Each group is returned as one
+     *   value holding a table of rows, each row being a table of the values of the group.
+     *
+     *     local data = packet:ReadFormatTable("B*(Ig)")
+     *     -- data = { count, { { id1, guid1 }, { id2, guid2 } } }
+     *
+     * @param string format : the fields to read
+     * @return table values : the values read
+     */
+    int ReadFormatTable(lua_State* L, WorldPacket* packet)
+    {
+        const char* fmt = Eluna::CHECKVAL<const char*>(L, 2);
+        lua_newtable(L);
+        int index = 0;
+        uint32 last = 0;
+        if (*Format::ReadFields(L, packet, fmt, lua_gettop(L), index, last))
+            return luaL_argerror(L, 2, "unexpected ')' in format");
+        return 1;
+    }
+
+    /**
+     * Writes the values passed to the [WorldPacket] as described by a format string.
+     *
+     * Uses the same format as [WorldPacket:ReadFormat]. A `*` repeat count uses the value of
+     *   the last 8, 16 or 32-bit integer written.
+     *
+     *     packet:WriteFormat("B*(Ig)", 2, id1, guid1, id2, guid2)
+     *
+     * @param string format : the fields to write
+     * @param ... values : the values to write, groups are flattened
+     */
+    int WriteFormat(lua_State* L, WorldPacket* packet)
+    {
+        const char* fmt = Eluna::CHECKVAL<const char*>(L, 2);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
+        int index = 2;
+        uint32 last = 0;
+        if (*Format::WriteFields(L, packet, fmt, 0, index, last))
+            return luaL_argerror(L, 2, "unexpected ')' in format");
+        return 0;
+    }
+
+    /**
+     * Writes the values of a table to the [WorldPacket] as described by a format string.
+     *
+     * Uses the same table layout as [WorldPacket:ReadFormatTable].
+     *
+     *     packet:WriteFormatTable("B*(Ig)", { 2, { { id1, guid1 }, { id2, guid2 } } })
+     *
+     * @param string format : the fields to write
+     * @param table values : the values to write
+     */
+    int WriteFormatTable(lua_State* L, WorldPacket* packet)
+    {
+        const char* fmt = Eluna::CHECKVAL<const char*>(L, 2);
+        luaL_checktype(L, 3, LUA_TTABLE);
+        packet = ElunaTemplate<WorldPacket>::CopyOnWrite(L, 1, packet);
+        int index = 0;
+        uint32 last = 0;
+        if (*Format::WriteFields(L, packet, fmt, 3, index, last))
+            return luaL_argerror(L, 2, "unexpected ')' in format");
+        return 0;
+    }
 };
 
 #endif